@@ -0,0 +1,165 @@
+#include "context_pool.h"
+#include "debug.h"
+
+
+static GPrivate current_thread = G_PRIVATE_INIT(NULL);
+
+static gpointer context_pool_thread_run(gpointer data);
+static gint context_pool_poll(GPollFD * fds, guint nfds, gint timeout);
+static gboolean context_pool_quit(gpointer data);
+
+/* Installed as the poll function of every pool context, so we can tell
+ * how long each thread sleeps and how often it actually wakes up */
+static gint context_pool_poll(GPollFD * fds, guint nfds, gint timeout)
+{
+	context_pool_thread * thread = g_private_get(&current_thread);
+	gint64 start = g_get_monotonic_time();
+	gint ret = g_poll(fds, nfds, timeout);
+
+	if (thread) {
+		thread->idle_time += g_get_monotonic_time() - start;
+		if (ret > 0) {
+			thread->wakeups++;
+		}
+	}
+
+	return ret;
+}
+
+/* Quitting from inside the context works even if the loop has not started running yet */
+static gboolean context_pool_quit(gpointer data)
+{
+	g_main_loop_quit((GMainLoop *)data);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer context_pool_thread_run(gpointer data)
+{
+	context_pool_thread * thread = (context_pool_thread *)data;
+
+	g_private_set(&current_thread, thread);
+	g_main_context_push_thread_default(thread->context);
+	g_main_loop_run(thread->loop);
+	g_main_context_pop_thread_default(thread->context);
+
+	return NULL;
+}
+
+context_pool * context_pool_new(const gchar * name, guint size)
+{
+	context_pool * pool;
+	GError * error = NULL;
+
+	if (!size) {
+		return NULL;
+	}
+
+	pool = g_malloc0(sizeof(context_pool));
+	pool->name = g_strdup(name);
+	pool->threads = g_new0(context_pool_thread, size);
+
+	for (guint i = 0; i < size; i++) {
+		context_pool_thread * thread = &pool->threads[i];
+		gchar * thread_name = g_strdup_printf("%s %u", name, i);
+
+		thread->index = i;
+		thread->context = g_main_context_new();
+		g_main_context_set_poll_func(thread->context, context_pool_poll);
+		thread->loop = g_main_loop_new(thread->context, FALSE);
+		thread->started = g_get_monotonic_time();
+		thread->thread = g_thread_try_new(thread_name, context_pool_thread_run, thread, &error);
+		g_free(thread_name);
+
+		if (!thread->thread) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch %s thread %u...\n",
+				error ? error->code : 0, error && error->message ? error->message : "??", name, i);
+			g_clear_error(&error);
+			g_main_loop_unref(thread->loop);
+			g_main_context_unref(thread->context);
+			break;
+		}
+		pool->size++;
+	}
+
+	if (!pool->size) {
+		context_pool_free(pool);
+		return NULL;
+	}
+
+	JANUS_LOG(LOG_INFO, "Started %u %s threads\n", pool->size, name);
+	return pool;
+}
+
+void context_pool_free(context_pool * pool)
+{
+	if (!pool) {
+		return;
+	}
+
+	for (guint i = 0; i < pool->size; i++) {
+		context_pool_thread * thread = &pool->threads[i];
+		GSource * quit = g_idle_source_new();
+		g_source_set_callback(quit, context_pool_quit, thread->loop, NULL);
+		g_source_attach(quit, thread->context);
+		g_source_unref(quit);
+		g_thread_join(thread->thread);
+		g_main_loop_unref(thread->loop);
+		g_main_context_unref(thread->context);
+	}
+
+	g_free(pool->threads);
+	g_free(pool->name);
+	g_free(pool);
+}
+
+context_pool_thread * context_pool_get_by_key(context_pool * pool, const gchar * key)
+{
+	if (!pool || !pool->size) {
+		return NULL;
+	}
+
+	return &pool->threads[g_str_hash(key) % pool->size];
+}
+
+context_pool_thread * context_pool_get_least_loaded(context_pool * pool)
+{
+	context_pool_thread * best = NULL;
+
+	if (!pool) {
+		return NULL;
+	}
+
+	for (guint i = 0; i < pool->size; i++) {
+		if (!best || g_atomic_int_get(&pool->threads[i].assigned) < g_atomic_int_get(&best->assigned)) {
+			best = &pool->threads[i];
+		}
+	}
+
+	return best;
+}
+
+void context_pool_thread_assign(context_pool_thread * thread)
+{
+	if (thread) {
+		g_atomic_int_inc(&thread->assigned);
+	}
+}
+
+void context_pool_thread_release(context_pool_thread * thread)
+{
+	if (thread) {
+		g_atomic_int_add(&thread->assigned, -1);
+	}
+}
+
+/* Fraction of wall time the thread spent outside poll(), since it started */
+gdouble context_pool_thread_load(context_pool_thread * thread)
+{
+	gint64 elapsed = g_get_monotonic_time() - thread->started;
+
+	if (elapsed <= 0) {
+		return 0.0;
+	}
+
+	return CLAMP(1.0 - (gdouble)thread->idle_time / elapsed, 0.0, 1.0);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glib.h>
+
+/* A fixed set of threads, each iterating its own GMainContext */
+typedef struct context_pool_thread {
+	guint index;
+	GThread *thread;
+	GMainContext *context;
+	GMainLoop *loop;
+	volatile gint assigned;		/* objects currently placed on this thread */
+	guint64 wakeups;			/* poll() calls that returned ready descriptors */
+	gint64 idle_time;			/* microseconds spent blocked in poll() */
+	gint64 started;
+} context_pool_thread;
+
+typedef struct context_pool {
+	gchar *name;
+	guint size;
+	context_pool_thread *threads;
+} context_pool;
+
+context_pool * context_pool_new(const gchar * name, guint size);
+void context_pool_free(context_pool * pool);
+context_pool_thread * context_pool_get_by_key(context_pool * pool, const gchar * key);
+context_pool_thread * context_pool_get_least_loaded(context_pool * pool);
+void context_pool_thread_assign(context_pool_thread * thread);
+void context_pool_thread_release(context_pool_thread * thread);
+gdouble context_pool_thread_load(context_pool_thread * thread);
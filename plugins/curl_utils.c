@@ -173,7 +173,9 @@ json_t *json_registry_source_request(const gchar *url) {
 	return json_object_response;
 }
 
-gchar *get_source_from_registry_by_id(const gchar *registry_url, const gchar *id) {
+/* The uri of a source, and in backup the one of its standby when the registry lists
+ * several, either as "uris" (primary first) or as "uri" and "backup" */
+gchar *get_source_from_registry_by_id(const gchar *registry_url, const gchar *id, gchar **backup) {
 
 	gchar *url = NULL;
 	json_t *json_source = NULL;
@@ -205,12 +207,22 @@ gchar *get_source_from_registry_by_id(const gchar *registry_url, const gchar *id
 			break;
 		}
 		json_t *json_uri = json_object_get(json_object, "uri");
+		json_t *json_backup = json_object_get(json_object, "backup");
+		json_t *json_uris = json_object_get(json_object, "uris");
+		if (json_is_array(json_uris) && json_array_size(json_uris) > 0) {
+			json_uri = json_array_get(json_uris, 0);
+			json_backup = json_array_get(json_uris, 1);
+			if (json_array_size(json_uris) > 2)
+				JANUS_LOG(LOG_WARN, "Only the first two uris of %s are used.\n", id);
+		}
 		if (!json_is_string(json_uri)) {
 			JANUS_LOG(LOG_ERR, "uri is not a string.\n");
 			break;
 		}
 		// allocation
 		source = g_strdup(json_string_value(json_uri));
+		if (backup && json_is_string(json_backup))
+			*backup = g_strdup(json_string_value(json_backup));
 		json_decref(json_source);
 		json_source = NULL;
 	}
@@ -8,6 +8,6 @@
 #endif
 
 json_t *json_registry_source_request(const gchar *url);
-gchar *get_source_from_registry_by_id(const gchar *registry_url, const gchar *id);
+gchar *get_source_from_registry_by_id(const gchar *registry_url, const gchar *id, gchar **backup);
 
 
@@ -0,0 +1,97 @@
+#include "fanout_pool.h"
+#include "debug.h"
+
+
+static gpointer fanout_pool_worker_run(gpointer data);
+
+/* Pushed once per worker on shutdown */
+static gint fanout_pool_exit_task;
+
+typedef struct fanout_pool_worker_data {
+	fanout_pool * pool;
+	fanout_pool_worker * worker;
+} fanout_pool_worker_data;
+
+static gpointer fanout_pool_worker_run(gpointer data)
+{
+	fanout_pool_worker_data * worker_data = (fanout_pool_worker_data *)data;
+	fanout_pool * pool = worker_data->pool;
+	fanout_pool_worker * worker = worker_data->worker;
+	gpointer task;
+
+	g_free(worker_data);
+
+	while ((task = g_async_queue_pop(worker->queue)) != &fanout_pool_exit_task) {
+		pool->func(task);
+		worker->tasks++;
+	}
+
+	return NULL;
+}
+
+fanout_pool * fanout_pool_new(guint size, fanout_pool_func func)
+{
+	fanout_pool * pool;
+	GError * error = NULL;
+
+	if (!size || !func) {
+		return NULL;
+	}
+
+	pool = g_malloc0(sizeof(fanout_pool));
+	pool->func = func;
+	pool->workers = g_new0(fanout_pool_worker, size);
+
+	for (guint i = 0; i < size; i++) {
+		fanout_pool_worker * worker = &pool->workers[i];
+		fanout_pool_worker_data * worker_data = g_malloc0(sizeof(fanout_pool_worker_data));
+		gchar * thread_name = g_strdup_printf("fanout %u", i);
+
+		worker->index = i;
+		worker->queue = g_async_queue_new();
+		worker_data->pool = pool;
+		worker_data->worker = worker;
+		worker->thread = g_thread_try_new(thread_name, fanout_pool_worker_run, worker_data, &error);
+		g_free(thread_name);
+
+		if (!worker->thread) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch fanout thread %u...\n",
+				error ? error->code : 0, error && error->message ? error->message : "??", i);
+			g_clear_error(&error);
+			g_async_queue_unref(worker->queue);
+			g_free(worker_data);
+			break;
+		}
+		pool->size++;
+	}
+
+	if (!pool->size) {
+		fanout_pool_free(pool);
+		return NULL;
+	}
+
+	JANUS_LOG(LOG_INFO, "Started %u fanout threads\n", pool->size);
+	return pool;
+}
+
+void fanout_pool_free(fanout_pool * pool)
+{
+	if (!pool) {
+		return;
+	}
+
+	for (guint i = 0; i < pool->size; i++) {
+		fanout_pool_worker * worker = &pool->workers[i];
+		g_async_queue_push(worker->queue, &fanout_pool_exit_task);
+		g_thread_join(worker->thread);
+		g_async_queue_unref(worker->queue);
+	}
+
+	g_free(pool->workers);
+	g_free(pool);
+}
+
+void fanout_pool_push(fanout_pool * pool, guint shard, gpointer task)
+{
+	g_async_queue_push(pool->workers[shard % pool->size].queue, task);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glib.h>
+
+typedef void (*fanout_pool_func)(gpointer task);
+
+/* One queue per worker, so everything pushed for the same shard runs in order */
+typedef struct fanout_pool_worker {
+	guint index;
+	GThread *thread;
+	GAsyncQueue *queue;
+	guint64 tasks;
+} fanout_pool_worker;
+
+typedef struct fanout_pool {
+	guint size;
+	fanout_pool_func func;
+	fanout_pool_worker *workers;
+} fanout_pool;
+
+fanout_pool * fanout_pool_new(guint size, fanout_pool_func func);
+void fanout_pool_free(fanout_pool * pool);
+void fanout_pool_push(fanout_pool * pool, guint shard, gpointer task);
@@ -0,0 +1,223 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "gop_cache.h"
+#include "../rtp.h"
+#include "debug.h"
+
+
+static void gop_cache_reset(gop_cache * cache)
+{
+	for (guint i = 0; i < cache->packets->len; i++) {
+		packet_buffer_unref(g_ptr_array_index(cache->packets, i));
+	}
+	g_ptr_array_set_size(cache->packets, 0);
+	cache->valid = FALSE;
+}
+
+gop_cache * gop_cache_new(guint max_packets)
+{
+	gop_cache * cache = g_malloc0(sizeof(gop_cache));
+
+	janus_mutex_init(&cache->mutex);
+	cache->max_packets = max_packets;
+	cache->packets = g_ptr_array_sized_new(max_packets);
+
+	return cache;
+}
+
+void gop_cache_free(gop_cache * cache)
+{
+	if (!cache) {
+		return;
+	}
+
+	gop_cache_reset(cache);
+	g_ptr_array_free(cache->packets, TRUE);
+	janus_mutex_destroy(&cache->mutex);
+	g_free(cache);
+}
+
+/* Drops what was cached, e.g. when the source restarts with a new sequence space */
+void gop_cache_clear(gop_cache * cache)
+{
+	janus_mutex_lock(&cache->mutex);
+	gop_cache_reset(cache);
+	janus_mutex_unlock(&cache->mutex);
+}
+
+/* rtpmap as filled from the source caps, e.g. "96 VP8/90000" */
+gint gop_cache_codec_from_rtpmap(const gchar * rtpmap)
+{
+	const gchar * encoding = rtpmap ? strchr(rtpmap, ' ') : NULL;
+
+	encoding = encoding ? encoding + 1 : rtpmap;
+	if (!encoding) {
+		return GOP_CACHE_CODEC_UNKNOWN;
+	}
+	if (!g_ascii_strncasecmp(encoding, "VP8/", 4)) {
+		return GOP_CACHE_CODEC_VP8;
+	}
+	if (!g_ascii_strncasecmp(encoding, "VP9/", 4)) {
+		return GOP_CACHE_CODEC_VP9;
+	}
+	if (!g_ascii_strncasecmp(encoding, "H264/", 5)) {
+		return GOP_CACHE_CODEC_H264;
+	}
+	return GOP_CACHE_CODEC_UNKNOWN;
+}
+
+/* RFC 7741: first packet of partition 0, and the P bit of the VP8 frame header cleared */
+static gboolean gop_cache_vp8_keyframe(const guint8 * p, gint plen)
+{
+	gint offset = 1;
+
+	if (plen < 1 || !(p[0] & 0x10) || (p[0] & 0x07)) {
+		return FALSE;
+	}
+	if (p[0] & 0x80) {
+		guint8 x;
+		if (plen < 2) {
+			return FALSE;
+		}
+		x = p[1];
+		offset++;
+		if (x & 0x80) {
+			offset += (offset < plen && (p[offset] & 0x80)) ? 2 : 1;
+		}
+		if (x & 0x40) {
+			offset++;
+		}
+		if (x & 0x30) {
+			offset++;
+		}
+	}
+
+	return offset < plen && !(p[offset] & 0x01);
+}
+
+/* Beginning of a frame that is not inter-picture predicted, on the base spatial layer */
+static gboolean gop_cache_vp9_keyframe(const guint8 * p, gint plen)
+{
+	gint offset = 1;
+
+	if (plen < 1 || !(p[0] & 0x08) || (p[0] & 0x40)) {
+		return FALSE;
+	}
+	if (p[0] & 0x80) {
+		offset += (offset < plen && (p[offset] & 0x80)) ? 2 : 1;
+	}
+	if (p[0] & 0x20) {
+		if (offset >= plen) {
+			return FALSE;
+		}
+		return ((p[offset] >> 1) & 0x07) == 0;
+	}
+
+	return TRUE;
+}
+
+/* An IDR slice or an SPS, whole, aggregated (STAP-A) or in the first fragment of an FU-A */
+static gboolean gop_cache_h264_keyframe(const guint8 * p, gint plen)
+{
+	guint8 type;
+
+	if (plen < 1) {
+		return FALSE;
+	}
+
+	type = p[0] & 0x1f;
+	if (type == 5 || type == 7) {
+		return TRUE;
+	}
+	if (type == 24) {
+		gint offset = 1;
+		while (offset + 2 < plen) {
+			guint16 size = (p[offset] << 8) | p[offset + 1];
+			guint8 unit = p[offset + 2] & 0x1f;
+			if (unit == 5 || unit == 7) {
+				return TRUE;
+			}
+			offset += 2 + size;
+		}
+		return FALSE;
+	}
+	if (type == 28 && plen >= 2) {
+		type = p[1] & 0x1f;
+		return (p[1] & 0x80) && (type == 5 || type == 7);
+	}
+
+	return FALSE;
+}
+
+/* Whether the RTP packet starts a keyframe of the given codec */
+gboolean gop_cache_is_keyframe_start(gint codec, packet_buffer * buffer)
+{
+	gint plen = 0;
+	const guint8 * payload = (const guint8 *)janus_rtp_payload(buffer->data, buffer->length, &plen);
+
+	if (!payload) {
+		return FALSE;
+	}
+
+	switch (codec) {
+		case GOP_CACHE_CODEC_VP8:
+			return gop_cache_vp8_keyframe(payload, plen);
+		case GOP_CACHE_CODEC_VP9:
+			return gop_cache_vp9_keyframe(payload, plen);
+		case GOP_CACHE_CODEC_H264:
+			return gop_cache_h264_keyframe(payload, plen);
+		default:
+			return FALSE;
+	}
+}
+
+/* Called from the ingest path for every video packet */
+void gop_cache_push(gop_cache * cache, packet_buffer * buffer, gboolean keyframe)
+{
+	janus_mutex_lock(&cache->mutex);
+
+	if (keyframe) {
+		gop_cache_reset(cache);
+		cache->valid = TRUE;
+		cache->keyframes++;
+	}
+
+	if (cache->valid) {
+		if (cache->packets->len < cache->max_packets) {
+			g_ptr_array_add(cache->packets, packet_buffer_ref(buffer));
+		}
+		else {
+			/* GOP longer than we are willing to hold, wait for the next keyframe */
+			gop_cache_reset(cache);
+			cache->overflows++;
+		}
+	}
+
+	janus_mutex_unlock(&cache->mutex);
+}
+
+/* References to the cached packets older than before_seq, the packet the caller is
+ * about to relay live; NULL when there is no complete keyframe to start from */
+GPtrArray * gop_cache_snapshot(gop_cache * cache, guint16 before_seq)
+{
+	GPtrArray * snapshot = NULL;
+
+	janus_mutex_lock(&cache->mutex);
+
+	if (cache->valid && cache->packets->len) {
+		snapshot = g_ptr_array_new_with_free_func((GDestroyNotify)packet_buffer_unref);
+		for (guint i = 0; i < cache->packets->len; i++) {
+			packet_buffer * buffer = g_ptr_array_index(cache->packets, i);
+			guint16 seq = ntohs(((rtp_header *)buffer->data)->seq_number);
+			if ((gint16)(seq - before_seq) >= 0) {
+				break;
+			}
+			g_ptr_array_add(snapshot, packet_buffer_ref(buffer));
+		}
+		cache->bursts++;
+	}
+
+	janus_mutex_unlock(&cache->mutex);
+
+	return snapshot;
+}
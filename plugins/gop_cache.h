@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glib.h>
+#include "packet_pool.h"
+#include "../mutex.h"
+
+/* Timestamp spacing of the frames replayed from the cache, 1 ms at 90 kHz,
+ * so the receiver catches up with the live edge almost at once */
+#define GOP_CACHE_SQUEEZE_TICKS 90
+
+enum
+{
+	GOP_CACHE_CODEC_UNKNOWN = -1,
+	GOP_CACHE_CODEC_VP8 = 0,
+	GOP_CACHE_CODEC_H264,
+	GOP_CACHE_CODEC_VP9
+};
+
+/* The packets of the latest keyframe and of every frame after it, in arrival order */
+typedef struct gop_cache {
+	janus_mutex mutex;
+	guint max_packets;
+	GPtrArray *packets;	/* packet_buffer, one reference each */
+	gboolean valid;		/* starts on a keyframe and nothing was left out since */
+	guint64 keyframes;
+	guint64 overflows;
+	guint64 bursts;
+} gop_cache;
+
+gop_cache * gop_cache_new(guint max_packets);
+void gop_cache_free(gop_cache * cache);
+gint gop_cache_codec_from_rtpmap(const gchar * rtpmap);
+gboolean gop_cache_is_keyframe_start(gint codec, packet_buffer * buffer);
+void gop_cache_push(gop_cache * cache, packet_buffer * buffer, gboolean keyframe);
+GPtrArray * gop_cache_snapshot(gop_cache * cache, guint16 before_seq);
+void gop_cache_clear(gop_cache * cache);
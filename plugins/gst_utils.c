@@ -6,12 +6,19 @@
 #include <gst/gst.h>
 #include <gst/sdp/gstsdpmessage.h>  
 #include <gst/rtsp/rtsp.h>
+#include <gst/app/gstappsink.h>
 #include "gst_utils.h"
 #include "idilia_streaming.h"
+#include "utils.h"
 
 
 static GstElement * 
 create_remote_rtcp_input(const gchar * media, GSocket *socket);
+static GstElement * 
+create_rtcp_input(janus_streaming_mountpoint * mountpoint, gint stream_type, const gchar * media);
+static GstFlowReturn appsink_on_new_sample(GstAppSink * appsink, gpointer user_data);
+static GstFlowReturn appsink_on_new_sample_send(GstAppSink * appsink, gpointer user_data);
+static GstFlowReturn appsink_on_new_sample_push(GstAppSink * appsink, gpointer user_data);
 static void sender_bin_add_media_pads_to_rtpbin(GstElement * bin, guint pad_id, const gchar * media);
 
 
@@ -45,7 +52,7 @@ gboolean on_eos(GstBus *bus, GstMessage *message, gpointer data)
         return;
     }
 
-    janus_streaming_send_destroy_request(callback_data->mountpoint->id, callback_data->handle);
+    janus_streaming_source_lost(callback_data->mountpoint, callback_data->pipeline, callback_data->handle);
 
 	return TRUE;
 }
@@ -103,6 +110,165 @@ create_remote_rtp_output(guint port, const gchar * media)
 	return GST_ELEMENT(sinkbin);
 }
 
+static GstFlowReturn appsink_on_new_sample(GstAppSink * appsink, gpointer user_data)
+{
+	janus_streaming_socket_cbk_data * data = (janus_streaming_socket_cbk_data *)user_data;
+	GstSample * sample;
+	GstBuffer * buffer;
+	GstMapInfo map;
+
+	sample = gst_app_sink_pull_sample(appsink);
+	if (!sample) {
+		return GST_FLOW_EOS;
+	}
+
+	buffer = gst_sample_get_buffer(sample);
+	if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+		janus_streaming_incoming_source_rtp((janus_streaming_mountpoint *)data->session, data->is_video, (char *)map.data, map.size);
+		gst_buffer_unmap(buffer, &map);
+	}
+
+	gst_sample_unref(sample);
+	return GST_FLOW_OK;
+}
+
+/* One datagram per buffer: SOCK_SEQPACKET keeps the boundaries for the relay side */
+static GstFlowReturn appsink_on_new_sample_send(GstAppSink * appsink, gpointer user_data)
+{
+	socket_utils_socket * sck = (socket_utils_socket *)user_data;
+	GstSample * sample;
+	GstBuffer * buffer;
+	GstMapInfo map;
+
+	sample = gst_app_sink_pull_sample(appsink);
+	if (!sample) {
+		return GST_FLOW_EOS;
+	}
+
+	buffer = gst_sample_get_buffer(sample);
+	if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+		socket_utils_send(sck, (const gchar *)map.data, map.size);
+		gst_buffer_unmap(buffer, &map);
+	}
+
+	gst_sample_unref(sample);
+	return GST_FLOW_OK;
+}
+
+/* The streaming thread never waits on the relay, a full ring is handled by its overrun policy */
+static GstFlowReturn appsink_on_new_sample_push(GstAppSink * appsink, gpointer user_data)
+{
+	shm_ring * ring = (shm_ring *)user_data;
+	GstSample * sample;
+	GstBuffer * buffer;
+	GstMapInfo map;
+
+	sample = gst_app_sink_pull_sample(appsink);
+	if (!sample) {
+		return GST_FLOW_EOS;
+	}
+
+	buffer = gst_sample_get_buffer(sample);
+	if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+		shm_ring_push(ring, (const gchar *)map.data, map.size);
+		gst_buffer_unmap(buffer, &map);
+	}
+
+	gst_sample_unref(sample);
+	return GST_FLOW_OK;
+}
+
+static GstElement * 
+create_appsink_bin(const gchar * name, const gchar * media, GstAppSinkCallbacks * callbacks, gpointer user_data)
+{
+	GstElement * appsink, *filter;
+	GstElement *sinkbin;
+	GstPad * pad;
+	GstCaps *filtercaps;
+
+	sinkbin = gst_bin_new (NULL);
+
+	appsink = gst_element_factory_make ("appsink", name);
+	g_assert (appsink);
+	/* RTP is already timed by the source, hand every buffer over as soon as it arrives */
+	g_object_set (G_OBJECT (appsink),
+		"sync", FALSE,
+		"async", FALSE,
+		"enable-last-sample", FALSE,
+		NULL);
+	gst_app_sink_set_callbacks(GST_APP_SINK(appsink), callbacks, user_data, NULL);
+
+	filter = gst_element_factory_make ("capsfilter", "filter");
+	g_assert (filter != NULL);
+
+	filtercaps = gst_caps_new_simple ( "application/x-rtp", "media", G_TYPE_STRING, media, NULL);
+	g_object_set (G_OBJECT (filter), "caps", filtercaps, NULL);
+	gst_caps_unref (filtercaps);
+
+	gst_bin_add_many (GST_BIN (sinkbin), filter, appsink, NULL);
+	gst_element_link (filter, appsink);
+
+	pad = gst_element_get_static_pad (filter, "sink");
+	g_assert (pad);
+
+	if(gst_element_add_pad (GST_ELEMENT(sinkbin), gst_ghost_pad_new ("sink", pad)) != TRUE){
+		JANUS_LOG(LOG_INFO,"gst_element_add_pad failed \n");
+	}
+
+	gst_object_unref (GST_OBJECT (pad));
+
+	return GST_ELEMENT(sinkbin);
+}
+
+GstElement * 
+create_appsink_rtp_output(janus_streaming_socket_cbk_data * cbk_data, const gchar * media)
+{
+	GstAppSinkCallbacks callbacks = { NULL, NULL, appsink_on_new_sample };
+	gchar *name = g_strdup_printf("rtp_appsink_%s", media);
+	GstElement *sinkbin = create_appsink_bin(name, media, &callbacks, cbk_data);
+
+	g_free(name);
+	return sinkbin;
+}
+
+GstElement * 
+create_unix_rtp_output(socket_utils_socket * sck, const gchar * media)
+{
+	GstAppSinkCallbacks callbacks = { NULL, NULL, appsink_on_new_sample_send };
+	gchar *name = g_strdup_printf("rtp_unixsink_%s", media);
+	GstElement *sinkbin = create_appsink_bin(name, media, &callbacks, sck);
+
+	g_free(name);
+	return sinkbin;
+}
+
+GstElement * 
+create_shm_rtp_output(shm_ring * ring, const gchar * media)
+{
+	GstAppSinkCallbacks callbacks = { NULL, NULL, appsink_on_new_sample_push };
+	gchar *name = g_strdup_printf("rtp_shmsink_%s", media);
+	GstElement *sinkbin = create_appsink_bin(name, media, &callbacks, ring);
+
+	g_free(name);
+	return sinkbin;
+}
+
+GstElement * 
+create_rtp_output(janus_streaming_mountpoint * mountpoint, gint stream_type, const gchar * media)
+{
+	if (mountpoint->ingest == JANUS_STREAMING_INGEST_APPSINK) {
+		return create_appsink_rtp_output(&mountpoint->rtp_cbk_data[stream_type], media);
+	}
+	if (mountpoint->ingest == JANUS_STREAMING_INGEST_UNIX) {
+		return create_unix_rtp_output(&mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTP_CLI], media);
+	}
+	if (mountpoint->ingest == JANUS_STREAMING_INGEST_SHM) {
+		return create_shm_rtp_output(mountpoint->rtp_ring[stream_type], media);
+	}
+
+	return create_remote_rtp_output(mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTP_SRV].port, media);
+}
+
 static GstElement * 
 create_remote_rtcp_input(const gchar * media, GSocket *socket)
 {
@@ -118,6 +284,58 @@ create_remote_rtcp_input(const gchar * media, GSocket *socket)
     return udpsrc;
 }
 
+/* Reads the pipeline end of a socket pair, each read() returns exactly one RTCP datagram */
+static GstElement * 
+create_fd_rtcp_input(const gchar * media, GSocket *socket)
+{
+	GstElement * fdsrc, *filter;
+	GstElement *srcbin;
+	GstPad * pad;
+	GstCaps *filtercaps;
+	gchar *name = g_strdup_printf("rtcp_fdsrc_%s", media);
+
+	srcbin = gst_bin_new (NULL);
+
+	fdsrc = gst_element_factory_make ("fdsrc", name);
+	g_assert (fdsrc);
+	g_object_set (G_OBJECT (fdsrc), "fd", g_socket_get_fd(socket), NULL);
+
+	filter = gst_element_factory_make ("capsfilter", NULL);
+	g_assert (filter != NULL);
+
+	filtercaps = gst_caps_new_empty_simple ("application/x-rtcp");
+	g_object_set (G_OBJECT (filter), "caps", filtercaps, NULL);
+	gst_caps_unref (filtercaps);
+
+	gst_bin_add_many (GST_BIN (srcbin), fdsrc, filter, NULL);
+	gst_element_link (fdsrc, filter);
+
+	pad = gst_element_get_static_pad (filter, "src");
+	g_assert (pad);
+
+	if(gst_element_add_pad (GST_ELEMENT(srcbin), gst_ghost_pad_new ("src", pad)) != TRUE){
+		JANUS_LOG(LOG_INFO,"gst_element_add_pad failed \n");
+	}
+
+	gst_object_unref (GST_OBJECT (pad));
+
+	g_free(name);
+
+	return GST_ELEMENT(srcbin);
+}
+
+static GstElement * 
+create_rtcp_input(janus_streaming_mountpoint * mountpoint, gint stream_type, const gchar * media)
+{
+	GSocket *socket = mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTCP_RCV_SRV].socket;
+
+	if (mountpoint->ingest == JANUS_STREAMING_INGEST_UDP) {
+		return create_remote_rtcp_input(media, socket);
+	}
+
+	return create_fd_rtcp_input(media, socket);
+}
+
 static void sender_bin_add_media_pads_to_rtpbin(GstElement * bin, guint pad_id, const gchar * media)
 {
     GstElement * rtpbin;
@@ -185,6 +403,158 @@ GstElement * sender_bin_create (void)
     return bin;
 }
 
+/* Links the decoder output once decodebin has found the raw video */
+static void ladder_decoder_pad_added(GstElement * decoder, GstPad * pad, GstElement * converter)
+{
+	GstPad * sinkpad = gst_element_get_static_pad (converter, "sink");
+	GstCaps * caps = gst_pad_get_current_caps (pad);
+
+	if (caps && g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps, 0)), "video/x-raw")
+			&& !gst_pad_is_linked (sinkpad)) {
+		if (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK) {
+			JANUS_LOG(LOG_ERR, "Unable to link the ladder decoder\n");
+		}
+	}
+
+	if (caps)
+		gst_caps_unref (caps);
+	gst_object_unref (sinkpad);
+}
+
+/* Decodes the RTP video once and tees it into one scaled VP8 encoding per rendition,
+ * each written to the pipeline end of the rendition's socket pair */
+GstElement * 
+create_ladder_bin(janus_streaming_mountpoint * mountpoint)
+{
+	GstElement *bin, *decoder, *converter, *tee;
+	GstPad * pad;
+
+	bin = gst_bin_new ("ladder_bin");
+	g_assert (bin);
+
+	decoder = gst_element_factory_make ("decodebin", "decoder");
+	g_assert (decoder);
+	converter = gst_element_factory_make ("videoconvert", "converter");
+	g_assert (converter);
+	tee = gst_element_factory_make ("tee", "tee");
+	g_assert (tee);
+
+	gst_bin_add_many (GST_BIN (bin), decoder, converter, tee, NULL);
+	gst_element_link (converter, tee);
+	g_signal_connect(decoder, "pad-added", (GCallback) ladder_decoder_pad_added, converter);
+
+	for (guint i = 0; i < mountpoint->ladder_size; i++) {
+		janus_streaming_rendition * rendition = &mountpoint->renditions[i];
+		GstElement *queue, *scale, *filter, *encoder, *payloader, *sink;
+		GstCaps *filtercaps;
+
+		queue = gst_element_factory_make ("queue", NULL);
+		scale = gst_element_factory_make ("videoscale", NULL);
+		filter = gst_element_factory_make ("capsfilter", NULL);
+		encoder = gst_element_factory_make ("vp8enc", NULL);
+		payloader = gst_element_factory_make ("rtpvp8pay", NULL);
+		g_assert (queue && scale && filter && encoder && payloader);
+
+		/* A slow encoder drops frames of its own rendition instead of stalling the others */
+		g_object_set (G_OBJECT (queue), "leaky", 2, "max-size-buffers", 2, NULL);
+
+		filtercaps = gst_caps_new_simple ("video/x-raw",
+			"width", G_TYPE_INT, rendition->spec.width,
+			"height", G_TYPE_INT, rendition->spec.height, NULL);
+		g_object_set (G_OBJECT (filter), "caps", filtercaps, NULL);
+		gst_caps_unref (filtercaps);
+
+		/* Realtime CBR with regular keyframes, viewers switch renditions on them */
+		g_object_set (G_OBJECT (encoder),
+			"target-bitrate", (gint)rendition->spec.bitrate,
+			"end-usage", 1,
+			"deadline", (gint64)1,
+			"cpu-used", 4,
+			"keyframe-max-dist", 60,
+			NULL);
+
+		g_object_set (G_OBJECT (payloader),
+			"pt", 96,
+			"ssrc", rendition->ssrc,
+			"mtu", 1200,
+			NULL);
+
+		sink = create_unix_rtp_output(&rendition->pipeline_socket, "video");
+		g_assert (sink);
+
+		gst_bin_add_many (GST_BIN (bin), queue, scale, filter, encoder, payloader, sink, NULL);
+		gst_element_link_many (tee, queue, scale, filter, encoder, payloader, sink, NULL);
+	}
+
+	pad = gst_element_get_static_pad (decoder, "sink");
+	gst_element_add_pad (bin, gst_ghost_pad_new ("sink", pad));
+	gst_object_unref (pad);
+
+	return bin;
+}
+
+static void link_rtp_pad_to_ladder(GstPad * input_pad, pipeline_callback_t * callback_data)
+{
+	GstElement * ladder_bin = create_ladder_bin(callback_data->mountpoint);
+	GstPad * sinkpad;
+
+	gst_bin_add_many (GST_BIN (callback_data->pipeline), ladder_bin, NULL);
+	g_assert (gst_element_sync_state_with_parent (ladder_bin));
+
+	sinkpad = gst_element_get_static_pad (ladder_bin, "sink");
+	g_assert (gst_pad_link (input_pad, sinkpad) == GST_PAD_LINK_OK);
+	gst_object_unref (sinkpad);
+}
+
+/* Drops what a standby source receives until it is promoted, counting it as its cost */
+static GstPadProbeReturn
+standby_pad_probe(GstPad * pad, GstPadProbeInfo * info, pipeline_callback_t * callback_data)
+{
+	if (!g_atomic_int_get(&callback_data->standby))
+		return GST_PAD_PROBE_REMOVE;
+
+	janus_streaming_mountpoint * mountpoint = callback_data->mountpoint;
+	GstBuffer * buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	mountpoint->standby_packets++;
+	mountpoint->standby_bytes += buffer ? gst_buffer_get_size(buffer) : 0;
+	mountpoint->standby_last_packet = janus_get_monotonic_time();
+
+	return GST_PAD_PROBE_DROP;
+}
+
+/* Links the RTCP input of each media a standby source has, now that it feeds the viewers */
+void
+promote_standby_pipeline(pipeline_callback_t * callback_data)
+{
+	const gchar * medias[JANUS_STREAMING_STREAM_MAX];
+	medias[JANUS_STREAMING_STREAM_VIDEO] = "video";
+	medias[JANUS_STREAMING_STREAM_AUDIO] = "audio";
+
+	g_atomic_int_set(&callback_data->standby, 0);
+
+	GstElement * sender_bin = gst_bin_get_by_name(GST_BIN(callback_data->pipeline), "sender_bin");
+	if (!sender_bin)
+		return;
+	for (gint stream_type = 0; stream_type < JANUS_STREAMING_STREAM_MAX; stream_type++) {
+		gchar * rtcp_sinkpad_name = g_strdup_printf("%s_rtcp_sink", medias[stream_type]);
+		GstPad * sinkpad = gst_element_get_static_pad(sender_bin, rtcp_sinkpad_name);
+		g_free(rtcp_sinkpad_name);
+		if (!sinkpad)
+			continue;
+		if (!gst_pad_is_linked(sinkpad)) {
+			GstElement * rtcp_src = create_rtcp_input(callback_data->mountpoint, stream_type, medias[stream_type]);
+			gst_bin_add(GST_BIN(callback_data->pipeline), rtcp_src);
+			GstPad * rtcp_srcpad = gst_element_get_static_pad(rtcp_src, "src");
+			if (gst_pad_link(rtcp_srcpad, sinkpad) != GST_PAD_LINK_OK)
+				JANUS_LOG(LOG_ERR, "Could not link the RTCP input of the promoted %s\n", medias[stream_type]);
+			gst_object_unref(rtcp_srcpad);
+			gst_element_sync_state_with_parent(rtcp_src);
+		}
+		gst_object_unref(sinkpad);
+	}
+	gst_object_unref(sender_bin);
+}
+
 static void link_rtp_pad_to_sender_bin(GstElement * source, GstPad * input_pad, const gchar *media, pipeline_callback_t * callback_data)
 {
 
@@ -197,6 +567,18 @@ static void link_rtp_pad_to_sender_bin(GstElement * source, GstPad * input_pad,
     g_assert(pipeline);
     g_assert(media);
 
+    /* Read before linking the RTCP input: the one of the source being replaced still reads the socket */
+    gboolean standby = g_atomic_int_get(&callback_data->standby);
+    if (standby) {
+      gst_pad_add_probe(input_pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)standby_pad_probe, callback_data, NULL);
+    }
+
+    if (!g_strcmp0 (media, "video") && callback_data->mountpoint->ladder_size) {
+      /* Decoded and encoded again by the plugin, the source's own RTCP is not relayed */
+      link_rtp_pad_to_ladder(input_pad, callback_data);
+      return;
+    }
+
     sender_bin = gst_bin_get_by_name(GST_BIN(pipeline), "sender_bin");
     g_assert(sender_bin);
 
@@ -210,13 +592,10 @@ static void link_rtp_pad_to_sender_bin(GstElement * source, GstPad * input_pad,
       return;
     }
 
-    udp_sink_bin = create_remote_rtp_output(callback_data->mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTP_SRV].port, media);
+    udp_sink_bin = create_rtp_output(callback_data->mountpoint, stream_type, media);
     g_assert(udp_sink_bin);
 
-    rtcp_src = create_remote_rtcp_input(media, callback_data->mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTCP_RCV_SRV].socket);
-    g_assert(rtcp_src);
-
-    gst_bin_add_many (GST_BIN (pipeline), udp_sink_bin, rtcp_src, NULL);
+    gst_bin_add_many (GST_BIN (pipeline), udp_sink_bin, NULL);
 
     g_assert (gst_element_set_state (udp_sink_bin, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
 
@@ -233,15 +612,20 @@ static void link_rtp_pad_to_sender_bin(GstElement * source, GstPad * input_pad,
     output_sinkpad = gst_element_get_static_pad (udp_sink_bin, "sink");	
     g_assert(output_sinkpad);
   
-    senderbin_rtcp_sinkpad = gst_element_get_static_pad (sender_bin, rtcp_sinkpad_name);
-    g_assert(senderbin_rtcp_sinkpad);
-  
-    rtcp_srcpad = gst_element_get_static_pad (rtcp_src, "src");
-    g_assert(rtcp_srcpad);
-
     g_assert (gst_pad_link (input_pad, senderbin_sinkpad) == GST_PAD_LINK_OK);
     g_assert (gst_pad_link (senderbin_srcpad, output_sinkpad) == GST_PAD_LINK_OK);
-    g_assert (gst_pad_link (rtcp_srcpad, senderbin_rtcp_sinkpad) == GST_PAD_LINK_OK);
+
+    if (!standby) {
+      rtcp_src = create_rtcp_input(callback_data->mountpoint, stream_type, media);
+      g_assert(rtcp_src);
+      gst_bin_add_many (GST_BIN (pipeline), rtcp_src, NULL);
+
+      senderbin_rtcp_sinkpad = gst_element_get_static_pad (sender_bin, rtcp_sinkpad_name);
+      g_assert(senderbin_rtcp_sinkpad);
+      rtcp_srcpad = gst_element_get_static_pad (rtcp_src, "src");
+      g_assert(rtcp_srcpad);
+      g_assert (gst_pad_link (rtcp_srcpad, senderbin_rtcp_sinkpad) == GST_PAD_LINK_OK);
+    }
 
     g_free(sinkpad_name);
     g_free(srcpad_name);
@@ -261,7 +645,9 @@ rtspsrc_on_no_more_pads (GstElement *element, pipeline_callback_t * callback_dat
         return;
     }
 		
-    janus_streaming_send_watch_request(callback_data->mountpoint->id, callback_data->handle);
+    /* The viewers of a reconnected source are still watching */
+    if (!callback_data->restarted)
+        janus_streaming_send_watch_request(callback_data->mountpoint->id, callback_data->handle);
 }
 
 
@@ -304,6 +690,12 @@ rtspsrc_pad_added_callback(GstElement * element, GstPad * pad, pipeline_callback
                 connect_output = TRUE;
 		    		JANUS_LOG (LOG_ERR, "\n ISSUE: audio media type: %s\n", callback_data->mountpoint->codecs.audio_rtpmap);
             } else if (!g_strcmp0 (media, "video")) {
+				if (callback_data->mountpoint->ladder_size) {
+					/* Viewers get the renditions, see create_ladder_bin() */
+					payload = 96;
+					encoding_name = "VP8";
+					clock_rate = 90000;
+				}
 				callback_data->mountpoint->codecs.isVideo = TRUE;				
 				callback_data->mountpoint->codecs.video_pt = payload;
 				callback_data->mountpoint->codecs.video_rtpmap = g_strdup_printf ("%d %s/%d", payload, encoding_name,clock_rate);									
@@ -417,6 +809,52 @@ GstElement * create_rtsp_source_element(gpointer user_data, const pipeline_data_
   return source;
 }
 
+/* Bitrate in bits per second: vp8enc/vp9enc take it as target-bitrate, x264enc as kbit/s bitrate */
+void
+set_encoder_bitrate(GstElement * encoder, guint64 bitrate)
+{
+  GObjectClass *klass = G_OBJECT_GET_CLASS(encoder);
+
+  if (g_object_class_find_property(klass, "target-bitrate")) {
+    g_object_set(G_OBJECT(encoder), "target-bitrate", (gint)MIN(bitrate, G_MAXINT), NULL);
+  } else if (g_object_class_find_property(klass, "bitrate")) {
+    g_object_set(G_OBJECT(encoder), "bitrate", (guint)MAX(bitrate / 1000, 1), NULL);
+  } else {
+    JANUS_LOG(LOG_WARN, "Encoder %s has no bitrate property\n", GST_ELEMENT_NAME(encoder));
+  }
+}
+
+/* VP8 temporal scalability with the usual dyadic patterns, each layer doubling the frame rate */
+void
+set_encoder_temporal_layers(GstElement * encoder, guint layers)
+{
+  static const gchar *layer_ids[TEMPORAL_LAYERS_MAX] = { "<0>", "<0,1>", "<0,2,1,2>", "<0,3,2,3,1,3,2,3>" };
+  static const gchar *decimators[TEMPORAL_LAYERS_MAX] = { "<1>", "<2,1>", "<4,2,1>", "<8,4,2,1>" };
+  gint bitrate = 0;
+  GString *bitrates;
+
+  layers = CLAMP(layers, 1, TEMPORAL_LAYERS_MAX);
+  if (layers < 2)
+    return;
+
+  g_object_get (G_OBJECT (encoder), "target-bitrate", &bitrate, NULL);
+  bitrates = g_string_new ("<");
+  for (guint layer = 0; layer < layers; layer++) {
+    g_string_append_printf (bitrates, "%s%u", layer ? "," : "", (guint)((guint64)bitrate * temporal_layers_share(layers, layer) / 100));
+  }
+  g_string_append (bitrates, ">");
+
+  g_object_set (G_OBJECT (encoder),
+      "temporal-scalability-number-layers", (gint)layers,
+      "temporal-scalability-periodicity", (gint)(1 << (layers - 1)),
+      NULL);
+  gst_util_set_object_arg (G_OBJECT (encoder), "temporal-scalability-layer-id", layer_ids[layers - 1]);
+  gst_util_set_object_arg (G_OBJECT (encoder), "temporal-scalability-rate-decimator", decimators[layers - 1]);
+  gst_util_set_object_arg (G_OBJECT (encoder), "temporal-scalability-target-bitrate", bitrates->str);
+
+  g_string_free (bitrates, TRUE);
+}
+
 //todo: fill codecs params in the mountpoint
 GstElement *
 create_videotestsrc_bin (gpointer user_data, const pipeline_data_t * pipeline_data)
@@ -17,6 +17,8 @@ typedef struct {
 	janus_plugin_session *handle;
 	GstElement * pipeline;
 	const gchar *uri;
+	gboolean restarted;	/* built again after its source was lost, or a standby */
+	volatile gint standby;	/* what it receives is dropped until it is promoted */
 } pipeline_callback_t;
 
 
@@ -28,3 +30,19 @@ GstElement *
 create_videotestsrc_bin (gpointer user_data, const pipeline_data_t * pipeline_data);
 GstElement * 
 create_remote_rtp_output(guint port, const gchar * media);
+GstElement * 
+create_appsink_rtp_output(janus_streaming_socket_cbk_data * cbk_data, const gchar * media);
+GstElement * 
+create_unix_rtp_output(socket_utils_socket * sck, const gchar * media);
+GstElement * 
+create_shm_rtp_output(shm_ring * ring, const gchar * media);
+GstElement * 
+create_ladder_bin(janus_streaming_mountpoint * mountpoint);
+void
+set_encoder_bitrate(GstElement * encoder, guint64 bitrate);
+void
+set_encoder_temporal_layers(GstElement * encoder, guint layers);
+GstElement * 
+create_rtp_output(janus_streaming_mountpoint * mountpoint, gint stream_type, const gchar * media);
+void
+promote_standby_pipeline(pipeline_callback_t * callback_data);
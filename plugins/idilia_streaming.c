@@ -80,10 +80,12 @@ url = RTSP stream URL (only if type=rtsp)
  * (invalid JSON, invalid request) which will always result in a
  * synchronous error response even for asynchronous requests. 
  * 
- * \c list , \c create , \c destroy , \c recording , \c enable and
- * \c disable are synchronous requests, which means you'll
+ * \c list , \c info , \c stats , \c create , \c destroy , \c recording ,
+ * \c enable and \c disable are synchronous requests, which means you'll
  * get a response directly within the context of the transaction. \c list
- * lists all the available streams; \c create allows you to create a new
+ * lists all the available streams; \c info and \c stats return counters
+ * for a single mountpoint and for the plugin as a whole respectively;
+ * \c create allows you to create a new
  * mountpoint dynamically, as an alternative to using the configuration
  * file; \c destroy removes a mountpoint and destroys it; \c recording
  * instructs the plugin on whether or not a live RTP stream should be
@@ -140,6 +142,12 @@ url = RTSP stream URL (only if type=rtsp)
 #include "gst_utils.h"
 #include "ports_pool.h"
 #include "curl_utils.h"
+#include "context_pool.h"
+#include "fanout_pool.h"
+#include "packet_pool.h"
+#include "trace.h"
+#include "shm_ring.h"
+#include <glib-unix.h>
 #include <gst/gst.h>
 #include <gst/sdp/gstsdpmessage.h>  
 #include <gst/rtsp/rtsp.h>
@@ -217,7 +225,10 @@ static struct janus_json_parameter create_parameters[] = {
 	{"type", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
 	{"secret", JSON_STRING, 0},
 	{"pin", JSON_STRING, 0},
-	{"permanent", JANUS_JSON_BOOL, 0}
+	{"permanent", JANUS_JSON_BOOL, 0},
+	{"ingest", JSON_STRING, 0},
+	{"videobufferkf", JANUS_JSON_BOOL, 0},
+	{"ladder", JANUS_JSON_BOOL, 0}
 };
 
 /* Static configuration instance */
@@ -245,6 +256,74 @@ static char *admin_key = NULL;
 /* configuration options */
 static uint16_t udp_min_port = 0, udp_max_port = 0;
 static guint latency = 0;
+static gint default_ingest = JANUS_STREAMING_INGEST_UDP;
+static guint rtp_batch_size = 1;
+static guint relay_threads = 0;
+static context_pool *relay_pool = NULL;
+static guint fanout_threads = 0;
+static guint fanout_threshold = 500;
+static fanout_pool *fanout = NULL;
+static pacer *viewer_pacer = NULL;
+static guint pacing_interval = 0;
+static gdouble pacing_multiplier = 2.5;
+static guint mountpoint_linger = 0;
+/* Unwatched mountpoints watched again before their linger ran out, and torn down after it; under mountpoints_mutex */
+static guint64 linger_hits = 0;
+static guint64 linger_misses = 0;
+/* Mountpoints whose source resolves to the same uri share its pipeline: the later ids are
+ * registered as aliases of the first mountpoint; under mountpoints_mutex */
+static gboolean share_sources = TRUE;
+static GHashTable *shared_sources = NULL;	/* normalized uri -> mountpoint */
+static guint64 shared_attaches = 0;
+static guint preload_concurrency = 2;
+static guint preload_timeout = 10000;
+static GThreadPool *preload_pool = NULL;
+
+/* A "type = source" category of the configuration, started at init before any viewer asks for it */
+typedef struct janus_streaming_preload {
+	gchar *id;
+	gchar *uri;
+	gchar *backup;	/* Run as a hot standby of uri, optional */
+	gchar *name;
+	gchar *description;
+	gchar *pin;
+	gboolean is_private;
+	gint ingest;
+	gboolean buffer_kf;
+	gboolean ladder;
+	volatile gint state;
+	gint64 ready_time;		/* milliseconds from the pipeline start to the first packet */
+} janus_streaming_preload;
+#define JANUS_STREAMING_PRELOAD_QUEUED		0
+#define JANUS_STREAMING_PRELOAD_STARTING	1
+#define JANUS_STREAMING_PRELOAD_READY		2
+#define JANUS_STREAMING_PRELOAD_TIMEOUT		3
+#define JANUS_STREAMING_PRELOAD_FAILED		4
+static GList *preloads = NULL;	/* Read-only after init */
+static guint packet_pool_size = 1024;
+static guint shm_ring_slots = 1024;
+static gint io_backend = SOCKET_UTILS_BACKEND_GLIB;
+static gint shm_ring_overrun_policy = SHM_RING_DROP_OLDEST;
+static gint socket_rcvbuf = 0;
+static gint socket_sndbuf = 0;
+static gint socket_rcvbuf_max = 4 * 1024 * 1024;
+static gboolean video_buffer_kf = TRUE;
+static guint gop_cache_max_packets = 1024;
+static guint pli_window = 500;
+static guint pli_keyframe_timeout = 1000;
+static guint nack_history_depth = 500;
+static gint remb_percentile = 0;
+static guint remb_interval = 1000;
+static guint temporal_layers = 1;
+static ladder_rendition_spec *ladder_specs = NULL;
+static guint ladder_count = 0;
+/* Microseconds a viewer stays on a rendition before it may be moved up again */
+#define JANUS_STREAMING_LADDER_UPGRADE_HOLD (5 * G_USEC_PER_SEC)
+
+/* Per-packet conditions, logged in aggregate by the watchdog */
+static trace_counter invalid_relay_packets = TRACE_COUNTER_INIT(LOG_ERR, "Invalid packets dropped by the relay");
+static trace_counter invalid_relay_sessions = TRACE_COUNTER_INIT(LOG_ERR, "Packets dropped for invalid sessions");
+static trace_counter not_started_packets = TRACE_COUNTER_INIT(LOG_INFO, "Packets skipped for sessions not started yet or paused");
 
 typedef struct janus_streaming_message {
 	janus_plugin_session *handle;
@@ -264,7 +343,20 @@ typedef struct janus_streaming_session {
 	gboolean stopping;
 	volatile gint hangingup;
 	gint64 destroyed;	/* Time at which this session was marked as destroyed */
+	guint fanout_shard;	/* Fixed for the session lifetime, keeps its packets on one fanout worker */
+	volatile gint burst_pending;	/* The cached GOP goes out right before the first live video packet */
+	/* Ladder mountpoints only */
+	volatile gint rendition_target;	/* chosen from the viewer's REMB and loss reports */
+	gint rendition;	/* being sent, -1 until the first keyframe of the target; relay thread only */
+	gint64 rendition_switched;
+	guint64 remb_estimate;
+	guint64 rendition_switches;
+	ladder_rewrite ladder;
+	temporal_layers_filter temporal;	/* VP8 temporal layers forwarded to this viewer */
+	janus_mutex temporal_mutex;	/* The relay path updates the filter while NACKs are mapped back on the RTCP thread */
+	pacer_queue *pacing;	/* Video sent at a multiple of the viewer's estimate, NULL when not paced */
 } janus_streaming_session;
+static volatile gint next_fanout_shard = 0;
 static GHashTable *sessions;
 static GList *old_sessions;
 static janus_mutex sessions_mutex;
@@ -276,20 +368,63 @@ typedef struct janus_streaming_rtp_relay_packet {
 	gint is_video;
 	uint32_t timestamp;
 	uint16_t seq_number;
+	gboolean is_vp8;
+	temporal_layers_vp8_info vp8;	/* parsed once on the relay path when is_vp8 */
 } janus_streaming_rtp_relay_packet;
 
+/* A slice of a listeners snapshot to be serviced by a fanout worker,
+ * all the tasks of a packet share one reference-counted pool buffer */
+typedef struct janus_streaming_fanout_task {
+	janus_streaming_listeners *listeners;
+	guint start, end;
+	packet_buffer *buffer;
+	janus_streaming_rtp_relay_packet packet;
+} janus_streaming_fanout_task;
+
 
 /* function declarations */
 static void janus_streaming_mountpoint_free(gpointer data);
+static void janus_streaming_mountpoint_unref(gpointer data);
+static void janus_streaming_unregister_mountpoint(janus_streaming_mountpoint *mp);
 janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 		janus_plugin_session *handle,
-		const gchar *id, char *name, char *desc);
+		const gchar *id, char *name, char *desc, gint ingest, gboolean buffer_kf, gboolean ladder,
+		gboolean is_private, const gchar *secret, const gchar *pin, janus_streaming_mountpoint **shared_with);
 static void janus_streaming_parse_ports_range(janus_config_item *ports_range, uint16_t * udp_min_port, uint16_t * udp_max_port);
-static gboolean janus_streaming_create_sockets(socket_utils_socket socket[JANUS_STREAMING_STREAM_MAX][JANUS_STREAMING_SOCKET_MAX]);
+static gint janus_streaming_parse_ingest(const char *value);
+static const char *janus_streaming_ingest_str(gint ingest);
+static json_t *janus_streaming_mountpoint_stats(janus_streaming_mountpoint *mp);
+static json_t *janus_streaming_plugin_stats(void);
+static gboolean janus_streaming_create_sockets(socket_utils_socket socket[JANUS_STREAMING_STREAM_MAX][JANUS_STREAMING_SOCKET_MAX], gint ingest);
 gboolean janus_streaming_send_rtp_src_received(GSocket *socket, GIOCondition condition, janus_streaming_socket_cbk_data * data);
+static gboolean janus_streaming_rtp_ring_ready(gint fd, GIOCondition condition, gpointer user_data);
 static void janus_streaming_relay_rtp_packet(gpointer data, gpointer user_data);
+static void janus_streaming_incoming_source_packet(janus_streaming_mountpoint * mountpoint, gboolean is_video, packet_buffer * buffer);
+static void janus_streaming_relay_source_packet(janus_streaming_mountpoint * mountpoint, gboolean is_video, packet_buffer * buffer);
+static void janus_streaming_source_reconnected(janus_streaming_mountpoint * mountpoint, gint64 now);
+static void janus_streaming_burst_gop(janus_streaming_session *session, janus_streaming_rtp_relay_packet *live);
+static void janus_streaming_send_source_rtcp(janus_streaming_mountpoint *mountpoint, char *buf, int len);
+static gboolean janus_streaming_flush_keyframe_requests(gpointer user_data);
+static void janus_streaming_apply_bitrate(janus_streaming_mountpoint *mountpoint, guint64 bitrate);
+static gboolean janus_streaming_rendition_rtp_received(GSocket *socket, GIOCondition condition, janus_streaming_socket_cbk_data * data);
+static void janus_streaming_select_rendition(janus_streaming_session *session, janus_streaming_mountpoint *mountpoint, guint64 estimate, gint fraction_lost);
+static void janus_streaming_select_temporal_layer(janus_streaming_session *session, janus_streaming_mountpoint *mountpoint);
+static void janus_streaming_relay_shifted_packet(janus_streaming_session *session, const char *buf, int len, guint16 seq_offset, guint16 picture_id_offset);
+static void janus_streaming_relay_video_packet(janus_streaming_session *session, char *buf, int len, const temporal_layers_vp8_info *vp8, gint seq);
+static void janus_streaming_relay_to_viewer(janus_streaming_session *session, gboolean is_video, char *buf, int len);
+static void janus_streaming_pacer_send(gpointer user_data, gboolean is_video, char *buf, int len);
+static void janus_streaming_update_pacing(janus_streaming_session *session);
 static void janus_streaming_destroy_mountpoint(gchar *id_value);
 static void janus_streaming_destroy_mountpoint_if_not_used(janus_streaming_session *session);
+static void janus_streaming_expire_mountpoint(janus_streaming_mountpoint *mp);
+static void janus_streaming_parse_preloads(janus_config *config);
+static void janus_streaming_preload_run(gpointer data, gpointer user_data);
+static void janus_streaming_preload_free(gpointer data);
+static const gchar *janus_streaming_preload_state_str(gint state);
+static void janus_streaming_publish_listeners(janus_streaming_mountpoint *mp);
+static janus_streaming_listeners *janus_streaming_listeners_get(janus_streaming_mountpoint *mp);
+static void janus_streaming_listeners_unref(janus_streaming_listeners *listeners);
+static void janus_streaming_fanout_task_run(gpointer data);
 
 
 static void
@@ -313,12 +448,89 @@ print_hash_value (gpointer key, gpointer val, gpointer data)
 static const gchar *janus_endpoint = NULL;
 static const gchar *registry_endpoint = NULL;
 
-static GHashTable *transcode_threads = NULL;
-static GHashTable *transcode_main_loops = NULL;
-
-
-janus_mutex transcode_threads_mutex;
-janus_mutex transcode_main_loops_mutex;
+/* Pipelines are driven from a fixed set of threads, each running the bus watches of the
+ * pipelines assigned to it */
+typedef struct janus_streaming_pipeline {
+	gchar *id;
+	pipeline_data_t data;
+	janus_streaming_mountpoint *mountpoint;
+	pipeline_callback_t *callback_data;	/* Handed to the bus and rtspsrc callbacks of this build */
+	context_pool_thread *thread;
+	GstElement *pipeline;	/* NULL until started, if it could not be, or while reconnecting */
+	GSource *bus_source;
+	GSource *restart_source;	/* Pending reconnection of a lost source */
+	guint restarts;
+	gchar *standby_uri;	/* Backup of the source run as a hot standby, NULL if none */
+	GstElement *standby;	/* Receives but feeds nothing until promoted */
+	GSource *standby_bus_source;
+	pipeline_callback_t *standby_callback_data;
+	GSource *standby_restart_source;
+	guint standby_attempts;
+	GSource *gap_source;	/* Fails over when the primary goes quiet */
+} janus_streaming_pipeline;
+
+typedef struct janus_streaming_pipeline_call {
+	volatile gint ref;	/* The caller's and the pipeline thread's, the caller may stop waiting first */
+	GSourceFunc func;
+	gpointer data;
+	janus_mutex mutex;
+	janus_condition cond;
+	gboolean done;
+} janus_streaming_pipeline_call;
+
+static guint pipeline_threads = 0;	/* 0 = one per core */
+static context_pool *pipeline_pool = NULL;
+static GHashTable *pipelines = NULL;	/* mountpoint id -> janus_streaming_pipeline */
+static janus_mutex pipelines_mutex;
+static gboolean janus_streaming_pipeline_start(gpointer data);
+static gboolean janus_streaming_pipeline_build(janus_streaming_pipeline *p, gboolean standby);
+static void janus_streaming_schedule_restart(janus_streaming_pipeline *p);
+static void janus_streaming_schedule_standby_restart(janus_streaming_pipeline *p);
+static gboolean janus_streaming_watch_gap(gpointer data);
+
+/* Lost sources are reconnected after a backoff instead of destroying their mountpoint */
+static gboolean source_reconnect = FALSE;
+static guint reconnect_min_delay = 500;
+static guint reconnect_max_delay = 30000;
+/* Silence of the primary after which a source with a backup fails over to its standby */
+static guint failover_gap = 200;
+
+/* Pipelines are stopped in the background: a pipeline that does not reach NULL
+ * before its deadline is abandoned. Its mountpoint's relay thread, callbacks and
+ * caches are released then, its sockets, ports and rings stay quarantined until it
+ * finally stops, as its elements may still write to them */
+typedef struct janus_streaming_reap {
+	janus_streaming_pipeline *pipeline;	/* NULL if the mountpoint had none */
+	janus_streaming_mountpoint *mountpoint;	/* NULL to only stop the pipeline */
+	gint64 queued;
+	gint64 deadline;
+	gboolean abandoned;
+	janus_streaming_pipeline_call *detach;	/* Queued on the pipeline thread, NULL once done */
+	gboolean stopping;	/* NULL state requested */
+	gboolean parked;	/* Gave its reaper thread back, the watchdog queues it again */
+	gboolean relay_released;	/* Past its deadline, only the quarantined resources are left */
+} janus_streaming_reap;
+/* Bucket i counts the teardowns that took less than 2^i milliseconds */
+#define JANUS_STREAMING_TEARDOWN_BUCKETS 17
+/* Reaper threads; a job never holds one past its deadline, or for more than a retry after it */
+#define JANUS_STREAMING_REAPER_THREADS 4
+#define JANUS_STREAMING_REAP_RETRY_MS 500
+static guint teardown_timeout = 5000;
+static GThreadPool *reaper = NULL;
+static janus_mutex reaper_mutex;
+static GList *reaping = NULL;	/* Jobs not done yet, under reaper_mutex like the counters */
+static guint64 teardown_latency[JANUS_STREAMING_TEARDOWN_BUCKETS];
+static guint64 teardowns_completed = 0;
+static guint64 teardowns_abandoned = 0;
+static guint64 teardowns_late = 0;	/* abandoned, but stopped eventually */
+static void janus_streaming_reap_pipeline(janus_streaming_pipeline *p, janus_streaming_mountpoint *mountpoint);
+static void janus_streaming_reap_run(gpointer data, gpointer user_data);
+static void janus_streaming_reap_park(janus_streaming_reap *job);
+static void janus_streaming_release_sockets(janus_streaming_mountpoint *mountpoint);
+static void janus_streaming_abandon_teardowns(gint64 now);
+static janus_streaming_pipeline_call *janus_streaming_pipeline_call_async(context_pool_thread *thread, GSourceFunc func, gpointer data);
+static gboolean janus_streaming_pipeline_call_wait(janus_streaming_pipeline_call *call, gint64 until);
+static void janus_streaming_pipeline_call_unref(janus_streaming_pipeline_call *call);
 
 
 
@@ -365,6 +577,8 @@ static gchar *random_id(void) {
 
 }
 
+/* Hands the pipeline of a mountpoint to the reaper, which also releases the mountpoint's
+ * sockets, rings and relay thread once it is stopped; returns right away */
 static void teardown_pipeline(janus_streaming_mountpoint *mountpoint) {
 
 	JANUS_LOG(LOG_INFO, "teardown_pipeline\n");
@@ -374,28 +588,91 @@ static void teardown_pipeline(janus_streaming_mountpoint *mountpoint) {
 		return;
 	}
 
-	janus_mutex_lock(&transcode_main_loops_mutex);
-	GMainLoop *main_loop = g_hash_table_lookup(transcode_main_loops,mountpoint->id);
-	if (main_loop != NULL) {
-		g_hash_table_remove(transcode_main_loops, mountpoint->id);
-		if (g_main_loop_is_running (main_loop)) {
-			JANUS_LOG(LOG_INFO, "\n main_loop_quit \n");		
-			g_main_loop_quit(main_loop);
+	janus_mutex_lock(&pipelines_mutex);
+	janus_streaming_pipeline *p = g_hash_table_lookup(pipelines, mountpoint->id);
+	if (p)
+		g_hash_table_steal(pipelines, mountpoint->id);
+	janus_mutex_unlock(&pipelines_mutex);
+
+	janus_streaming_reap_pipeline(p, mountpoint);
+}
+
+/* Removes the ring and socket callbacks and the keyframe request timer of a mountpoint; runs
+ * on its relay thread, so that none of them is being dispatched once it returns */
+static gboolean janus_streaming_relay_detach(gpointer data) {
+
+	janus_streaming_mountpoint *mountpoint = (janus_streaming_mountpoint *)data;
+
+	for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
+		if (mountpoint->rtp_ring_source[stream]) {
+			g_source_destroy(mountpoint->rtp_ring_source[stream]);
+			g_source_unref(mountpoint->rtp_ring_source[stream]);
+			mountpoint->rtp_ring_source[stream] = NULL;
+		}
+		for (int j = 0; j < JANUS_STREAMING_SOCKET_MAX; j++) {
+			socket_utils_deattach_callback(&mountpoint->socket[stream][j]);
+		}
+	}
+	for (guint i = 0; i < mountpoint->ladder_size; i++) {
+		socket_utils_deattach_callback(&mountpoint->renditions[i].socket);
+	}
+	/* Sends on the sockets closed next */
+	if (mountpoint->keyframe_requests_source) {
+		g_source_destroy(mountpoint->keyframe_requests_source);
+		g_source_unref(mountpoint->keyframe_requests_source);
+		mountpoint->keyframe_requests_source = NULL;
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Releases the relay thread of a mountpoint once it dropped its callbacks, it does not
+ * block on anything unlike a pipeline thread; also at the deadline of an abandoned
+ * teardown, calling it again once the pipeline stopped is harmless */
+static void janus_streaming_release_relay(janus_streaming_mountpoint *mountpoint) {
+
+	if (!mountpoint->relay_thread) {
+		janus_streaming_relay_detach(mountpoint);
+	} else {
+		janus_streaming_pipeline_call *call = janus_streaming_pipeline_call_async(mountpoint->relay_thread, janus_streaming_relay_detach, mountpoint);
+		while (!janus_streaming_pipeline_call_wait(call, janus_get_monotonic_time() + G_USEC_PER_SEC)) {
+			JANUS_LOG(LOG_WARN, "Relay thread %u still busy, waiting to release %s\n", mountpoint->relay_thread->index, mountpoint->id);
 		}
-		g_main_loop_unref(main_loop);
-		main_loop = NULL; 
+		janus_streaming_pipeline_call_unref(call);
+	}
+
+	context_pool_thread_release(mountpoint->relay_thread);
+	mountpoint->relay_thread = NULL;
+	if (mountpoint->gop)
+		gop_cache_clear(mountpoint->gop);
+	if (mountpoint->nack)
+		nack_history_clear(mountpoint->nack);
+}
+
+/* What the pipeline of a mountpoint used, once it stopped; the shared memory rings of an
+ * abandoned one stay mapped as long as it may still write to them. Called without
+ * reaper_mutex, as it waits for the relay thread */
+static void janus_streaming_release_pipeline(janus_streaming_mountpoint *mountpoint) {
+
+	janus_mutex_lock(&mountpoint->mutex);
+	if (mountpoint->encoder) {
+		gst_object_unref(mountpoint->encoder);
+		mountpoint->encoder = NULL;
 	}
-	janus_mutex_unlock(&transcode_main_loops_mutex);
+	janus_mutex_unlock(&mountpoint->mutex);
 
-	janus_mutex_lock(&transcode_threads_mutex);
-	GThread * thread = g_hash_table_lookup(transcode_threads, mountpoint->id);
-	if(thread){
-		JANUS_LOG(LOG_INFO, "\nThread join\n");		
-		g_hash_table_remove(transcode_threads, mountpoint->id);					
-		g_thread_join(thread);
-		thread = NULL;								
+	/* Nothing reads the rings or the sockets anymore past this point */
+	janus_streaming_release_relay(mountpoint);
+	for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
+		shm_ring_free(mountpoint->rtp_ring[stream]);
+		mountpoint->rtp_ring[stream] = NULL;
 	}
-	janus_mutex_unlock(&transcode_threads_mutex);
+
+	janus_streaming_release_sockets(mountpoint);
+}
+
+/* Sockets and ports of a mountpoint, released once its pipeline stopped, however late */
+static void janus_streaming_release_sockets(janus_streaming_mountpoint *mountpoint) {
 
 	JANUS_LOG(LOG_INFO, "Close sockets\n");	
 	for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
@@ -403,36 +680,28 @@ static void teardown_pipeline(janus_streaming_mountpoint *mountpoint) {
 			socket_utils_close_socket(&mountpoint->socket[stream][j]);
 		}
 	}
-
-	JANUS_LOG(LOG_INFO, "teardown_pipeline end\n");
+	for (guint i = 0; i < mountpoint->ladder_size; i++) {
+		socket_utils_close_socket(&mountpoint->renditions[i].socket);
+		socket_utils_close_socket(&mountpoint->renditions[i].pipeline_socket);
+	}
 }
 
-static gpointer transcode_handler(gpointer data) {
+/* Builds the pipeline of a mountpoint and starts it; runs on the pipeline thread it was
+ * assigned to, whose context the bus watch is attached to */
+static gboolean janus_streaming_pipeline_start(gpointer data) {
 
-	GstElement *pipeline = NULL;	
-	GstBus *bus = NULL;
-	GSource *bus_source = NULL;
-	GMainContext *context = NULL;
-	GMainLoop *main_loop = NULL;
+	janus_streaming_pipeline *p = (janus_streaming_pipeline *)data;
 
-	pipeline_data_t *pipeline_data = (pipeline_data_t *)data;
-
-	JANUS_LOG(LOG_INFO, "Enter transcode_handler\n");
+	JANUS_LOG(LOG_INFO, "Starting the pipeline of %s on pipeline thread %u\n", p->id, p->thread->index);
 
 	do
 	{
-		if (!pipeline_data) {
-			JANUS_LOG(LOG_ERR, "Input parameter data is null.\n");
-			break;
-		}
-
-		if (!pipeline_data->uri) {
+		if (!p->data.uri) {
 			JANUS_LOG(LOG_ERR, "Invalid format of uri\n");
 			break;
 		}
-		janus_mutex_lock(&mountpoints_mutex);
-		janus_streaming_mountpoint *mountpoint = g_hash_table_lookup(mountpoints, pipeline_data->id);
-		janus_mutex_unlock(&mountpoints_mutex);
+		/* Not looked up here: the mountpoint may be torn down under mountpoints_mutex, waiting for this thread */
+		janus_streaming_mountpoint *mountpoint = p->mountpoint;
 
 		if (!mountpoint) {
 			JANUS_LOG(LOG_ERR, "Invalid mountpoint ptr\n");
@@ -441,76 +710,158 @@ static gpointer transcode_handler(gpointer data) {
 
 		memset(mountpoint->socket, 0, sizeof(mountpoint->socket));
 
-		if (!janus_streaming_create_sockets(mountpoint->socket))
+		if (!janus_streaming_create_sockets(mountpoint->socket, mountpoint->ingest))
 		{
 			JANUS_LOG(LOG_FATAL, "Unable to create one or more sockets!\n");
 			break;
 		}
 
-		GstElement *sender_bin, *source = NULL;
-		pipeline_callback_t callback_data;
-
-		/* create a new pipeline to hold the elements */
-		pipeline = gst_pipeline_new ("pipeline");
-		g_assert (pipeline);
-
-		sender_bin = sender_bin_create();
-		g_assert (sender_bin);
-    	gst_bin_add_many (GST_BIN (pipeline), sender_bin, NULL);
-
-		callback_data.pipeline = pipeline;
-		callback_data.mountpoint = mountpoint;
-		callback_data.uri = pipeline_data->uri;
-		callback_data.handle = pipeline_data->handle;
-
-		if (g_str_has_prefix (pipeline_data->uri, "rtsp://")) {
-			source = create_rtsp_source_element(&callback_data, pipeline_data);
-			gst_bin_add_many (GST_BIN (pipeline), source, NULL);
-		} else if (g_str_has_prefix (pipeline_data->uri, "videotestsrc://")) { 
-			source = create_videotestsrc_bin(pipeline, pipeline_data);
-			GstElement * output_bin = create_remote_rtp_output(
-				mountpoint->socket[JANUS_STREAMING_STREAM_VIDEO][JANUS_STREAMING_SOCKET_RTP_SRV].port, 
-				"video");
-			gst_bin_add_many (GST_BIN (pipeline), source, output_bin, NULL);
-			gst_element_link_many (source, sender_bin, output_bin, NULL);
-		} else {
-			JANUS_LOG(LOG_ERR, "Unsupported source protocol!\n");
+		gboolean renditions_ready = TRUE;
+		for (guint i = 0; i < mountpoint->ladder_size && renditions_ready; i++)
+		{
+			janus_streaming_rendition *rendition = &mountpoint->renditions[i];
+			memset(&rendition->socket, 0, sizeof(rendition->socket));
+			memset(&rendition->pipeline_socket, 0, sizeof(rendition->pipeline_socket));
+			renditions_ready = socket_utils_create_socket_pair(&rendition->socket, &rendition->pipeline_socket);
+		}
+		if (!renditions_ready) {
+			JANUS_LOG(LOG_FATAL, "Unable to create the rendition sockets!\n");
 			break;
 		}
 
-		/* Attach RTP callback */
+		gboolean rings_ready = TRUE;
 		for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++)
 		{
 			mountpoint->rtp_cbk_data[stream].session = (gpointer)mountpoint;
 			mountpoint->rtp_cbk_data[stream].is_video = (stream == JANUS_STREAMING_STREAM_VIDEO);
 
-			socket_utils_attach_callback(&mountpoint->socket[stream][JANUS_STREAMING_SOCKET_RTP_SRV],
-				(GSourceFunc)janus_streaming_send_rtp_src_received,
-				(gpointer)&mountpoint->rtp_cbk_data[stream]);
+			if (mountpoint->ingest == JANUS_STREAMING_INGEST_SHM && !mountpoint->rtp_ring[stream]) {
+				gchar *ring_name = g_strdup_printf("streaming-%s-%s", mountpoint->id, stream == JANUS_STREAMING_STREAM_VIDEO ? "video" : "audio");
+				mountpoint->rtp_ring[stream] = shm_ring_new(ring_name, shm_ring_slots, shm_ring_overrun_policy);
+				g_free(ring_name);
+				rings_ready = rings_ready && mountpoint->rtp_ring[stream];
+			}
 		}
-
-		if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(pipeline, GST_STATE_PLAYING)) {
-			JANUS_LOG(LOG_ERR, "Could not change state of pipeline to PLAYING state.\n");
+		if (!rings_ready) {
+			JANUS_LOG(LOG_FATAL, "Unable to create the shared memory rings!\n");
 			break;
 		}
 
-		GstState state;
-		GstStateChangeReturn ret;
-	//todo: cleanup
-#if 0
-		do
+		/* Attach RTP callback, the appsink ingest feeds the relay from the streaming threads instead.
+		 * Set up once: a reconnected source feeds the same sockets and rings */
+		gboolean relayed_ingest = mountpoint->ingest != JANUS_STREAMING_INGEST_APPSINK;
+		if ((relayed_ingest || mountpoint->ladder_size) && relay_pool) {
+			mountpoint->relay_thread = context_pool_get_by_key(relay_pool, mountpoint->id);
+			context_pool_thread_assign(mountpoint->relay_thread);
+		}
+		for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX && mountpoint->ingest == JANUS_STREAMING_INGEST_SHM; stream++)
+		{
+			GSource *ring_source = g_unix_fd_source_new(mountpoint->rtp_ring[stream]->event_fd, G_IO_IN);
+			g_source_set_callback(ring_source, (GSourceFunc)janus_streaming_rtp_ring_ready,
+				(gpointer)&mountpoint->rtp_cbk_data[stream], NULL);
+			g_source_attach(ring_source, mountpoint->relay_thread ? mountpoint->relay_thread->context : NULL);
+			mountpoint->rtp_ring_source[stream] = ring_source;
+		}
+		for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX && relayed_ingest && mountpoint->ingest != JANUS_STREAMING_INGEST_SHM; stream++)
 		{
-			if (GST_STATE_CHANGE_FAILURE == (ret = gst_element_get_state(pipeline,
-				&state, NULL, GST_CLOCK_TIME_NONE))) {
-				JANUS_LOG(LOG_ERR, "Could not change state of pipeline to PLAYING state.\n");
-				break;
+			if (rtp_batch_size > 1 && !mountpoint->rtp_batch[stream].size) {
+				socket_utils_batch_init(&mountpoint->rtp_batch[stream], rtp_batch_size);
 			}
+
+			socket_utils_attach_callback_to_context(&mountpoint->socket[stream][JANUS_STREAMING_SOCKET_RTP_SRV],
+				(GSourceFunc)janus_streaming_send_rtp_src_received,
+				(gpointer)&mountpoint->rtp_cbk_data[stream],
+				mountpoint->relay_thread ? mountpoint->relay_thread->context : NULL);
+		}
+
+		for (guint i = 0; i < mountpoint->ladder_size; i++)
+		{
+			socket_utils_attach_callback_to_context(&mountpoint->renditions[i].socket,
+				(GSourceFunc)janus_streaming_rendition_rtp_received,
+				(gpointer)&mountpoint->renditions[i].cbk_data,
+				mountpoint->relay_thread ? mountpoint->relay_thread->context : NULL);
+		}
+
+		/* The relay path only sends a coalesced PLI when a packet comes in */
+		if (!mountpoint->ladder_size && pli_window > 0 && !mountpoint->keyframe_requests_source) {
+			GSource *flush_source = g_timeout_source_new(MAX(pli_window / 4, 10));
+			g_source_set_callback(flush_source, janus_streaming_flush_keyframe_requests, mountpoint, NULL);
+			g_source_attach(flush_source, mountpoint->relay_thread ? mountpoint->relay_thread->context : NULL);
+			mountpoint->keyframe_requests_source = flush_source;
+		}
+
+		janus_streaming_pipeline_build(p, FALSE);
+		if (p->standby_uri) {
+			if (!janus_streaming_pipeline_build(p, TRUE))
+				janus_streaming_schedule_standby_restart(p);
+			p->gap_source = g_timeout_source_new(MAX(failover_gap / 4, 10));
+			g_source_set_callback(p->gap_source, janus_streaming_watch_gap, p, NULL);
+			g_source_attach(p->gap_source, p->thread->context);
 		}
-		while (GST_STATE_PLAYING != state);
-		if (GST_STATE_CHANGE_FAILURE == ret) {
+	}
+	while(0);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Creates the GStreamer pipeline of a mountpoint whose sockets are ready, and sets it to
+ * PLAYING; on the pipeline thread, again each time its source is reconnected. The standby
+ * is built from the backup uri and drops what it receives until it is promoted */
+static gboolean janus_streaming_pipeline_build(janus_streaming_pipeline *p, gboolean standby) {
+
+	janus_streaming_mountpoint *mountpoint = p->mountpoint;
+	pipeline_data_t data = p->data;
+	GstElement *pipeline = NULL, *sender_bin, *source = NULL;
+	GstBus *bus = NULL;
+	GSource *bus_source = NULL;
+	pipeline_callback_t *callback_data = g_malloc0(sizeof(pipeline_callback_t));
+
+	if (standby)
+		data.uri = p->standby_uri;
+
+	do
+	{
+		/* create a new pipeline to hold the elements */
+		pipeline = gst_pipeline_new ("pipeline");
+		g_assert (pipeline);
+
+		sender_bin = sender_bin_create();
+		g_assert (sender_bin);
+    	gst_bin_add_many (GST_BIN (pipeline), sender_bin, NULL);
+
+		callback_data->mountpoint = mountpoint;
+		callback_data->pipeline = pipeline;
+		callback_data->uri = data.uri;
+		callback_data->handle = data.handle;
+		callback_data->restarted = standby || p->restarts > 0;
+		callback_data->standby = standby;
+
+		if (g_str_has_prefix (data.uri, "rtsp://")) {
+			source = create_rtsp_source_element(callback_data, &data);
+			gst_bin_add_many (GST_BIN (pipeline), source, NULL);
+		} else if (g_str_has_prefix (data.uri, "videotestsrc://") && !standby) { 
+			source = create_videotestsrc_bin(pipeline, &data);
+			janus_mutex_lock(&mountpoint->mutex);
+			if (mountpoint->encoder)
+				gst_object_unref(mountpoint->encoder);
+			mountpoint->encoder = gst_bin_get_by_name(GST_BIN(source), "encoder");
+			if (mountpoint->encoder && !mountpoint->ladder_size)
+				set_encoder_temporal_layers(mountpoint->encoder, temporal_layers);
+			janus_mutex_unlock(&mountpoint->mutex);
+			if (mountpoint->ladder_size) {
+				GstElement * ladder_bin = create_ladder_bin(mountpoint);
+				gst_bin_add_many (GST_BIN (pipeline), source, ladder_bin, NULL);
+				gst_element_link (source, ladder_bin);
+			} else {
+				GstElement * output_bin = create_rtp_output(mountpoint, JANUS_STREAMING_STREAM_VIDEO, "video");
+				gst_bin_add_many (GST_BIN (pipeline), source, output_bin, NULL);
+				gst_element_link_many (source, sender_bin, output_bin, NULL);
+			}
+		} else {
+			JANUS_LOG(LOG_ERR, "Unsupported source protocol!\n");
 			break;
 		}
-#endif
+
 		if (NULL == (bus = gst_element_get_bus (pipeline))) {
 			JANUS_LOG(LOG_ERR, "Could not get the bus.\n");
 			break;
@@ -519,136 +870,532 @@ static gpointer transcode_handler(gpointer data) {
 			JANUS_LOG(LOG_ERR, "Could not create a watch.\n");
 			break;
 		}
-
-
-		if (NULL == (context = g_main_context_new())) {
-			JANUS_LOG(LOG_ERR, "Could not create new context.\n");
-			break;
-		}
-		g_main_context_push_thread_default(context);
 		g_source_set_callback(bus_source, (GSourceFunc) gst_bus_async_signal_func, NULL, NULL);
-		g_source_attach(bus_source, context);
-		g_source_unref(bus_source);
-		bus_source = NULL;
-		janus_mutex_lock(&transcode_main_loops_mutex);
-		main_loop = g_main_loop_new(context, FALSE);
-		g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback)on_eos, &callback_data);
-		g_signal_connect (G_OBJECT (bus), "message::error", (GCallback)on_error, &callback_data);
+		g_source_attach(bus_source, p->thread->context);
+		g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback)on_eos, callback_data);
+		g_signal_connect (G_OBJECT (bus), "message::error", (GCallback)on_error, callback_data);
 		gst_object_unref(bus);
 		bus = NULL;
-		g_hash_table_insert(transcode_main_loops, pipeline_data->id, main_loop);
-		janus_mutex_unlock(&transcode_main_loops_mutex);		
-		g_free(pipeline_data);
-		pipeline_data = NULL;
-
-#if 0
-		sleep(10);
-		JANUS_LOG(LOG_INFO, "Streaming: dumping dot file\n");
-    	GST_DEBUG_BIN_TO_DOT_FILE(GST_BIN(pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "pipeline_delayed");
-#endif
 
-		g_main_loop_run(main_loop);
-		if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(pipeline, GST_STATE_NULL)) {
-			JANUS_LOG(LOG_ERR, "Could not change state of pipeline to NULL state.\n");
-		}
-		else { 
-			do
-			{
-				if (GST_STATE_CHANGE_FAILURE == (ret = gst_element_get_state(pipeline,
-					&state, NULL, GST_CLOCK_TIME_NONE))) {
-					JANUS_LOG(LOG_ERR, "Could not change state of pipeline to NULL state.\n");
-					break;
-				}
-			}
-			while (GST_STATE_NULL != state);
+		if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(pipeline, GST_STATE_PLAYING)) {
+			JANUS_LOG(LOG_ERR, "Could not change state of pipeline to PLAYING state.\n");
+			break;
 		}
 
-		gst_object_unref(GST_OBJECT(pipeline));
+		/* Owned by the scheduler entry from now on, released by teardown_pipeline */
+		if (standby) {
+			p->standby = pipeline;
+			p->standby_bus_source = bus_source;
+			p->standby_callback_data = callback_data;
+		} else {
+			p->pipeline = pipeline;
+			p->bus_source = bus_source;
+			p->callback_data = callback_data;
+		}
 		pipeline = NULL;
-		g_main_context_pop_thread_default(context);
-		g_main_context_unref(context);
-		context = NULL;
+		bus_source = NULL;
+		callback_data = NULL;
 	}
 	while(0);
 
 	// cleanup
-	if (bus_source) {
-		g_source_unref(bus_source);
-		bus_source = NULL;
-	}
 	if (bus) {
 		gst_object_unref(bus);
 		bus = NULL;
 	}
-
-	if (context) {
-		g_main_context_unref(context);
-		context = NULL;
+	if (bus_source) {
+		g_source_destroy(bus_source);
+		g_source_unref(bus_source);
+		bus_source = NULL;
 	}
-
 	if (pipeline) {
+		gst_element_set_state(pipeline, GST_STATE_NULL);
 		gst_object_unref(pipeline);
 		pipeline = NULL;
 	}
-	if (pipeline_data) {
-		if (pipeline_data->uri) {
-			g_free(pipeline_data->uri);
-			pipeline_data->uri = NULL;
-		}
-		g_free(pipeline_data);
-		pipeline_data = NULL;
+	g_free(callback_data);
+
+	return (standby ? p->standby : p->pipeline) != NULL;
+}
+
+/* Hands a build of p, its pipeline or its standby, to the reaper; p stays for the next one */
+static void janus_streaming_pipeline_retire(janus_streaming_pipeline *p, gboolean standby) {
+
+	janus_streaming_pipeline *old = g_malloc0(sizeof(janus_streaming_pipeline));
+	old->id = g_strdup(p->id);
+	old->thread = p->thread;
+	context_pool_thread_assign(old->thread);
+	if (standby) {
+		old->pipeline = p->standby;
+		old->bus_source = p->standby_bus_source;
+		old->callback_data = p->standby_callback_data;
+		p->standby = NULL;
+		p->standby_bus_source = NULL;
+		p->standby_callback_data = NULL;
+	} else {
+		old->pipeline = p->pipeline;
+		old->bus_source = p->bus_source;
+		old->callback_data = p->callback_data;
+		p->pipeline = NULL;
+		p->bus_source = NULL;
+		p->callback_data = NULL;
 	}
+	janus_streaming_reap_pipeline(old, NULL);
+}
 
-	JANUS_LOG(LOG_INFO, "Exit transcode_handler\n");
+/* Backoff before the next attempt to reconnect a source: doubles from reconnect_min_delay
+ * up to reconnect_max_delay, then drawn from its upper half so that mountpoints that lost
+ * the same server do not all come back at once */
+static guint janus_streaming_reconnect_delay(guint attempt) {
 
-	return NULL;
+	guint64 delay = reconnect_min_delay;
+	for (guint i = 0; i < attempt && delay < reconnect_max_delay; i++)
+		delay *= 2;
+	delay = MAX(MIN(delay, reconnect_max_delay), 2);
+
+	return (guint)(delay / 2 + g_random_int_range(0, (gint32)(delay / 2) + 1));
 }
 
-static void setup_pipeline(janus_plugin_session * handle,const gchar* source, const gchar *id) {
+/* Builds the pipeline of a lost source again once its backoff expired; on its pipeline thread */
+static gboolean janus_streaming_pipeline_restart(gpointer data) {
 
-	do {	
-		if(source){
-			// allocation - deallocated within the thread
-			pipeline_data_t *pipeline_data = g_malloc0(sizeof(pipeline_data_t));
-			if (!pipeline_data) {
-				JANUS_LOG(LOG_ERR, "Could not allocate pipeline data.\n");
-				break;
-			}
-			// allocation - deallocated when removing form the transcode_main_loops hash table
-			pipeline_data->id = g_strdup(id);
-			// allocation - deallocated within the thread
+	janus_streaming_pipeline *p = (janus_streaming_pipeline *)data;
+	janus_streaming_mountpoint *mountpoint = p->mountpoint;
 
-			pipeline_data->uri = g_strdup(source);
-			pipeline_data->latency = latency;
-			pipeline_data->handle = handle;
-			
-			GError *error = NULL;
-			// allocation
-			GThread *thread_handler = g_thread_try_new("transcode handler", transcode_handler, pipeline_data, &error);
-			if (!thread_handler) {
-				if (error) {
-					JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the transcode handler thread...\n", error->code,
-							error->message ? error->message : "??");
-				} else {
-					JANUS_LOG(LOG_ERR, "Failed to start transcode handler...\n");
+	g_source_unref(p->restart_source);
+	p->restart_source = NULL;
+	p->restarts++;
+	/* Packets of the new source get new numbers from the rewriters */
+	g_atomic_int_inc(&mountpoint->source_generation);
+	JANUS_LOG(LOG_INFO, "Reconnecting the source of %s (attempt %d)\n", p->id, g_atomic_int_get(&mountpoint->reconnect_attempt));
+	if (!janus_streaming_pipeline_build(p, FALSE))
+		janus_streaming_schedule_restart(p);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void janus_streaming_schedule_restart(janus_streaming_pipeline *p) {
+
+	guint attempt = (guint)g_atomic_int_add(&p->mountpoint->reconnect_attempt, 1);
+	guint delay = janus_streaming_reconnect_delay(attempt);
+
+	JANUS_LOG(LOG_WARN, "Source of %s lost, reconnecting in %u ms\n", p->id, delay);
+	p->restart_source = g_timeout_source_new(delay);
+	g_source_set_callback(p->restart_source, janus_streaming_pipeline_restart, p, NULL);
+	g_source_attach(p->restart_source, p->thread->context);
+}
+
+/* Builds the standby of a source again once its backoff expired; on its pipeline thread */
+static gboolean janus_streaming_standby_restart(gpointer data) {
+
+	janus_streaming_pipeline *p = (janus_streaming_pipeline *)data;
+
+	g_source_unref(p->standby_restart_source);
+	p->standby_restart_source = NULL;
+	if (!janus_streaming_pipeline_build(p, TRUE))
+		janus_streaming_schedule_standby_restart(p);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void janus_streaming_schedule_standby_restart(janus_streaming_pipeline *p) {
+
+	guint delay = janus_streaming_reconnect_delay(p->standby_attempts++);
+
+	JANUS_LOG(LOG_WARN, "Standby of %s down, building it again in %u ms\n", p->id, delay);
+	p->standby_restart_source = g_timeout_source_new(delay);
+	g_source_set_callback(p->standby_restart_source, janus_streaming_standby_restart, p, NULL);
+	g_source_attach(p->standby_restart_source, p->thread->context);
+}
+
+/* A standby is ready to take over as long as its source keeps sending */
+static gboolean janus_streaming_standby_ready(janus_streaming_pipeline *p, gint64 now) {
+
+	return p->standby && now - p->mountpoint->standby_last_packet <= (gint64)failover_gap * 1000;
+}
+
+/* Promotes the standby to feed the viewers, the primary being lost or quiet since the given
+ * time; the failed uri becomes the standby, built again after a backoff. On the pipeline thread */
+static void janus_streaming_failover(janus_streaming_pipeline *p, gint64 quiet_since) {
+
+	janus_streaming_mountpoint *mountpoint = p->mountpoint;
+
+	JANUS_LOG(LOG_WARN, "Source of %s failing over to %s\n", p->id, p->standby_uri);
+	if (p->restart_source) {
+		g_source_destroy(p->restart_source);
+		g_source_unref(p->restart_source);
+		p->restart_source = NULL;
+	}
+	if (p->pipeline)
+		janus_streaming_pipeline_retire(p, FALSE);
+
+	mountpoint->lost_generation = g_atomic_int_get(&mountpoint->source_generation);
+	mountpoint->source_lost = quiet_since;
+	mountpoint->failing_over = TRUE;
+	/* Before the standby's packets flow, so that the rewriters pick them up as a new source */
+	g_atomic_int_inc(&mountpoint->source_generation);
+	if (mountpoint->gop)
+		gop_cache_clear(mountpoint->gop);
+
+	p->pipeline = p->standby;
+	p->bus_source = p->standby_bus_source;
+	p->callback_data = p->standby_callback_data;
+	p->standby = NULL;
+	p->standby_bus_source = NULL;
+	p->standby_callback_data = NULL;
+	gchar *uri = p->data.uri;
+	p->data.uri = p->standby_uri;
+	p->standby_uri = uri;
+	promote_standby_pipeline(p->callback_data);
+
+	p->standby_attempts = 0;
+	janus_streaming_schedule_standby_restart(p);
+}
+
+/* Fails over once the primary sent nothing for failover_gap, or is being reconnected, while
+ * the standby receives; on the pipeline thread */
+static gboolean janus_streaming_watch_gap(gpointer data) {
+
+	janus_streaming_pipeline *p = (janus_streaming_pipeline *)data;
+	janus_streaming_mountpoint *mountpoint = p->mountpoint;
+	gint64 now = janus_get_monotonic_time();
+
+	if (!janus_streaming_standby_ready(p, now))
+		return G_SOURCE_CONTINUE;
+	p->standby_attempts = 0;
+
+	gint64 last = mountpoint->source_last_packet;
+	if (p->pipeline && last && now - last > (gint64)failover_gap * 1000)
+		janus_streaming_failover(p, last);
+	else if (!p->pipeline && p->restart_source)
+		janus_streaming_failover(p, mountpoint->source_lost ? mountpoint->source_lost : now);
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Called from the bus of a pipeline on EOS or error: a source with a ready standby fails
+ * over to it, otherwise the mountpoint is destroyed, unless sources are reconnected, in which
+ * case the running pipeline is handed to the reaper and a new one is built after a backoff,
+ * on the same sockets so that viewers stay attached */
+void janus_streaming_source_lost(janus_streaming_mountpoint * mountpoint, GstElement * pipeline, gpointer handle) {
+
+	janus_streaming_pipeline *p = NULL;
+	if (!g_atomic_int_get(&stopping)) {
+		/* Runs on the pipeline thread, where p would be detached before being freed */
+		janus_mutex_lock(&pipelines_mutex);
+		p = g_hash_table_lookup(pipelines, mountpoint->id);
+		janus_mutex_unlock(&pipelines_mutex);
+		if (p && p->mountpoint != mountpoint)
+			p = NULL;
+	}
+	if (p && pipeline && pipeline == p->standby) {
+		/* The primary carries on */
+		janus_streaming_pipeline_retire(p, TRUE);
+		janus_streaming_schedule_standby_restart(p);
+		return;
+	}
+	if (p && p->pipeline == pipeline && janus_streaming_standby_ready(p, janus_get_monotonic_time())) {
+		janus_streaming_failover(p, mountpoint->source_last_packet ? mountpoint->source_last_packet : janus_get_monotonic_time());
+		return;
+	}
+	if (g_atomic_int_get(&stopping)) {
+		janus_streaming_send_destroy_request(mountpoint->id, handle);
+		return;
+	}
+	if (!p || p->pipeline != pipeline) {
+		/* Being torn down, or a build lost already (an error followed by EOS), or a primary
+		 * retired by a failover whose bus watch is not detached yet */
+		return;
+	}
+	if (!source_reconnect) {
+		janus_streaming_send_destroy_request(mountpoint->id, handle);
+		return;
+	}
+
+	janus_streaming_pipeline_retire(p, FALSE);
+
+	if (!mountpoint->source_lost) {
+		mountpoint->lost_generation = g_atomic_int_get(&mountpoint->source_generation);
+		mountpoint->source_lost = janus_get_monotonic_time();
+	}
+	if (mountpoint->gop)
+		gop_cache_clear(mountpoint->gop);
+	janus_streaming_schedule_restart(p);
+}
+
+/* Removes the bus watch of a pipeline; runs on its pipeline thread, so that no bus
+ * message is being dispatched once it returns */
+static gboolean janus_streaming_pipeline_detach(gpointer data) {
+
+	janus_streaming_pipeline *p = (janus_streaming_pipeline *)data;
+
+	if (p->bus_source) {
+		g_source_destroy(p->bus_source);
+		g_source_unref(p->bus_source);
+		p->bus_source = NULL;
+	}
+	if (p->restart_source) {
+		g_source_destroy(p->restart_source);
+		g_source_unref(p->restart_source);
+		p->restart_source = NULL;
+	}
+	if (p->standby_restart_source) {
+		g_source_destroy(p->standby_restart_source);
+		g_source_unref(p->standby_restart_source);
+		p->standby_restart_source = NULL;
+	}
+	if (p->gap_source) {
+		g_source_destroy(p->gap_source);
+		g_source_unref(p->gap_source);
+		p->gap_source = NULL;
+	}
+	/* Stopped on its own */
+	if (p->standby)
+		janus_streaming_pipeline_retire(p, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void janus_streaming_pipeline_call_unref(janus_streaming_pipeline_call *call) {
+
+	if (!g_atomic_int_dec_and_test(&call->ref))
+		return;
+	janus_condition_destroy(&call->cond);
+	janus_mutex_destroy(&call->mutex);
+	g_free(call);
+}
+
+static gboolean janus_streaming_pipeline_call_run(gpointer data) {
+
+	janus_streaming_pipeline_call *call = (janus_streaming_pipeline_call *)data;
+
+	call->func(call->data);
+	janus_mutex_lock(&call->mutex);
+	call->done = TRUE;
+	janus_condition_signal(&call->cond);
+	janus_mutex_unlock(&call->mutex);
+	janus_streaming_pipeline_call_unref(call);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Queues func on a pipeline or relay thread, or runs it directly when already there */
+static janus_streaming_pipeline_call *janus_streaming_pipeline_call_async(context_pool_thread *thread, GSourceFunc func, gpointer data) {
+
+	janus_streaming_pipeline_call *call = g_malloc0(sizeof(janus_streaming_pipeline_call));
+
+	call->ref = 2;
+	call->func = func;
+	call->data = data;
+	janus_mutex_init(&call->mutex);
+	janus_condition_init(&call->cond);
+	g_main_context_invoke(thread->context, janus_streaming_pipeline_call_run, call);
+	return call;
+}
+
+/* Waits for a queued call until the monotonic time until; FALSE if it has not run by then */
+static gboolean janus_streaming_pipeline_call_wait(janus_streaming_pipeline_call *call, gint64 until) {
+
+	/* The condition waits on the realtime clock */
+	gint64 abs = g_get_real_time() + MAX(until - janus_get_monotonic_time(), 0);
+	struct timespec ts = { .tv_sec = abs / G_USEC_PER_SEC, .tv_nsec = (abs % G_USEC_PER_SEC) * 1000 };
+	int res = 0;
+
+	janus_mutex_lock(&call->mutex);
+	while (!call->done && res != ETIMEDOUT) {
+		res = janus_condition_timedwait(&call->cond, &call->mutex, &ts);
+	}
+	gboolean done = call->done;
+	janus_mutex_unlock(&call->mutex);
+	return done;
+}
+
+/* Queues a pipeline taken out of the scheduler to be stopped, with a deadline */
+static void janus_streaming_reap_pipeline(janus_streaming_pipeline *p, janus_streaming_mountpoint *mountpoint) {
+
+	janus_streaming_reap *job = g_malloc0(sizeof(janus_streaming_reap));
+	job->pipeline = p;
+	job->mountpoint = mountpoint;
+	job->queued = janus_get_monotonic_time();
+	job->deadline = job->queued + (gint64)teardown_timeout * 1000;
+
+	janus_mutex_lock(&reaper_mutex);
+	reaping = g_list_prepend(reaping, job);
+	if (mountpoint)
+		mountpoint->reaping++;
+	janus_mutex_unlock(&reaper_mutex);
+
+	if (!reaper || !g_thread_pool_push(reaper, job, NULL)) {
+		/* No reaper, stopped from here until the deadline, then retried from the watchdog */
+		janus_streaming_reap_run(job, NULL);
+	}
+}
+
+/* Stops a pipeline and frees it, then releases its mountpoint; runs on a reaper thread.
+ * Waits until the deadline at most, or for a retry once past it, then parks the job for
+ * the watchdog to queue again, so that a hung pipeline does not keep a reaper thread */
+static void janus_streaming_reap_run(gpointer data, gpointer user_data) {
+
+	janus_streaming_reap *job = (janus_streaming_reap *)data;
+	janus_streaming_pipeline *p = job->pipeline;
+	janus_streaming_mountpoint *mountpoint = job->mountpoint;
+	gint64 now = janus_get_monotonic_time();
+	gint64 until = job->deadline > now ? job->deadline : now + JANUS_STREAMING_REAP_RETRY_MS * 1000;
+	GstState state = GST_STATE_VOID_PENDING;
+
+	if (p) {
+		/* Also waits for the start if it is still queued on its thread */
+		if (!job->detach && !job->stopping)
+			job->detach = janus_streaming_pipeline_call_async(p->thread, janus_streaming_pipeline_detach, p);
+		if (job->detach) {
+			if (!janus_streaming_pipeline_call_wait(job->detach, until)) {
+				janus_streaming_reap_park(job);
+				return;
+			}
+			janus_streaming_pipeline_call_unref(job->detach);
+			job->detach = NULL;
+		}
+		if (p->pipeline) {
+			gboolean stopping = TRUE;
+			if (!job->stopping) {
+				job->stopping = TRUE;
+				if (GST_STATE_CHANGE_FAILURE == gst_element_set_state(p->pipeline, GST_STATE_NULL)) {
+					JANUS_LOG(LOG_ERR, "Could not change state of pipeline to NULL state.\n");
+					stopping = FALSE;
+				}
+			}
+			while (stopping && GST_STATE_NULL != state) {
+				gint64 left = until - janus_get_monotonic_time();
+				if (left <= 0) {
+					janus_streaming_reap_park(job);
+					return;
+				}
+				if (GST_STATE_CHANGE_FAILURE == gst_element_get_state(p->pipeline,
+					&state, NULL, (GstClockTime)left * GST_USECOND)) {
+					JANUS_LOG(LOG_ERR, "Could not change state of pipeline to NULL state.\n");
+					break;
 				}
-				g_free(pipeline_data->id);
-				pipeline_data->id = NULL;
-				g_free(pipeline_data->uri);
-				pipeline_data->uri = NULL;
-				g_free(pipeline_data);
-				pipeline_data = NULL;
-				break;
 			}
-			janus_mutex_lock(&transcode_threads_mutex);
-			g_hash_table_insert(transcode_threads, (gchar *)id, thread_handler);
-			janus_mutex_unlock(&transcode_threads_mutex);
+			gst_object_unref(GST_OBJECT(p->pipeline));
+			p->pipeline = NULL;
+		}
+		context_pool_thread_release(p->thread);
+		g_free(p->callback_data);
+		g_free(p->id);
+		g_free(p->data.uri);
+		g_free(p->standby_uri);
+		g_free(p);
+	}
+	/* Also ends the quarantine of the ports of an abandoned one, nothing holds them anymore */
+	if (mountpoint)
+		janus_streaming_release_pipeline(mountpoint);
+
+	gint64 elapsed = (janus_get_monotonic_time() - job->queued) / 1000;
+	janus_mutex_lock(&reaper_mutex);
+	reaping = g_list_remove(reaping, job);
+	if (job->abandoned) {
+		teardowns_late++;
+	} else {
+		guint bucket = elapsed > 0 ? MIN(g_bit_storage((gulong)elapsed), JANUS_STREAMING_TEARDOWN_BUCKETS - 1) : 0;
+		teardown_latency[bucket]++;
+		teardowns_completed++;
+	}
+	gboolean free_mountpoint = mountpoint && !--mountpoint->reaping && mountpoint->free_pending;
+	janus_mutex_unlock(&reaper_mutex);
+
+	if (job->abandoned)
+		JANUS_LOG(LOG_WARN, "Abandoned pipeline of %s finally stopped after %"SCNi64" ms\n", mountpoint ? mountpoint->id : "?", elapsed);
+	if (free_mountpoint)
+		janus_streaming_mountpoint_free(mountpoint);
+	g_free(job);
+}
+
+/* Gives the reaper thread back until the watchdog queues the job again; past the deadline,
+ * what relayed the mountpoint is released first, nothing is relayed from an abandoned pipeline */
+static void janus_streaming_reap_park(janus_streaming_reap *job) {
+
+	if (job->mountpoint && !job->relay_released && janus_get_monotonic_time() >= job->deadline) {
+		janus_streaming_release_relay(job->mountpoint);
+		job->relay_released = TRUE;
+		JANUS_LOG(LOG_WARN, "Released the relay of %s, its sockets, ports and rings stay reserved until its pipeline stops\n",
+			job->mountpoint->id);
+	}
+
+	janus_mutex_lock(&reaper_mutex);
+	job->parked = TRUE;
+	janus_mutex_unlock(&reaper_mutex);
+}
 
+/* Called by the watchdog: the teardowns past their deadline give up on their pipeline,
+ * which is left to stop whenever it can. Their mountpoint keeps its sockets and ports
+ * until then, as a port handed out again would still be written by the hung source;
+ * its relay side was released when the job parked at the deadline.
+ * Parked jobs are queued again for another try */
+static void janus_streaming_abandon_teardowns(gint64 now) {
+
+	GList *retry = NULL;
+
+	janus_mutex_lock(&reaper_mutex);
+	for (GList *l = reaping; l; l = l->next) {
+		janus_streaming_reap *job = (janus_streaming_reap *)l->data;
+		if (!job->abandoned && now >= job->deadline) {
+			job->abandoned = TRUE;
+			teardowns_abandoned++;
+			JANUS_LOG(LOG_ERR, "Pipeline of %s not stopped after %u ms, abandoning it, its ports stay reserved until it stops\n",
+				job->mountpoint ? job->mountpoint->id : "?", teardown_timeout);
+		}
+		if (job->parked) {
+			job->parked = FALSE;
+			retry = g_list_prepend(retry, job);
 		}
+	}
+	janus_mutex_unlock(&reaper_mutex);
 
+	for (GList *l = retry; l; l = l->next) {
+		if (!reaper || !g_thread_pool_push(reaper, l->data, NULL))
+			janus_streaming_reap_run(l->data, NULL);
 	}
-	while(0);
+	g_list_free(retry);
+}
+
+/* Assigns the pipeline of a mountpoint to the least loaded pipeline thread, where it is built;
+ * called with mountpoints_mutex held */
+static void setup_pipeline(janus_plugin_session * handle,const gchar* source, const gchar *backup, const gchar *id) {
+
+	if (!source || !pipeline_pool) {
+		return;
+	}
+
+	janus_streaming_pipeline *p = g_malloc0(sizeof(janus_streaming_pipeline));
+	p->id = g_strdup(id);
+	p->data.id = p->id;
+	p->data.uri = g_strdup(source);
+	if (backup && !g_str_has_prefix(backup, "rtsp://"))
+		JANUS_LOG(LOG_WARN, "Backup of %s is not an rtsp:// uri, ignoring it\n", id);
+	else
+		p->standby_uri = g_strdup(backup);
+	p->data.latency = latency;
+	p->data.handle = handle;
+	p->mountpoint = g_hash_table_lookup(mountpoints, id);
+	/* Before the first packet: the rewrite has to start with the primary to hide a failover */
+	if (p->mountpoint)
+		p->mountpoint->has_backup = p->standby_uri != NULL;
+	p->thread = context_pool_get_least_loaded(pipeline_pool);
+	context_pool_thread_assign(p->thread);
+
+	janus_mutex_lock(&pipelines_mutex);
+	janus_streaming_pipeline *previous = g_hash_table_lookup(pipelines, p->id);
+	if (previous) {
+		/* Not expected: the mountpoint was set up twice */
+		JANUS_LOG(LOG_WARN, "Mountpoint %s already has a pipeline, replacing it\n", p->id);
+		g_hash_table_steal(pipelines, p->id);
+	}
+	g_hash_table_insert(pipelines, p->id, p);
+	janus_mutex_unlock(&pipelines_mutex);
+	if (previous)
+		janus_streaming_reap_pipeline(previous, NULL);
 
+	g_main_context_invoke(p->thread->context, janus_streaming_pipeline_start, p);
 }
 
 /* Streaming watchdog/garbage collector (sort of) */
@@ -676,6 +1423,7 @@ void *janus_streaming_watchdog(void *data) {
 					old_sessions = g_list_delete_link(old_sessions, sl);
 					sl = rm;
 					session->handle = NULL;
+					pacer_queue_unref(session->pacing);
 					g_free(session);
 					session = NULL;
 					continue;
@@ -707,7 +1455,38 @@ void *janus_streaming_watchdog(void *data) {
 				sl = sl->next;
 			}
 		}
+		/* Unwatched mountpoints nobody came back to */
+		GList *expired = NULL;
+		if(mountpoint_linger > 0) {
+			GHashTableIter iter;
+			gpointer value;
+			g_hash_table_iter_init(&iter, mountpoints);
+			while(g_hash_table_iter_next(&iter, NULL, &value)) {
+				janus_streaming_mountpoint *mountpoint = (janus_streaming_mountpoint *)value;
+				if(!mountpoint->linger_until || mountpoint->destroyed || now < mountpoint->linger_until)
+					continue;
+				mountpoint->linger_until = 0;
+				/* Viewers are only added under mountpoints_mutex too, nobody can join until destroyed is set */
+				janus_mutex_lock(&mountpoint->mutex);
+				gboolean watched = mountpoint->listeners != NULL;
+				janus_mutex_unlock(&mountpoint->mutex);
+				if(watched)
+					continue;
+				/* Refuse new viewers from now on, the pipeline is torn down below */
+				mountpoint->destroyed = now;
+				linger_misses++;
+				expired = g_list_append(expired, mountpoint);
+			}
+		}
 		janus_mutex_unlock(&mountpoints_mutex);
+		/* Not under mountpoints_mutex, the pipeline threads may be waiting for it */
+		for(GList *l = expired; l; l = l->next)
+			janus_streaming_expire_mountpoint((janus_streaming_mountpoint *)l->data);
+		g_list_free(expired);
+		janus_streaming_abandon_teardowns(now);
+		trace_counter_report(&invalid_relay_packets, now);
+		trace_counter_report(&invalid_relay_sessions, now);
+		trace_counter_report(&not_started_packets, now);
 		g_usleep(500000);
 	}
 	JANUS_LOG(LOG_INFO, "Streaming watchdog stopped\n");
@@ -764,13 +1543,13 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 		janus_config_print(config);
 	janus_mutex_init(&config_mutex);
 	
-	mountpoints = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, janus_streaming_mountpoint_free);
-	transcode_threads = g_hash_table_new(g_str_hash, g_str_equal);
-	transcode_main_loops = g_hash_table_new_full(g_str_hash, g_str_equal, g_str_destroy, NULL);
+	mountpoints = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, janus_streaming_mountpoint_unref);
+	shared_sources = g_hash_table_new(g_str_hash, g_str_equal);
+	pipelines = g_hash_table_new(g_str_hash, g_str_equal);
 	
 	janus_mutex_init(&mountpoints_mutex);
-	janus_mutex_init(&transcode_threads_mutex);
-	janus_mutex_init(&transcode_main_loops_mutex);
+	janus_mutex_init(&pipelines_mutex);
+	janus_mutex_init(&reaper_mutex);
 	
 
 	/* Parse configuration to populate the mountpoints */
@@ -803,14 +1582,218 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 		else {
 			latency = 200;
 		} 
-	
-	}		
-
-	socket_utils_init(udp_min_port, udp_max_port);
-
-	sessions = g_hash_table_new(NULL, NULL);
-	janus_mutex_init(&sessions_mutex);
-	messages = g_async_queue_new_full((GDestroyNotify) janus_streaming_message_free);
+		item = janus_config_get_item_drilldown(config, "general", "ingest");
+		if (item && item->value) {
+			default_ingest = janus_streaming_parse_ingest(item->value);
+			if (default_ingest < 0) {
+				JANUS_LOG(LOG_WARN, "Unknown ingest mode '%s', using udp\n", item->value);
+				default_ingest = JANUS_STREAMING_INGEST_UDP;
+			}
+		}
+		item = janus_config_get_item_drilldown(config, "general", "rtp_batch_size");
+		if (item && item->value) {
+			int size = atoi(item->value);
+			rtp_batch_size = size > 1 ? (guint)size : 1;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "fanout_threads");
+		if (item && item->value) {
+			int threads = atoi(item->value);
+			fanout_threads = threads > 0 ? (guint)threads : 0;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "fanout_threshold");
+		if (item && item->value) {
+			int threshold = atoi(item->value);
+			fanout_threshold = threshold > 0 ? (guint)threshold : 1;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "packet_pool_size");
+		if (item && item->value) {
+			int size = atoi(item->value);
+			packet_pool_size = size > 0 ? (guint)size : 0;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "rcvbuf");
+		if (item && item->value) {
+			socket_rcvbuf = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "sndbuf");
+		if (item && item->value) {
+			socket_sndbuf = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "rcvbuf_max");
+		if (item && item->value) {
+			socket_rcvbuf_max = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "shm_ring_slots");
+		if (item && item->value) {
+			int slots = atoi(item->value);
+			shm_ring_slots = slots > 1 ? (guint)slots : 2;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "shm_ring_overrun");
+		if (item && item->value) {
+			shm_ring_overrun_policy = shm_ring_parse_overrun(item->value);
+			if (shm_ring_overrun_policy < 0) {
+				JANUS_LOG(LOG_WARN, "Unknown shared ring overrun policy '%s', using drop-oldest\n", item->value);
+				shm_ring_overrun_policy = SHM_RING_DROP_OLDEST;
+			}
+		}
+		item = janus_config_get_item_drilldown(config, "general", "io_backend");
+		if (item && item->value) {
+			io_backend = socket_utils_parse_backend(item->value);
+			if (io_backend < 0) {
+				JANUS_LOG(LOG_WARN, "Unknown I/O backend '%s', using glib\n", item->value);
+				io_backend = SOCKET_UTILS_BACKEND_GLIB;
+			}
+		}
+		item = janus_config_get_item_drilldown(config, "general", "relay_threads");
+		if (item && item->value) {
+			int threads = atoi(item->value);
+			relay_threads = threads > 0 ? (guint)threads : 0;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "teardown_timeout");
+		if (item && item->value) {
+			teardown_timeout = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "source_reconnect");
+		if (item && item->value) {
+			source_reconnect = janus_is_true(item->value);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "reconnect_min_delay");
+		if (item && item->value) {
+			reconnect_min_delay = MAX(atoi(item->value), 1);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "reconnect_max_delay");
+		if (item && item->value) {
+			reconnect_max_delay = MAX(atoi(item->value), 1);
+		}
+		reconnect_max_delay = MAX(reconnect_max_delay, reconnect_min_delay);
+		item = janus_config_get_item_drilldown(config, "general", "failover_gap");
+		if (item && item->value) {
+			failover_gap = MAX(atoi(item->value), 1);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "pipeline_threads");
+		if (item && item->value) {
+			int threads = atoi(item->value);
+			pipeline_threads = threads > 0 ? (guint)threads : 0;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "videobufferkf");
+		if (item && item->value) {
+			video_buffer_kf = janus_is_true(item->value);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "gop_cache_max_packets");
+		if (item && item->value) {
+			int packets = atoi(item->value);
+			gop_cache_max_packets = packets > 0 ? (guint)packets : 1;
+		}
+		item = janus_config_get_item_drilldown(config, "general", "pli_window");
+		if (item && item->value) {
+			pli_window = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "pli_keyframe_timeout");
+		if (item && item->value) {
+			pli_keyframe_timeout = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "nack_history");
+		if (item && item->value) {
+			nack_history_depth = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "remb_aggregate");
+		if (item && item->value) {
+			remb_percentile = remb_aggregator_parse_percentile(item->value);
+			if (remb_percentile < 0) {
+				JANUS_LOG(LOG_WARN, "Unknown REMB aggregate '%s', using min\n", item->value);
+				remb_percentile = 0;
+			}
+		}
+		item = janus_config_get_item_drilldown(config, "general", "temporal_layers");
+		if (item && item->value) {
+			int layers = atoi(item->value);
+			temporal_layers = CLAMP(layers, 1, TEMPORAL_LAYERS_MAX);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "ladder_renditions");
+		if (item && item->value) {
+			ladder_specs = ladder_parse(item->value, &ladder_count);
+			if (!ladder_specs)
+				JANUS_LOG(LOG_WARN, "Invalid ladder_renditions '%s', using %s\n", item->value, LADDER_DEFAULT_RENDITIONS);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "remb_interval");
+		if (item && item->value) {
+			remb_interval = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "share_sources");
+		if (item && item->value) {
+			share_sources = janus_is_true(item->value);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "mountpoint_linger");
+		if (item && item->value) {
+			mountpoint_linger = MAX(atoi(item->value), 0);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "pacing_interval");
+		if (item && item->value) {
+			pacing_interval = MAX(atoi(item->value), 0);
+			if (pacing_interval > PACER_WHEEL_SLOTS - 1) {
+				/* No packet can be scheduled further out than the wheel */
+				JANUS_LOG(LOG_WARN, "pacing_interval %u ms is above the maximum, using %u ms\n", pacing_interval, PACER_WHEEL_SLOTS - 1);
+				pacing_interval = PACER_WHEEL_SLOTS - 1;
+			}
+		}
+		item = janus_config_get_item_drilldown(config, "general", "pacing_multiplier");
+		if (item && item->value) {
+			gdouble multiplier = g_ascii_strtod(item->value, NULL);
+			if (multiplier >= 1.0)
+				pacing_multiplier = multiplier;
+			else
+				JANUS_LOG(LOG_WARN, "Invalid pacing_multiplier '%s', using %.1f\n", item->value, pacing_multiplier);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "preload_concurrency");
+		if (item && item->value) {
+			preload_concurrency = MAX(atoi(item->value), 1);
+		}
+		item = janus_config_get_item_drilldown(config, "general", "preload_timeout");
+		if (item && item->value) {
+			preload_timeout = MAX(atoi(item->value), 0);
+		}
+		janus_streaming_parse_preloads(config);
+	
+	}		
+
+	if (!ladder_specs)
+		ladder_specs = ladder_parse(NULL, &ladder_count);
+
+	socket_utils_init(udp_min_port, udp_max_port);
+	socket_utils_set_buffer_sizes(socket_rcvbuf, socket_sndbuf, socket_rcvbuf_max);
+	socket_utils_set_backend(io_backend);
+	packet_pool_init(packet_pool_size);
+
+	if (relay_threads > 0) {
+		relay_pool = context_pool_new("relay", relay_threads);
+		if (!relay_pool) {
+			JANUS_LOG(LOG_WARN, "Could not start relay threads, relaying from the default context\n");
+		}
+	}
+	pipeline_pool = context_pool_new("pipeline", pipeline_threads ? pipeline_threads : g_get_num_processors());
+	if (!pipeline_pool) {
+		JANUS_LOG(LOG_FATAL, "Could not start the pipeline threads, no source can be started\n");
+	}
+	/* Bounded: a job gives its thread back at its deadline and is queued again by the watchdog */
+	reaper = g_thread_pool_new(janus_streaming_reap_run, NULL, JANUS_STREAMING_REAPER_THREADS, FALSE, NULL);
+	if (!reaper) {
+		JANUS_LOG(LOG_WARN, "Could not start the pipeline reaper, pipelines are stopped synchronously\n");
+	}
+	if (fanout_threads > 0) {
+		fanout = fanout_pool_new(fanout_threads, janus_streaming_fanout_task_run);
+		if (!fanout) {
+			JANUS_LOG(LOG_WARN, "Could not start fanout threads, relaying from the ingest thread only\n");
+		}
+	}
+	if (pacing_interval > 0) {
+		viewer_pacer = pacer_new(pacing_interval);
+		if (!viewer_pacer) {
+			JANUS_LOG(LOG_WARN, "Could not start the pacer, relaying without pacing\n");
+		}
+	}
+
+	sessions = g_hash_table_new(NULL, NULL);
+	janus_mutex_init(&sessions_mutex);
+	messages = g_async_queue_new_full((GDestroyNotify) janus_streaming_message_free);
 	/* This is the callback we'll need to invoke to contact the gateway */
 	gateway = callback;
 	g_atomic_int_set(&initialized, 1);
@@ -832,6 +1815,18 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 		janus_config_destroy(config);
 		return -1;
 	}
+	/* Start the configured sources, a few at a time so their RTSP setups don't all compete */
+	if (preloads) {
+		preload_pool = g_thread_pool_new(janus_streaming_preload_run, NULL, preload_concurrency, FALSE, &error);
+		if (!preload_pool) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the preload threads, sources start with their first viewer\n",
+				error->code, error->message ? error->message : "??");
+			g_clear_error(&error);
+		}
+		for (GList *l = preloads; l && preload_pool; l = l->next) {
+			g_thread_pool_push(preload_pool, l->data, NULL);
+		}
+	}
 	JANUS_LOG(LOG_INFO, "%s initialized!\n", JANUS_STREAMING_NAME);
 	return 0;
 }
@@ -843,6 +1838,12 @@ void janus_streaming_destroy(void) {
 
 	g_async_queue_push(messages, &exit_message);
 
+	if (preload_pool) {
+		/* Drops the sources not started yet, the running ones notice stopping */
+		g_thread_pool_free(preload_pool, TRUE, TRUE);
+		preload_pool = NULL;
+	}
+
 	//if(handler_thread != NULL) {
 	//	g_thread_join(handler_thread);
 	//	handler_thread = NULL;
@@ -861,24 +1862,47 @@ void janus_streaming_destroy(void) {
 		}
 	}
 	janus_mutex_unlock(&mountpoints_mutex);
-	janus_mutex_lock(&transcode_main_loops_mutex);
-	g_hash_table_iter_init(&iter, transcode_main_loops);
+	janus_mutex_lock(&pipelines_mutex);
+	g_hash_table_iter_init(&iter, pipelines);
 	while (g_hash_table_iter_next(&iter, NULL, &value)) {
-		g_main_loop_quit(value);
-	}
-	g_hash_table_remove_all(transcode_main_loops);
-	g_hash_table_destroy(transcode_main_loops);	
-	transcode_main_loops = NULL;
-	janus_mutex_unlock(&transcode_main_loops_mutex);
-	janus_mutex_lock(&transcode_threads_mutex);	
-	g_hash_table_iter_init(&iter, transcode_threads);	
-	while (g_hash_table_iter_next(&iter, NULL, &value)) {
-		g_thread_join(value);
+		janus_streaming_reap_pipeline(value, NULL);
+	}
+	g_hash_table_destroy(pipelines);
+	pipelines = NULL;
+	janus_mutex_unlock(&pipelines_mutex);
+	/* Gives the pipelines until the deadline, the hung ones are left behind */
+	gint64 deadline = janus_get_monotonic_time() + (gint64)teardown_timeout * 1000;
+	janus_mutex_lock(&reaper_mutex);
+	while (reaping && janus_get_monotonic_time() < deadline) {
+		janus_mutex_unlock(&reaper_mutex);
+		g_usleep(50000);
+		/* The watchdog is stopped, parked jobs are queued again from here */
+		janus_streaming_abandon_teardowns(janus_get_monotonic_time());
+		janus_mutex_lock(&reaper_mutex);
 	}
-	g_hash_table_remove_all(transcode_threads);
-	g_hash_table_destroy(transcode_threads);
-	transcode_threads = NULL;
-	janus_mutex_unlock(&transcode_threads_mutex);
+	guint hung = g_list_length(reaping);
+	janus_mutex_unlock(&reaper_mutex);
+	if (reaper) {
+		g_thread_pool_free(reaper, FALSE, hung == 0);
+		reaper = NULL;
+	}
+	if (hung) {
+		/* Their reaper threads still use the pipeline threads */
+		JANUS_LOG(LOG_ERR, "%u pipelines did not stop in %u ms, leaving them behind\n", hung, teardown_timeout);
+	} else {
+		context_pool_free(pipeline_pool);
+	}
+	pipeline_pool = NULL;
+
+	if (!hung) {
+		/* Otherwise a reaper thread may still be releasing a relay thread */
+		context_pool_free(relay_pool);
+	}
+	relay_pool = NULL;
+	fanout_pool_free(fanout);
+	fanout = NULL;
+	pacer_free(viewer_pacer);
+	viewer_pacer = NULL;
 	
 	socket_utils_destroy();
 	
@@ -890,6 +1914,8 @@ void janus_streaming_destroy(void) {
 	/* FIXME We should destroy the sessions cleanly */
 	usleep(500000);
 	janus_mutex_lock(&mountpoints_mutex);
+	g_hash_table_destroy(shared_sources);
+	shared_sources = NULL;
 	g_hash_table_destroy(mountpoints);
 	janus_mutex_unlock(&mountpoints_mutex);
 	janus_mutex_lock(&sessions_mutex);
@@ -899,8 +1925,12 @@ void janus_streaming_destroy(void) {
 	messages = NULL;
 	sessions = NULL;
 
+	packet_pool_destroy();
+
 	janus_config_destroy(config);
 	g_free(admin_key);
+	g_list_free_full(preloads, janus_streaming_preload_free);
+	preloads = NULL;
 
 	g_atomic_int_set(&initialized, 0);
 	g_atomic_int_set(&stopping, 0);
@@ -951,6 +1981,12 @@ void janus_streaming_create_session(janus_plugin_session *handle, int *error) {
 	session->started = FALSE;	/* This will happen later */
 	session->paused = FALSE;
 	session->destroyed = 0;
+	session->fanout_shard = (guint)g_atomic_int_add(&next_fanout_shard, 1);
+	session->rendition = -1;
+	janus_mutex_init(&session->temporal_mutex);
+	temporal_layers_filter_reset(&session->temporal);
+	if (viewer_pacer)
+		session->pacing = pacer_queue_new(viewer_pacer, janus_streaming_pacer_send, session);
 	g_atomic_int_set(&session->hangingup, 0);
 	handle->plugin_handle = session;
 	janus_mutex_lock(&sessions_mutex);
@@ -998,6 +2034,7 @@ static void janus_streaming_destroy_mountpoint(gchar *id_value)
 		mp->listeners = g_list_remove_all(mp->listeners, session);
 		viewer = g_list_first(mp->listeners);
 	}
+	janus_streaming_publish_listeners(mp);
 
 	json_decref(event);
 	janus_mutex_unlock(&mp->mutex);
@@ -1009,40 +2046,65 @@ static void janus_streaming_destroy_mountpoint(gchar *id_value)
 		if (!mp->destroyed) {
 			JANUS_LOG(LOG_ERR, "Destroy %s\n", mp->id);
 			mp->destroyed = janus_get_monotonic_time();
-			g_hash_table_remove(mountpoints, mp->id);
+			janus_streaming_unregister_mountpoint(mp);
 		}
 	}
 	janus_mutex_unlock(&mountpoints_mutex);								
 }
 
+/* The listeners are counted under mountpoints_mutex, which the watch request also holds
+ * while adding one, so a viewer cannot join between the count and what is decided on it */
 static void janus_streaming_destroy_mountpoint_if_not_used(janus_streaming_session *session)
 {
-	if (session->mountpoint) {			
-		janus_mutex_lock(&session->mountpoint->mutex);
-
-		guint old_listeners = g_list_length(session->mountpoint->listeners);			
-		session->mountpoint->listeners = g_list_remove_all(session->mountpoint->listeners, session);			
-		guint listeners = g_list_length(session->mountpoint->listeners);	
-		JANUS_LOG(LOG_INFO, "Destroy the mountpoint %u  \n",listeners);		
-		janus_mutex_unlock(&session->mountpoint->mutex);
-
-		if (old_listeners && !listeners) {					
-			teardown_pipeline(session->mountpoint);
-			janus_mutex_lock(&mountpoints_mutex);
-			JANUS_LOG(LOG_INFO, "Remove mountpoint - the last viewer  %s  \n",session->mountpoint->id);		
-			janus_streaming_mountpoint *mp = g_hash_table_lookup(mountpoints, session->mountpoint->id);
-			
-			if (mp) {
-				JANUS_LOG(LOG_INFO, "Remove mountpoint - the last viewer  %u  \n",listeners);
-				if(!mp->destroyed) {
-					JANUS_LOG(LOG_ERR, "Destroy %s\n", mp->id);
-					mp->destroyed = janus_get_monotonic_time();
-					g_hash_table_remove(mountpoints, mp->id);
-				}
-			}
-			janus_mutex_unlock(&mountpoints_mutex);								
-		}				
+	janus_streaming_mountpoint *mp = session->mountpoint;
+	gboolean teardown = FALSE;
+
+	if (!mp)
+		return;
+
+	janus_mutex_lock(&mountpoints_mutex);
+	janus_mutex_lock(&mp->mutex);
+	guint old_listeners = g_list_length(mp->listeners);
+	mp->listeners = g_list_remove_all(mp->listeners, session);
+	remb_aggregator_remove(mp->remb, session);
+	guint listeners = g_list_length(mp->listeners);
+	janus_streaming_publish_listeners(mp);
+	JANUS_LOG(LOG_INFO, "Destroy the mountpoint %u  \n",listeners);
+	janus_mutex_unlock(&mp->mutex);
+
+	if (!old_listeners || listeners || mp->destroyed) {
+		/* Still watched, or already on its way out */
+	} else if (mp->preloaded) {
+		/* Configured sources keep running for the next viewer */
+		JANUS_LOG(LOG_INFO, "Preloaded mountpoint %s unwatched, keeping it running\n", mp->id);
+	} else if (mountpoint_linger > 0) {
+		/* Keep the pipeline running for a viewer coming back, e.g. after a page reload; with
+		 * nobody listening the relay has nothing to fan out. The watchdog tears it down if
+		 * the linger runs out */
+		mp->linger_until = janus_get_monotonic_time() + (gint64)mountpoint_linger * 1000;
+		JANUS_LOG(LOG_INFO, "Mountpoint %s unwatched, lingering for %u ms\n", mp->id, mountpoint_linger);
+	} else {
+		JANUS_LOG(LOG_INFO, "Remove mountpoint - the last viewer  %s  \n", mp->id);
+		JANUS_LOG(LOG_ERR, "Destroy %s\n", mp->id);
+		mp->destroyed = janus_get_monotonic_time();
+		janus_streaming_unregister_mountpoint(mp);
+		teardown = TRUE;
 	}
+	janus_mutex_unlock(&mountpoints_mutex);
+
+	/* Not under mountpoints_mutex, the pipeline threads may be waiting for it */
+	if (teardown)
+		teardown_pipeline(mp);
+}
+
+/* Tears down a mountpoint whose linger ran out, already marked as destroyed by the watchdog */
+static void janus_streaming_expire_mountpoint(janus_streaming_mountpoint *mp)
+{
+	JANUS_LOG(LOG_INFO, "Mountpoint %s not watched again in %u ms, tearing it down\n", mp->id, mountpoint_linger);
+	teardown_pipeline(mp);
+	janus_mutex_lock(&mountpoints_mutex);
+	janus_streaming_unregister_mountpoint(mp);
+	janus_mutex_unlock(&mountpoints_mutex);
 }
 
 void janus_streaming_destroy_session(janus_plugin_session *handle, int *error) {
@@ -1063,6 +2125,8 @@ void janus_streaming_destroy_session(janus_plugin_session *handle, int *error) {
 		session->stopping = TRUE;
 		session->started = FALSE;
 		session->paused = FALSE;
+		if (session->pacing)
+			pacer_queue_close(session->pacing);
 
 		janus_streaming_destroy_mountpoint_if_not_used(session);
 	}
@@ -1154,9 +2218,9 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 		/* Return a list of all available mountpoints */
 		janus_mutex_lock(&mountpoints_mutex);
 		GHashTableIter iter;
-		gpointer value;
+		gpointer key, value;
 		g_hash_table_iter_init(&iter, mountpoints);
-		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
 			janus_streaming_mountpoint *mp = value;
 			if(mp->is_private) {
 				/* Skip private stream */
@@ -1164,7 +2228,8 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 				continue;
 			}
 			json_t *ml = json_object();
-			json_object_set_new(ml, "id", json_string(mp->id));
+			/* Each id of a shared source is listed */
+			json_object_set_new(ml, "id", json_string((const gchar *)key));
 			json_object_set_new(ml, "description", json_string(mp->description));	
 			json_array_append_new(list, ml);
 		}
@@ -1196,7 +2261,7 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 		json_t *ml = json_object();
 		json_object_set_new(ml, "id", json_string(mp->id));
 		json_object_set_new(ml, "description", json_string(mp->description));
-		
+		json_object_set_new(ml, "stats", janus_streaming_mountpoint_stats(mp));
 
 		janus_mutex_unlock(&mountpoints_mutex);
 		/* Send info back */
@@ -1204,6 +2269,12 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 		json_object_set_new(response, "streaming", json_string("info"));
 		json_object_set_new(response, "info", ml);
 		goto plugin_response;
+	} else if(!strcasecmp(request_text, "stats")) {
+		JANUS_LOG(LOG_VERB, "Request for the plugin statistics\n");
+		response = json_object();
+		json_object_set_new(response, "streaming", json_string("stats"));
+		json_object_set_new(response, "stats", janus_streaming_plugin_stats());
+		goto plugin_response;
 	} else if(!strcasecmp(request_text, "create")) {
 
 		/* Create a new stream */
@@ -1236,6 +2307,18 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 			g_snprintf(error_cause, 512, "No configuration file, can't create permanent mountpoint");
 			goto plugin_response;
 		}
+		json_t *ingest = json_object_get(root, "ingest");
+		gint ingest_value = ingest ? janus_streaming_parse_ingest(json_string_value(ingest)) : default_ingest;
+		if(ingest_value < 0) {
+			JANUS_LOG(LOG_ERR, "Unknown ingest mode '%s'...\n", json_string_value(ingest));
+			error_code = JANUS_STREAMING_ERROR_INVALID_ELEMENT;
+			g_snprintf(error_cause, 512, "Unknown ingest mode '%s'", json_string_value(ingest));
+			goto plugin_response;
+		}
+		json_t *videobufferkf = json_object_get(root, "videobufferkf");
+		gboolean buffer_kf = videobufferkf ? json_is_true(videobufferkf) : video_buffer_kf;
+		json_t *ladder = json_object_get(root, "ladder");
+		gboolean use_ladder = ladder ? json_is_true(ladder) : FALSE;
 		janus_streaming_mountpoint *mp = NULL;
 		if(!strcasecmp(type_text, "rtp")) {
 
@@ -1245,24 +2328,37 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 			json_t *is_private = json_object_get(root, "is_private");
 
 			if(id == NULL) {
-				JANUS_LOG(LOG_VERB, "Missing id, will generate a random one...\n");
+				JANUS_LOG(LOG_ERR, "Missing id...\n");
+				error_code = JANUS_STREAMING_ERROR_MISSING_ELEMENT;
+				g_snprintf(error_cause, 512, "Missing id");
+				goto plugin_response;
 			} else {								
 				janus_mutex_lock(&mountpoints_mutex);
 				mp = g_hash_table_lookup(mountpoints, json_string_value(id));
 				janus_mutex_unlock(&mountpoints_mutex);
 				if(mp == NULL) {										
+					janus_streaming_mountpoint *shared_with = NULL;
 					mp = janus_streaming_create_rtp_source(
 							handle,
 							id ? json_string_value(id) : NULL,
 							name ? (char *)json_string_value(name) : NULL,
-							desc ? (char *)json_string_value(desc) : NULL);
+							desc ? (char *)json_string_value(desc) : NULL,
+							ingest_value, buffer_kf, use_ladder,
+							is_private ? json_is_true(is_private) : FALSE,
+							secret ? json_string_value(secret) : NULL,
+							pin ? json_string_value(pin) : NULL,
+							&shared_with);
+					if(mp == NULL && shared_with) {
+						error_code = JANUS_STREAMING_ERROR_UNAUTHORIZED;
+						g_snprintf(error_cause, 512, "Source already streamed with a different secret, pin or privacy");
+						goto plugin_response;
+					}
 					if(mp == NULL) {
 						JANUS_LOG(LOG_ERR, "Error creating 'rtp' stream...\n");
 						error_code = JANUS_STREAMING_ERROR_CANT_CREATE;
 						g_snprintf(error_cause, 512, "Error creating 'rtp' stream");
 						goto plugin_response;
 					}
-					mp->is_private = is_private ? json_is_true(is_private) : FALSE;
 				}	
 				else
 				{	
@@ -1281,32 +2377,38 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 			g_snprintf(error_cause, 512, "Unknown stream type '%s'...\n", type_text);
 			goto plugin_response;
 		}
-		/* Any secret? */
-		if(secret)
-			mp->secret = g_strdup(json_string_value(secret));
-		/* Any PIN? */
-		if(pin)
-			mp->pin = g_strdup(json_string_value(pin));
+		/* Secret, PIN and privacy were set when the mountpoint was created: an existing one, or
+		 * one whose source is shared by several ids, is not changed by a create. An alias is
+		 * reported under its own id and name */
+		const gchar *created_id = json_string_value(json_object_get(root, "id"));
+		gboolean alias = strcmp(created_id, mp->id) != 0;
+		const gchar *created_name = mp->name, *created_desc = mp->description;
+		if(alias) {
+			json_t *name = json_object_get(root, "name");
+			json_t *desc = json_object_get(root, "description");
+			created_name = name ? json_string_value(name) : created_id;
+			created_desc = desc ? json_string_value(desc) : created_name;
+		}
 		if(save) {
 			/* This mountpoint is permanent: save to the configuration file too
 			 * FIXME: We should check if anything fails... */
-			JANUS_LOG(LOG_VERB, "Saving mountpoint %s permanently in config file\n", mp->id);
+			JANUS_LOG(LOG_VERB, "Saving mountpoint %s permanently in config file\n", created_id);
 			janus_mutex_lock(&config_mutex);
 			char value[BUFSIZ];
 			/* The category to add is the mountpoint name */
-			janus_config_add_category(config, mp->name);
+			janus_config_add_category(config, created_name);
 			/* Now for the common values */
-			janus_config_add_item(config, mp->name, "type", type_text);
-			g_snprintf(value, BUFSIZ, "%s", mp->id);
-			janus_config_add_item(config, mp->name, "id", value);
-			janus_config_add_item(config, mp->name, "description", mp->description);
+			janus_config_add_item(config, created_name, "type", type_text);
+			g_snprintf(value, BUFSIZ, "%s", created_id);
+			janus_config_add_item(config, created_name, "id", value);
+			janus_config_add_item(config, created_name, "description", created_desc);
 			if(mp->is_private)
-				janus_config_add_item(config, mp->name, "is_private", "yes");
+				janus_config_add_item(config, created_name, "is_private", "yes");
 			/* Some more common values */
 			if(mp->secret)
-				janus_config_add_item(config, mp->name, "secret", mp->secret);
+				janus_config_add_item(config, created_name, "secret", mp->secret);
 			if(mp->pin)
-				janus_config_add_item(config, mp->name, "pin", mp->pin);
+				janus_config_add_item(config, created_name, "pin", mp->pin);
 			/* Save modified configuration */
 			janus_config_save(config, config_folder, JANUS_STREAMING_PACKAGE);
 			janus_mutex_unlock(&config_mutex);
@@ -1314,11 +2416,13 @@ struct janus_plugin_result *janus_streaming_handle_message(janus_plugin_session
 		/* Send info back */
 		response = json_object();
 		json_object_set_new(response, "streaming", json_string("created"));
-		json_object_set_new(response, "created", json_string(mp->name));
+		json_object_set_new(response, "created", json_string(created_name));
 		json_t *ml = json_object();
-		json_object_set_new(ml, "id", json_string(mp->id));
-		json_object_set_new(ml, "description", json_string(mp->description));		
+		json_object_set_new(ml, "id", json_string(created_id));
+		json_object_set_new(ml, "description", json_string(created_desc));		
 		json_object_set_new(ml, "is_private", json_string(mp->is_private ? "true" : "false"));
+		if(alias)
+			json_object_set_new(ml, "shared_with", json_string(mp->id));
 		json_object_set_new(response, "stream", ml);
 		goto plugin_response;
 	} else if(!strcasecmp(request_text, "enable") || !strcasecmp(request_text, "disable")) {
@@ -1420,7 +2524,20 @@ void janus_streaming_setup_media(janus_plugin_session *handle) {
 		return;
 	g_atomic_int_set(&session->hangingup, 0);
 	/* We only start streaming towards this user when we get this event */
-
+	if(session->mountpoint && session->mountpoint->gop)
+		g_atomic_int_set(&session->burst_pending, 1);
+	janus_mutex_lock(&session->temporal_mutex);
+	temporal_layers_filter_reset(&session->temporal);
+	janus_mutex_unlock(&session->temporal_mutex);
+	if(session->pacing)
+		pacer_queue_reopen(session->pacing);
+	if(session->mountpoint && session->mountpoint->ladder_size) {
+		memset(&session->ladder, 0, sizeof(session->ladder));
+		session->rendition = -1;
+		session->rendition_switched = janus_get_monotonic_time();
+		g_atomic_int_set(&session->rendition_target,
+			ladder_select(session->mountpoint->ladder, session->mountpoint->ladder_size, -1, session->remb_estimate, -1, FALSE));
+	}
 	session->started = TRUE;
 	/* Prepare JSON event */
 	json_t *event = json_object();
@@ -1461,28 +2578,170 @@ void janus_streaming_incoming_rtcp(janus_plugin_session *handle, int video, char
 
 	int stream_type = video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO;
 
-	if (stream_type == JANUS_STREAMING_STREAM_VIDEO && ( janus_rtcp_has_pli(buf, len) || janus_rtcp_has_fir(buf, len))) {
-
-		GSocket * sock_rtcp_cli = mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTCP_RCV_CLI].socket;
-		guint32 new_ssrc = mountpoint->ssrc[stream_type];
+	if (stream_type == JANUS_STREAMING_STREAM_VIDEO && mountpoint->ladder_size) {
+		/* Renditions are encoded here with regular keyframes, feedback only picks the rendition */
+		if (janus_rtcp_has_pli(buf, len) || janus_rtcp_has_fir(buf, len))
+			keyframe_requests_ignore(mountpoint->keyframe_requests);
+		janus_streaming_select_rendition(session, mountpoint, janus_rtcp_get_remb(buf, len), ladder_fraction_lost(buf, len));
+		return;
+	}
 
-		//g_print("PLI sender_ssrc: %08X, receiver: %08X; to_fix: %08X\n", janus_rtcp_get_sender_ssrc(buf, len), janus_rtcp_get_receiver_ssrc(buf, len), new_ssrc);
-		janus_rtcp_fix_ssrc(NULL, buf, len, 1, new_ssrc, new_ssrc);
+	if (stream_type == JANUS_STREAMING_STREAM_VIDEO && ( janus_rtcp_has_pli(buf, len) || janus_rtcp_has_fir(buf, len))) {
+		if (keyframe_requests_add(mountpoint->keyframe_requests, janus_get_monotonic_time()))
+			janus_streaming_send_source_rtcp(mountpoint, buf, len);
+	}
 
-		if (g_socket_send(sock_rtcp_cli, buf, len, NULL, NULL) < 0) {
-			JANUS_LOG(LOG_ERR, "Send RTCP failed! type: %s\n", video ? "video" : "audio");
+	if (stream_type == JANUS_STREAMING_STREAM_VIDEO && mountpoint->nack && session->started && !session->paused) {
+		/* Retransmit what the viewer lost from the history, instead of waiting for a keyframe */
+		GSList *nacks = janus_rtcp_get_nacks(buf, len);
+		if (nacks) {
+			gint64 now = janus_get_monotonic_time();
+			gboolean recovered = TRUE;
+			for (GSList *l = nacks; l; l = l->next) {
+				/* Back to the source's numbering with the offsets the packet went out with, when
+				 * temporal layers were dropped for this viewer; unknown ones are not guessed */
+				guint16 seq = (guint16)GPOINTER_TO_UINT(l->data);
+				guint16 seq_offset = 0, picture_id_offset = 0;
+				janus_mutex_lock(&session->temporal_mutex);
+				gboolean known = temporal_layers_filter_sent_offsets(&session->temporal, seq, &seq_offset, &picture_id_offset);
+				janus_mutex_unlock(&session->temporal_mutex);
+				packet_buffer *buffer = known ? nack_history_lookup(mountpoint->nack, seq + seq_offset, now) : NULL;
+				if (!buffer) {
+					recovered = FALSE;
+					continue;
+				}
+				if (seq_offset || picture_id_offset)
+					janus_streaming_relay_shifted_packet(session, buffer->data, buffer->length, seq_offset, picture_id_offset);
+				else
+					janus_streaming_relay_to_viewer(session, TRUE, buffer->data, buffer->length);
+				packet_buffer_unref(buffer);
+			}
+			nack_history_feedback(mountpoint->nack, recovered);
+			g_slist_free(nacks);
 		}
 	}
 
-	/* We might interested in the available bandwidth that the user advertizes */
+	/* The available bandwidth that the user advertizes bounds what the source should send */
 	uint64_t bw = janus_rtcp_get_remb(buf, len);
 	if(bw > 0) {
-		JANUS_LOG(LOG_HUGE, "REMB for this PeerConnection: %"SCNu64"\n", bw);
-		/* TODO Use this somehow (e.g., notification towards application?) */
+		STREAMING_TRACE(LOG_HUGE, "REMB for this PeerConnection: %"SCNu64"\n", bw);
+		session->remb_estimate = bw;
+		janus_streaming_update_pacing(session);
+		if (mountpoint->temporal_layers > 1)
+			janus_streaming_select_temporal_layer(session, mountpoint);
+		guint64 bitrate = remb_aggregator_update(mountpoint->remb, session, bw, janus_get_monotonic_time());
+		if (bitrate > 0)
+			janus_streaming_apply_bitrate(mountpoint, bitrate);
 	}
 	/* FIXME Maybe we should care about RTCP, but not now */
 }
 
+/* Sends the request coalesced during the last window once it is over; called on the relay
+ * path and from a timer on the relay thread, for a source that stopped sending */
+static gboolean janus_streaming_flush_keyframe_requests(gpointer user_data)
+{
+	janus_streaming_mountpoint *mountpoint = (janus_streaming_mountpoint *)user_data;
+
+	if (keyframe_requests_poll(mountpoint->keyframe_requests, janus_get_monotonic_time())) {
+		char pli[12];
+		janus_rtcp_pli(pli, sizeof(pli));
+		janus_streaming_send_source_rtcp(mountpoint, pli, sizeof(pli));
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+/* Sends RTCP feedback upstream on behalf of the viewers of the mountpoint */
+static void janus_streaming_send_source_rtcp(janus_streaming_mountpoint *mountpoint, char *buf, int len)
+{
+	GSocket * sock_rtcp_cli = mountpoint->socket[JANUS_STREAMING_STREAM_VIDEO][JANUS_STREAMING_SOCKET_RTCP_RCV_CLI].socket;
+	guint32 new_ssrc = mountpoint->ssrc[JANUS_STREAMING_STREAM_VIDEO];
+
+	if (!sock_rtcp_cli)
+		return;
+
+	//g_print("PLI sender_ssrc: %08X, receiver: %08X; to_fix: %08X\n", janus_rtcp_get_sender_ssrc(buf, len), janus_rtcp_get_receiver_ssrc(buf, len), new_ssrc);
+	janus_rtcp_fix_ssrc(NULL, buf, len, 1, new_ssrc, new_ssrc);
+
+	if (g_socket_send(sock_rtcp_cli, buf, len, NULL, NULL) < 0) {
+		JANUS_LOG(LOG_ERR, "Send RTCP failed! type: video\n");
+	}
+}
+
+/* Moves a viewer of a ladder mountpoint down as soon as its estimate or losses call for it,
+ * and up only after it has stayed on its rendition for a while */
+static void janus_streaming_select_rendition(janus_streaming_session *session, janus_streaming_mountpoint *mountpoint, guint64 estimate, gint fraction_lost)
+{
+	if (estimate == 0 && fraction_lost < 0)
+		return;
+	if (estimate > 0) {
+		session->remb_estimate = estimate;
+		janus_streaming_update_pacing(session);
+	}
+
+	gint64 now = janus_get_monotonic_time();
+	gint current = g_atomic_int_get(&session->rendition_target);
+	gboolean may_upgrade = now - session->rendition_switched >= JANUS_STREAMING_LADDER_UPGRADE_HOLD;
+	gint target = ladder_select(mountpoint->ladder, mountpoint->ladder_size, current, session->remb_estimate, fraction_lost, may_upgrade);
+
+	if (target != current) {
+		JANUS_LOG(LOG_VERB, "Moving a viewer of %s from rendition %d to %d (estimate %"SCNu64", lost %d/256)\n",
+			mountpoint->id, current, target, session->remb_estimate, fraction_lost);
+		session->rendition_switched = now;
+		g_atomic_int_set(&session->rendition_target, target);
+	}
+}
+
+/* Bitrate of the incoming video over the last second or so, from the relay counters */
+static guint64 janus_streaming_video_bitrate(janus_streaming_mountpoint *mountpoint, gint64 now)
+{
+	guint64 bytes = mountpoint->rtp_bytes[JANUS_STREAMING_STREAM_VIDEO];
+	gint64 elapsed = now - mountpoint->video_bitrate_time;
+
+	if (elapsed >= G_USEC_PER_SEC) {
+		if (mountpoint->video_bitrate_time)
+			mountpoint->video_bitrate = (bytes - mountpoint->video_bitrate_bytes) * 8 * G_USEC_PER_SEC / elapsed;
+		mountpoint->video_bitrate_bytes = bytes;
+		mountpoint->video_bitrate_time = now;
+	}
+
+	return mountpoint->video_bitrate;
+}
+
+/* Frame rate adaptation: drops the upper temporal layers the viewer's estimate can't carry */
+static void janus_streaming_select_temporal_layer(janus_streaming_session *session, janus_streaming_mountpoint *mountpoint)
+{
+	gint64 now = janus_get_monotonic_time();
+	gint current = g_atomic_int_get(&session->temporal.target_layer);
+	gboolean may_upgrade = now - session->temporal.switched >= JANUS_STREAMING_LADDER_UPGRADE_HOLD;
+	gint target = temporal_layers_select(mountpoint->temporal_layers, current,
+		janus_streaming_video_bitrate(mountpoint, now), session->remb_estimate, may_upgrade);
+
+	if (target != current) {
+		JANUS_LOG(LOG_VERB, "Forwarding temporal layers up to %d to a viewer of %s (estimate %"SCNu64")\n",
+			target, mountpoint->id, session->remb_estimate);
+		session->temporal.switched = now;
+		g_atomic_int_set(&session->temporal.target_layer, target);
+	}
+}
+
+/* Transcoding pipelines retune their encoder, passthrough sources get one REMB on behalf of all viewers */
+static void janus_streaming_apply_bitrate(janus_streaming_mountpoint *mountpoint, guint64 bitrate)
+{
+	janus_mutex_lock(&mountpoint->mutex);
+	GstElement *encoder = mountpoint->encoder ? gst_object_ref(mountpoint->encoder) : NULL;
+	janus_mutex_unlock(&mountpoint->mutex);
+
+	if (encoder) {
+		JANUS_LOG(LOG_VERB, "Setting the encoder bitrate of %s to %"SCNu64"\n", mountpoint->id, bitrate);
+		set_encoder_bitrate(encoder, bitrate);
+		gst_object_unref(encoder);
+		return;
+	}
+
+	char remb[24];
+	if (janus_rtcp_remb(remb, sizeof(remb), bitrate) > 0)
+		janus_streaming_send_source_rtcp(mountpoint, remb, sizeof(remb));
+}
 
 void janus_streaming_hangup_media(janus_plugin_session *handle) {
 	JANUS_LOG(LOG_INFO, "Streaming: No WebRTC media anymore\n");
@@ -1497,6 +2756,9 @@ void janus_streaming_hangup_media(janus_plugin_session *handle) {
 		return;
 	if(g_atomic_int_add(&session->hangingup, 1))
 		return;
+	/* What is still paced has no PeerConnection to go to */
+	if(session->pacing)
+		pacer_queue_close(session->pacing);
 
 	/* FIXME Simulate a "stop" coming from the browser */
 	janus_streaming_message *msg = g_malloc0(sizeof(janus_streaming_message));
@@ -1571,8 +2833,13 @@ static void *janus_streaming_handler(void *data) {
 			const gchar *id_value = json_string_value(id);			
 			janus_mutex_lock(&mountpoints_mutex);			
 			janus_streaming_mountpoint *mp = g_hash_table_lookup(mountpoints, id_value);
-			if(mp == NULL) {
+			if(mp == NULL || mp->destroyed) {
+				/* Gone, or its linger just ran out */
 				JANUS_LOG(LOG_ERR, "No such mountpoint/stream %s\n", id_value);
+				error_code = JANUS_STREAMING_ERROR_NO_SUCH_MOUNTPOINT;
+				g_snprintf(error_cause, 512, "No such mountpoint/stream %s", id_value);
+				janus_mutex_unlock(&mountpoints_mutex);
+				goto error;
 			}
 
 			// A secret may be required for this action 
@@ -1582,17 +2849,25 @@ static void *janus_streaming_handler(void *data) {
 				janus_mutex_unlock(&mountpoints_mutex);
 				goto error;
 			}
+			if(mp->linger_until) {
+				/* Still running: no RTSP setup nor keyframe wait for this viewer */
+				JANUS_LOG(LOG_INFO, "Mountpoint %s watched again while lingering\n", id_value);
+				mp->linger_until = 0;
+				linger_hits++;
+			}
 
-			janus_mutex_unlock(&mountpoints_mutex);
-			
 			JANUS_LOG(LOG_VERB, "Request to watch mountpoint/stream %s\n", id_value);
 			session->stopping = FALSE;
 			session->mountpoint = mp;
 	
 			/* TODO Check if user is already watching a stream, if the video is active, etc. */
+			/* Still under mountpoints_mutex: the mountpoint cannot be found unwatched and
+			 * destroyed between the check above and this */
 			janus_mutex_lock(&mp->mutex);
 			mp->listeners = g_list_append(mp->listeners, session);
+			janus_streaming_publish_listeners(mp);
 			janus_mutex_unlock(&mp->mutex);			
+			janus_mutex_unlock(&mountpoints_mutex);
 		
 			sdp_type = "offer";	/* We're always going to do the offer ourselves, never answer */
 			char sdptemp[2048];
@@ -1646,12 +2921,12 @@ static void *janus_streaming_handler(void *data) {
 				mp->codecs.video_pt, "");
 			g_strlcat(sdptemp, buffer, 2048);
 
-#if 0 //todo: check if we can make use of it
-			g_snprintf(buffer, 512,
-				"a=rtcp-fb:%d nack\r\n",
-				mp->codecs.video_pt);
-			g_strlcat(sdptemp, buffer, 2048);
-#endif
+			if (mp->nack) {
+				g_snprintf(buffer, 512,
+					"a=rtcp-fb:%d nack\r\n",
+					mp->codecs.video_pt);
+				g_strlcat(sdptemp, buffer, 2048);
+			}
 			g_snprintf(buffer, 512,
 				"a=rtcp-fb:%d nack pli\r\n",
 				mp->codecs.video_pt);
@@ -1755,6 +3030,14 @@ static void janus_streaming_mountpoint_free(gpointer data) {
 	janus_streaming_mountpoint *mp = (janus_streaming_mountpoint*)data;
 
 	if (mp) {
+		janus_mutex_lock(&reaper_mutex);
+		if (mp->reaping) {
+			/* Its pipeline may still use it, freed by the reaper once stopped */
+			mp->free_pending = TRUE;
+			janus_mutex_unlock(&reaper_mutex);
+			return;
+		}
+		janus_mutex_unlock(&reaper_mutex);
 		g_free(mp->id);
 		g_free(mp->name);
 		g_free(mp->description);
@@ -1764,14 +3047,91 @@ static void janus_streaming_mountpoint_free(gpointer data) {
 		g_free(mp->codecs.audio_fmtp);
 		g_free(mp->codecs.video_rtpmap);
 		g_free(mp->codecs.video_fmtp);
+		for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
+			if (mp->rtp_batch[stream].size)
+				socket_utils_batch_free(&mp->rtp_batch[stream]);
+		}
+		g_list_free(mp->listeners);
+		janus_streaming_listeners_unref(mp->listeners_snapshot);
+		for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
+			janus_streaming_listeners_unref(mp->fanout_last[stream]);
+		}
+		gop_cache_free(mp->gop);
+		keyframe_requests_free(mp->keyframe_requests);
+		nack_history_free(mp->nack);
+		remb_aggregator_free(mp->remb);
+		g_free(mp->ladder);
+		g_free(mp->renditions);
+		g_free(mp->source_key);
+		g_list_free_full(mp->aliases, g_free);
 		g_free(mp);
 	}
 }
 
-/* Helper to create an RTP live source (e.g., from gstreamer/ffmpeg/vlc/etc.) */
+/* Value destroy of the mountpoints table, which has an entry for each id of a mountpoint */
+static void janus_streaming_mountpoint_unref(gpointer data) {
+
+	janus_streaming_mountpoint *mp = (janus_streaming_mountpoint*)data;
+
+	if (mp && --mp->names > 0)
+		return;
+	janus_streaming_mountpoint_free(mp);
+}
+
+/* Removes a mountpoint under all its ids, and its source from the shared ones; called
+ * with mountpoints_mutex held, may free it */
+static void janus_streaming_unregister_mountpoint(janus_streaming_mountpoint *mp) {
+
+	if (mp->source_key && g_hash_table_lookup(shared_sources, mp->source_key) == mp)
+		g_hash_table_remove(shared_sources, mp->source_key);
+	GList *aliases = mp->aliases;
+	mp->aliases = NULL;
+	for (GList *l = aliases; l; l = l->next) {
+		g_hash_table_remove(mountpoints, l->data);
+		g_free(l->data);
+	}
+	g_list_free(aliases);
+	g_hash_table_remove(mountpoints, mp->id);
+}
+
+/* Key of the shared sources: scheme and host lowercased, default RTSP port and trailing
+ * slashes dropped; credentials, path and query are kept as they are */
+static gchar *janus_streaming_normalize_uri(const gchar *uri) {
+
+	const gchar *sep = strstr(uri, "://");
+	if (!sep)
+		return g_strdup(uri);
+
+	gchar *scheme = g_ascii_strdown(uri, sep - uri);
+	const gchar *authority = sep + 3;
+	const gchar *path = authority + strcspn(authority, "/?#");
+	const gchar *host = g_strrstr_len(authority, path - authority, "@");
+	host = host ? host + 1 : authority;
+	gchar *userinfo = g_strndup(authority, host - authority);
+	gchar *hostport = g_ascii_strdown(host, path - host);
+	if (!strcmp(scheme, "rtsp") && g_str_has_suffix(hostport, ":554"))
+		hostport[strlen(hostport) - 4] = '\0';
+	gchar *rest = g_strdup(path);
+	gsize len = strlen(rest);
+	while (len > 0 && rest[len - 1] == '/')
+		rest[--len] = '\0';
+
+	gchar *key = g_strdup_printf("%s://%s%s%s", scheme, userinfo, hostport, rest);
+	g_free(scheme);
+	g_free(userinfo);
+	g_free(hostport);
+	g_free(rest);
+
+	return key;
+}
+
+/* Helper to create an RTP live source (e.g., from gstreamer/ffmpeg/vlc/etc.). When its uri is
+ * already ingested, shared_with is set to that mountpoint, which is returned with id as an alias
+ * if the access control matches, NULL otherwise; the caller never writes onto it */
 janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 		janus_plugin_session *handle,
-		const gchar *id, char *name, char *desc)
+		const gchar *id, char *name, char *desc, gint ingest, gboolean buffer_kf, gboolean ladder,
+		gboolean is_private, const gchar *secret, const gchar *pin, janus_streaming_mountpoint **shared_with)
 {
 	janus_mutex_lock(&mountpoints_mutex);
 
@@ -1808,26 +3168,108 @@ janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 	else
 		description = g_strdup(name ? name : tempname);
 	live_rtp->description = description;
+	live_rtp->is_private = is_private;
+	live_rtp->secret = g_strdup(secret);
+	live_rtp->pin = g_strdup(pin);
 	live_rtp->enabled = TRUE;
 	live_rtp->active = FALSE;
 	live_rtp->listeners = NULL;
 	live_rtp->destroyed = 0;
-	gchar *source = NULL;
+	live_rtp->ingest = ingest;
+	live_rtp->video_codec = GOP_CACHE_CODEC_UNKNOWN;
+	if (ladder && ladder_count) {
+		/* Renditions are encoded here, the source's keyframes and packets never reach the viewers */
+		live_rtp->ladder_size = ladder_count;
+		live_rtp->ladder = g_memdup(ladder_specs, ladder_count * sizeof(ladder_rendition_spec));
+		live_rtp->renditions = g_new0(janus_streaming_rendition, ladder_count);
+		for (guint i = 0; i < ladder_count; i++) {
+			janus_streaming_rendition *rendition = &live_rtp->renditions[i];
+			rendition->index = i;
+			rendition->spec = ladder_specs[i];
+			rendition->ssrc = g_random_int();
+			rendition->cbk_data.session = (gpointer)live_rtp;
+			rendition->cbk_data.is_video = TRUE;
+			rendition->cbk_data.rendition = rendition;
+		}
+		buffer_kf = FALSE;
+	}
+	if (buffer_kf)
+		live_rtp->gop = gop_cache_new(gop_cache_max_packets);
+	live_rtp->keyframe_requests = keyframe_requests_new(pli_window, pli_keyframe_timeout);
+	if (nack_history_depth > 0 && !live_rtp->ladder_size)
+		live_rtp->nack = nack_history_new(nack_history_depth);
+	live_rtp->remb = remb_aggregator_new(remb_percentile, remb_interval);
+	gchar *source = NULL, *backup = NULL;
 
 	janus_mutex_lock(&mountpoints_mutex);
-	if (!registry_endpoint) {
-			JANUS_LOG(LOG_WARN, "Registry endpoint not specified. Trying local registry.\n");			
-			
+	/* Callers look the id up without holding the lock until here: a preload and a create, or
+	 * two creates, of the same id can race, the one coming second watches the first one's */
+	janus_streaming_mountpoint *existing = g_hash_table_lookup(mountpoints, id);
+	if (existing) {
+		JANUS_LOG(LOG_INFO, "Mountpoint %s created meanwhile, watching it\n", id);
+		if (shared_with)
+			*shared_with = NULL;
+		if (handle)
+			janus_streaming_send_watch_request(live_rtp->id, handle);
+		janus_streaming_mountpoint_free(live_rtp);
+		janus_mutex_unlock(&mountpoints_mutex);
+		return existing;
+	}
+	/* The sources of the configuration come first, then the registry */
+	for (GList *l = preloads; l && !source; l = l->next) {
+		janus_streaming_preload *preload = (janus_streaming_preload *)l->data;
+		if (!strcmp(preload->id, id)) {
+			source = g_strdup(preload->uri);
+			backup = g_strdup(preload->backup);
 		}
-		else {			
-			source = get_source_from_registry_by_id(registry_endpoint, id);
-			JANUS_LOG(LOG_INFO,"\n*** setup_pipeline   source from registry %s ***\n",source);
-			if(source){
-				janus_mutex_init(&live_rtp->mutex);
-				g_hash_table_insert(mountpoints, live_rtp->id, live_rtp);				
-				setup_pipeline(handle, source, live_rtp->id);		
-			}
-		}		
+	}
+	if (source) {
+		JANUS_LOG(LOG_INFO, "Source of %s from the configuration: %s\n", id, source);
+	} else if (!registry_endpoint) {
+		JANUS_LOG(LOG_WARN, "Registry endpoint not specified and %s is not a configured source.\n", id);
+	} else {
+		source = get_source_from_registry_by_id(registry_endpoint, id, &backup);
+		JANUS_LOG(LOG_INFO,"\n*** setup_pipeline   source from registry %s ***\n",source);
+	}
+	if (source && backup)
+		JANUS_LOG(LOG_INFO, "Backup of %s: %s\n", id, backup);
+	janus_streaming_mountpoint *shared = NULL;
+	if (source && share_sources) {
+		live_rtp->source_key = janus_streaming_normalize_uri(source);
+		shared = g_hash_table_lookup(shared_sources, live_rtp->source_key);
+		if (shared && shared->destroyed)
+			shared = NULL;
+	}
+	if (shared_with)
+		*shared_with = shared;
+	if (shared && (shared->is_private != is_private || g_strcmp0(shared->secret, secret) || g_strcmp0(shared->pin, pin))) {
+		/* One set of viewers for all the ids, they cannot be guarded differently */
+		JANUS_LOG(LOG_ERR, "Source of %s already ingested by %s with a different secret, pin or privacy\n", id, shared->id);
+		janus_streaming_mountpoint_free(live_rtp);
+		live_rtp = NULL;
+	} else if (shared) {
+		/* Same camera: one RTSP session and one ingest, the id is an alias of that mountpoint
+		 * and its viewers are relayed to with the others */
+		JANUS_LOG(LOG_INFO, "Source of %s already ingested by %s, sharing it\n", id, shared->id);
+		if (shared->ingest != ingest || !shared->ladder_size != !live_rtp->ladder_size || !shared->gop != !live_rtp->gop)
+			JANUS_LOG(LOG_WARN, "Ingest, ladder and videobufferkf of %s are those of %s, not the requested ones\n", id, shared->id);
+		shared->aliases = g_list_prepend(shared->aliases, g_strdup(id));
+		shared->names++;
+		g_hash_table_insert(mountpoints, shared->aliases->data, shared);
+		shared_attaches++;
+		if (handle)
+			janus_streaming_send_watch_request(live_rtp->id, handle);
+		janus_streaming_mountpoint_free(live_rtp);
+		live_rtp = shared;
+	} else if(source){
+		janus_mutex_init(&live_rtp->mutex);
+		live_rtp->names = 1;
+		g_hash_table_insert(mountpoints, live_rtp->id, live_rtp);				
+		if (live_rtp->source_key)
+			g_hash_table_insert(shared_sources, live_rtp->source_key, live_rtp);
+		setup_pipeline(handle, source, backup, live_rtp->id);		
+	}
+	g_free(backup);
 
 	if((gchar*)source){
 	  g_free(source);
@@ -1839,31 +3281,303 @@ janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 	return live_rtp;
 }
 
+/* Collects the "type = source" categories of the configuration; they are started by the
+ * preload threads, and are where create_rtp_source looks the source of an id up first */
+static void janus_streaming_parse_preloads(janus_config *config)
+{
+	for (GList *cl = janus_config_get_categories(config); cl; cl = cl->next) {
+		janus_config_category *cat = (janus_config_category *)cl->data;
+		if (!cat->name || !strcasecmp(cat->name, "general"))
+			continue;
+		janus_config_item *type = janus_config_get_item(cat, "type");
+		if (!type || !type->value || strcasecmp(type->value, "source"))
+			continue;
+		janus_config_item *id = janus_config_get_item(cat, "id");
+		janus_config_item *uri = janus_config_get_item(cat, "uri");
+		janus_config_item *backup = janus_config_get_item(cat, "backup");
+		if (!id || !id->value || !uri || !uri->value) {
+			JANUS_LOG(LOG_WARN, "Skipping source '%s', it needs both an id and a uri\n", cat->name);
+			continue;
+		}
+		janus_config_item *desc = janus_config_get_item(cat, "description");
+		janus_config_item *pin = janus_config_get_item(cat, "pin");
+		janus_config_item *is_private = janus_config_get_item(cat, "is_private");
+		janus_config_item *ingest = janus_config_get_item(cat, "ingest");
+		janus_config_item *buffer_kf = janus_config_get_item(cat, "videobufferkf");
+		janus_config_item *ladder = janus_config_get_item(cat, "ladder");
+
+		janus_streaming_preload *preload = g_malloc0(sizeof(janus_streaming_preload));
+		preload->id = g_strdup(id->value);
+		preload->uri = g_strdup(uri->value);
+		preload->backup = backup && backup->value ? g_strdup(backup->value) : NULL;
+		preload->name = g_strdup(cat->name);
+		preload->description = desc && desc->value ? g_strdup(desc->value) : NULL;
+		preload->pin = pin && pin->value ? g_strdup(pin->value) : NULL;
+		preload->is_private = is_private && is_private->value && janus_is_true(is_private->value);
+		preload->ingest = ingest && ingest->value ? janus_streaming_parse_ingest(ingest->value) : default_ingest;
+		if (preload->ingest < 0) {
+			JANUS_LOG(LOG_WARN, "Unknown ingest mode '%s' for source '%s', using the default\n", ingest->value, cat->name);
+			preload->ingest = default_ingest;
+		}
+		preload->buffer_kf = buffer_kf && buffer_kf->value ? janus_is_true(buffer_kf->value) : video_buffer_kf;
+		preload->ladder = ladder && ladder->value && janus_is_true(ladder->value);
+		preload->state = JANUS_STREAMING_PRELOAD_QUEUED;
+		preloads = g_list_append(preloads, preload);
+		JANUS_LOG(LOG_INFO, "Source '%s' (%s) will be preloaded from %s\n", preload->name, preload->id, preload->uri);
+	}
+}
+
+/* Starts the pipeline of a configured source and holds a preload thread until its first
+ * packet, which is what bounds the number of sources being set up at once */
+static void janus_streaming_preload_run(gpointer data, gpointer user_data)
+{
+	janus_streaming_preload *preload = (janus_streaming_preload *)data;
+
+	if (g_atomic_int_get(&stopping))
+		return;
+
+	janus_mutex_lock(&mountpoints_mutex);
+	janus_streaming_mountpoint *mp = g_hash_table_lookup(mountpoints, preload->id);
+	janus_mutex_unlock(&mountpoints_mutex);
+	if (!mp) {
+		/* No session to report to, the pipeline's own requests are dropped */
+		mp = janus_streaming_create_rtp_source(NULL, preload->id, preload->name, preload->description,
+			preload->ingest, preload->buffer_kf, preload->ladder, preload->is_private, NULL, preload->pin, NULL);
+	}
+
+	janus_mutex_lock(&mountpoints_mutex);
+	if (g_hash_table_lookup(mountpoints, preload->id) != mp) {
+		janus_mutex_unlock(&mountpoints_mutex);
+		JANUS_LOG(LOG_ERR, "Could not preload source %s\n", preload->id);
+		g_atomic_int_set(&preload->state, JANUS_STREAMING_PRELOAD_FAILED);
+		return;
+	}
+	mp->preloaded = TRUE;
+	janus_mutex_unlock(&mountpoints_mutex);
+
+	g_atomic_int_set(&preload->state, JANUS_STREAMING_PRELOAD_STARTING);
+	gint64 started = janus_get_monotonic_time();
+	gint state = JANUS_STREAMING_PRELOAD_TIMEOUT;
+	while (!g_atomic_int_get(&stopping) && janus_get_monotonic_time() - started < (gint64)preload_timeout * 1000) {
+		/* Looked up again each time, a destroy request may have removed it */
+		janus_mutex_lock(&mountpoints_mutex);
+		mp = g_hash_table_lookup(mountpoints, preload->id);
+		gboolean active = mp && mp->active;
+		janus_mutex_unlock(&mountpoints_mutex);
+		if (!mp) {
+			state = JANUS_STREAMING_PRELOAD_FAILED;
+			break;
+		}
+		if (active) {
+			state = JANUS_STREAMING_PRELOAD_READY;
+			preload->ready_time = (janus_get_monotonic_time() - started) / 1000;
+			break;
+		}
+		g_usleep(50000);
+	}
+	g_atomic_int_set(&preload->state, state);
+	int log_level = state == JANUS_STREAMING_PRELOAD_READY ? LOG_INFO : LOG_WARN;
+	JANUS_LOG(log_level, "Preloaded source %s: %s\n",
+		preload->id, janus_streaming_preload_state_str(state));
+}
+
+static void janus_streaming_preload_free(gpointer data)
+{
+	janus_streaming_preload *preload = (janus_streaming_preload *)data;
+
+	g_free(preload->id);
+	g_free(preload->uri);
+	g_free(preload->backup);
+	g_free(preload->name);
+	g_free(preload->description);
+	g_free(preload->pin);
+	g_free(preload);
+}
+
+static const gchar *janus_streaming_preload_state_str(gint state)
+{
+	switch (state) {
+		case JANUS_STREAMING_PRELOAD_QUEUED:
+			return "queued";
+		case JANUS_STREAMING_PRELOAD_STARTING:
+			return "starting";
+		case JANUS_STREAMING_PRELOAD_READY:
+			return "ready";
+		case JANUS_STREAMING_PRELOAD_TIMEOUT:
+			return "timeout";
+		default:
+			return "failed";
+	}
+}
+
 static void janus_streaming_relay_rtp_packet(gpointer data, gpointer user_data) {
 
 	janus_streaming_rtp_relay_packet *packet = (janus_streaming_rtp_relay_packet *)user_data;
 	if(!packet || !packet->data || packet->length < 1) {
-		JANUS_LOG(LOG_ERR, "Invalid packet...\n");
+		trace_counter_hit(&invalid_relay_packets);
 		return;
 	}
 	janus_streaming_session *session = (janus_streaming_session *)data;
 	if(!session || !session->handle) {
-		JANUS_LOG(LOG_ERR, "Invalid session...\n");
+		trace_counter_hit(&invalid_relay_sessions);
 		return;
 	}
 	if((!session->started || session->paused )) {
-		JANUS_LOG(LOG_INFO, "Streaming not started yet for this session...\n");
+		trace_counter_hit(&not_started_packets);
+		STREAMING_TRACE(LOG_HUGE, "Streaming not started yet for this session...\n");
 		return;
 	}
 	else{
-		gateway->relay_rtp(session->handle, packet->is_video, (char *)packet->data, packet->length);
+		if(packet->is_video && g_atomic_int_compare_and_exchange(&session->burst_pending, 1, 0))
+			janus_streaming_burst_gop(session, packet);
+		if(packet->is_video) {
+			janus_streaming_relay_video_packet(session, (char *)packet->data, packet->length,
+				packet->is_vp8 ? &packet->vp8 : NULL, packet->seq_number);
+			return;
+		}
+		janus_streaming_relay_to_viewer(session, packet->is_video, (char *)packet->data, packet->length);
 	}
 	return;
 }
 
+/* Last hop of every packet relayed to a viewer: video goes through the viewer's pacer when
+ * pacing is enabled, so that keyframes and GOP bursts leave at a rate its link can take */
+static void janus_streaming_relay_to_viewer(janus_streaming_session *session, gboolean is_video, char *buf, int len)
+{
+	if (is_video && session->pacing)
+		pacer_queue_push(session->pacing, is_video, buf, len);
+	else
+		gateway->relay_rtp(session->handle, is_video, buf, len);
+}
+
+static void janus_streaming_pacer_send(gpointer user_data, gboolean is_video, char *buf, int len)
+{
+	janus_streaming_session *session = (janus_streaming_session *)user_data;
+	janus_plugin_session *handle = session->handle;
+
+	if (handle && !handle->stopped && !g_atomic_int_get(&stopping))
+		gateway->relay_rtp(handle, is_video, buf, len);
+}
+
+/* Paces a viewer at a multiple of its estimate, or not at all until it sends one */
+static void janus_streaming_update_pacing(janus_streaming_session *session)
+{
+	if (session->pacing)
+		pacer_queue_set_rate(session->pacing, (guint64)(session->remb_estimate * pacing_multiplier));
+}
+
+/* Video to a viewer goes through its temporal layer filter. seq is the packet's number
+ * in the NACK history, recorded with the offsets it goes out with; -1 for a packet that
+ * is not sent as it is stored there, which is then never retransmitted */
+static void janus_streaming_relay_video_packet(janus_streaming_session *session, char *buf, int len, const temporal_layers_vp8_info *vp8, gint seq)
+{
+	janus_streaming_mountpoint *mountpoint = session->mountpoint;
+	guint16 seq_offset = 0, picture_id_offset = 0;
+	gboolean forward = TRUE;
+
+	/* Nothing to filter, shift nor record */
+	if (!mountpoint || (!mountpoint->nack && mountpoint->video_codec != GOP_CACHE_CODEC_VP8)) {
+		janus_streaming_relay_to_viewer(session, TRUE, buf, len);
+		return;
+	}
+
+	janus_mutex_lock(&session->temporal_mutex);
+	if (vp8)
+		forward = temporal_layers_filter_forward(&session->temporal, vp8);
+	if (forward) {
+		seq_offset = session->temporal.seq_offset;
+		picture_id_offset = session->temporal.picture_id_offset;
+		if (seq >= 0 && mountpoint && mountpoint->nack)
+			temporal_layers_filter_sent(&session->temporal, (guint16)seq);
+	}
+	janus_mutex_unlock(&session->temporal_mutex);
+
+	if (!forward)
+		return;
+	if (seq_offset || picture_id_offset)
+		janus_streaming_relay_shifted_packet(session, buf, len, seq_offset, picture_id_offset);
+	else
+		janus_streaming_relay_to_viewer(session, TRUE, buf, len);
+}
+
+/* Relays a copy of a VP8 packet with the sequence number and PictureID moved back by
+ * the temporal layers dropped for this viewer before it was first sent */
+static void janus_streaming_relay_shifted_packet(janus_streaming_session *session, const char *buf, int len, guint16 seq_offset, guint16 picture_id_offset)
+{
+	gchar data[PACKET_POOL_BUFFER_SIZE];
+	temporal_layers_vp8_info vp8;
+	int plen = 0;
+
+	memcpy(data, buf, len);
+	char *payload = janus_rtp_payload(data, len, &plen);
+	if (!payload || !temporal_layers_parse_vp8((const guint8 *)payload, plen, &vp8))
+		vp8.picture_id = -1;	/* Still renumbered, the PictureID cannot be found */
+	temporal_layers_rewrite(seq_offset, picture_id_offset, data, len, &vp8);
+	janus_streaming_relay_to_viewer(session, TRUE, data, len);
+}
+
+/* Sends the cached packets that precede the live one, so the viewer decodes a keyframe
+ * right away instead of waiting for the next one. They are numbered to end right before
+ * the live packet, whatever gaps the source left in the cache, and go through the
+ * viewer's temporal layer filter like the live ones; timestamps of the older frames are
+ * squeezed to just before the live one so the jitter buffer renders them immediately.
+ * Being sent with other numbers and timestamps than in the NACK history, they are not
+ * retransmitted */
+static void janus_streaming_burst_gop(janus_streaming_session *session, janus_streaming_rtp_relay_packet *live)
+{
+	janus_streaming_mountpoint *mountpoint = session->mountpoint;
+	if (!mountpoint || !mountpoint->gop)
+		return;
+
+	GPtrArray *snapshot = gop_cache_snapshot(mountpoint->gop, live->seq_number);
+	if (!snapshot)
+		return;
+
+	/* Frames before the live one, the packets sharing its timestamp are left alone */
+	guint frames = 0;
+	guint32 last_ts = live->timestamp;
+	for (guint i = 0; i < snapshot->len; i++) {
+		packet_buffer *buffer = g_ptr_array_index(snapshot, i);
+		guint32 ts = ntohl(((rtp_header *)buffer->data)->timestamp);
+		if (ts != live->timestamp && (!frames || ts != last_ts)) {
+			frames++;
+			last_ts = ts;
+		}
+	}
+
+	gchar data[PACKET_POOL_BUFFER_SIZE];
+	guint frame = 0;
+	last_ts = live->timestamp;
+	for (guint i = 0; i < snapshot->len; i++) {
+		packet_buffer *buffer = g_ptr_array_index(snapshot, i);
+		rtp_header *rtp = (rtp_header *)data;
+		memcpy(data, buffer->data, buffer->length);
+		rtp->seq_number = htons((guint16)(live->seq_number - snapshot->len + i));
+		guint32 ts = ntohl(rtp->timestamp);
+		if (ts != live->timestamp) {
+			if (!frame || ts != last_ts) {
+				frame++;
+				last_ts = ts;
+			}
+			rtp->timestamp = htonl(live->timestamp - (frames - frame + 1) * GOP_CACHE_SQUEEZE_TICKS);
+		}
+		temporal_layers_vp8_info vp8;
+		gboolean is_vp8 = FALSE;
+		if (mountpoint->video_codec == GOP_CACHE_CODEC_VP8) {
+			int plen = 0;
+			char *payload = janus_rtp_payload(data, buffer->length, &plen);
+			is_vp8 = payload && temporal_layers_parse_vp8((const guint8 *)payload, plen, &vp8);
+		}
+		janus_streaming_relay_video_packet(session, data, buffer->length, is_vp8 ? &vp8 : NULL, -1);
+	}
+
+	JANUS_LOG(LOG_VERB, "Burst %u cached packets (%u frames) to a new viewer of %s\n", snapshot->len, frames, mountpoint->id);
+	g_ptr_array_free(snapshot, TRUE);
+}
+
 gboolean janus_streaming_send_rtp_src_received(GSocket *socket, GIOCondition condition, janus_streaming_socket_cbk_data * data)
 {
-	char buf[1500];
+	packet_buffer *buffer;
 	gssize len;
 
 	janus_streaming_mountpoint * mountpoint = (janus_streaming_mountpoint*)data->session;
@@ -1877,35 +3591,616 @@ gboolean janus_streaming_send_rtp_src_received(GSocket *socket, GIOCondition con
 		return TRUE;
 	}
 
-	len = g_socket_receive(socket, (gchar*)buf, sizeof(buf), NULL, NULL);
+	int stream_type = data->is_video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO;
+	socket_utils_batch *batch = &mountpoint->rtp_batch[stream_type];
+
+	if (batch->size > 1) {
+		/* Drain whatever the burst left in the socket with a single syscall */
+		gint count = socket_utils_receive_batch(&mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTP_SRV], batch);
+		if (count > 0) {
+			mountpoint->rtp_wakeups[stream_type]++;
+			for (gint i = 0; i < count; i++) {
+				janus_streaming_relay_source_packet(mountpoint, data->is_video, socket_utils_batch_packet(batch, i));
+			}
+			socket_utils_batch_recycle(batch, count);
+		}
+		return TRUE;
+	}
+
+	buffer = packet_pool_acquire();
+	len = socket_utils_receive(&mountpoint->socket[stream_type][JANUS_STREAMING_SOCKET_RTP_SRV], buffer->data, sizeof(buffer->data));
 
 	if (len > 0) {
-		JANUS_LOG(LOG_HUGE, "%s RTP sent; len=%ld\n", data->is_video ? "Video" : "Audio", len);
-	    janus_streaming_rtp_relay_packet packet;
-		rtp_header *rtp = (rtp_header *)buf;
+		STREAMING_TRACE(LOG_HUGE, "%s RTP sent; len=%ld\n", data->is_video ? "Video" : "Audio", len);
+		buffer->length = len;
+		janus_streaming_incoming_source_packet(mountpoint, data->is_video, buffer);
+	}
+	packet_buffer_unref(buffer);
 
-		packet.data = rtp;
-		packet.length = len;
-		packet.is_video = data->is_video;
+	return TRUE;
+}
 
-		int stream_type = packet.is_video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO;
+/* Sends a packet of a rendition to the viewers on it; a viewer moves to its target rendition
+ * on that rendition's next keyframe, its SSRC, sequence numbers and timestamps kept continuous */
+static void janus_streaming_relay_rendition_packet(janus_streaming_mountpoint * mountpoint, janus_streaming_rendition * rendition, packet_buffer * buffer)
+{
+	if (buffer->length < RTP_HEADER_SIZE) {
+		return;
+	}
 
-		packet.timestamp = ntohl(packet.data->timestamp);
-		packet.seq_number = ntohs(packet.data->seq_number);
+	gboolean keyframe = gop_cache_is_keyframe_start(GOP_CACHE_CODEC_VP8, buffer);
+	gint64 now = janus_get_monotonic_time();
+
+	rendition->packets++;
+	rendition->bytes += buffer->length;
+	if (keyframe)
+		rendition->keyframes++;
+	if (mountpoint->active == FALSE)
+		mountpoint->active = TRUE;
+	mountpoint->source_last_packet = now;
+	if (G_UNLIKELY(mountpoint->source_lost))
+		janus_streaming_source_reconnected(mountpoint, now);
+
+	janus_streaming_listeners *listeners = janus_streaming_listeners_get(mountpoint);
+	if (!listeners)
+		return;
 
-		mountpoint->ssrc[stream_type] = ntohl(packet.data->ssrc);
+	for (guint i = 0; i < listeners->count; i++) {
+		janus_streaming_session *session = (janus_streaming_session *)listeners->sessions[i];
+		if (!session || !session->handle || !session->started || session->paused)
+			continue;
+		gint target = g_atomic_int_get(&session->rendition_target);
+		if (session->rendition != target && (gint)rendition->index == target && keyframe) {
+			if (session->rendition >= 0)
+				session->rendition_switches++;
+			session->rendition = target;
+		}
+		if (session->rendition != (gint)rendition->index)
+			continue;
+		gchar data[PACKET_POOL_BUFFER_SIZE];
+		memcpy(data, buffer->data, buffer->length);
+		/* A rebuilt pipeline restarts the numbering of every rendition */
+		ladder_rewrite_packet(&session->ladder, (rtp_header *)data,
+			(gint)(rendition->index + g_atomic_int_get(&mountpoint->source_generation) * mountpoint->ladder_size), now);
+		janus_streaming_relay_to_viewer(session, TRUE, data, buffer->length);
+	}
+	janus_streaming_listeners_unref(listeners);
+}
 
-		if(mountpoint->active == FALSE)
-			mountpoint->active = TRUE;
+static gboolean janus_streaming_rendition_rtp_received(GSocket *socket, GIOCondition condition, janus_streaming_socket_cbk_data * data)
+{
+	janus_streaming_mountpoint * mountpoint = (janus_streaming_mountpoint*)data->session;
+	janus_streaming_rendition * rendition = data->rendition;
 
-		janus_mutex_lock(&mountpoint->mutex);
-		g_list_foreach(mountpoint->listeners, janus_streaming_relay_rtp_packet, &packet);
-		janus_mutex_unlock(&mountpoint->mutex);
+	if (g_atomic_int_get(&stopping) || mountpoint->destroyed) {
+		return TRUE;
+	}
+
+	packet_buffer *buffer = packet_pool_acquire();
+	gssize len = socket_utils_receive(&rendition->socket, buffer->data, sizeof(buffer->data));
+	if (len > 0) {
+		buffer->length = len;
+		janus_streaming_relay_rendition_packet(mountpoint, rendition, buffer);
+	}
+	packet_buffer_unref(buffer);
+
+	return TRUE;
+}
+
+/* Drains the shared memory ring of a stream when the producer signals its eventfd */
+static gboolean janus_streaming_rtp_ring_ready(gint fd, GIOCondition condition, gpointer user_data)
+{
+	janus_streaming_socket_cbk_data * data = (janus_streaming_socket_cbk_data *)user_data;
+	janus_streaming_mountpoint * mountpoint = (janus_streaming_mountpoint*)data->session;
+	int stream_type = data->is_video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO;
+	shm_ring *ring = mountpoint->rtp_ring[stream_type];
+
+	shm_ring_ack_wakeup(ring);
+
+	if (g_atomic_int_get(&stopping) || mountpoint->destroyed) {
+		return TRUE;
+	}
+
+	mountpoint->rtp_wakeups[stream_type]++;
+
+	/* At most one ring's worth per dispatch, so other mountpoints on this thread get their turn */
+	for (guint i = 0; i < ring->slots; i++) {
+		packet_buffer *buffer = packet_pool_acquire();
+		gssize len = shm_ring_pop(ring, buffer->data, sizeof(buffer->data), NULL);
+		if (len < 0) {
+			packet_buffer_unref(buffer);
+			break;
+		}
+		buffer->length = len;
+		janus_streaming_relay_source_packet(mountpoint, data->is_video, buffer);
+		packet_buffer_unref(buffer);
+	}
+
+	if (!shm_ring_prepare_wait(ring)) {
+		shm_ring_kick(ring);
 	}
 
 	return TRUE;
 }
 
+/* Fan a single RTP packet coming out of the pipeline out to all listeners of the mountpoint,
+ * called straight from the appsink streaming thread */
+void janus_streaming_incoming_source_rtp(janus_streaming_mountpoint * mountpoint, gboolean is_video, char * buf, gssize len)
+{
+	packet_buffer *buffer;
+
+	if (len <= 0 || len > PACKET_POOL_BUFFER_SIZE) {
+		return;
+	}
+
+	buffer = packet_pool_acquire();
+	memcpy(buffer->data, buf, len);
+	buffer->length = len;
+	janus_streaming_incoming_source_packet(mountpoint, is_video, buffer);
+	packet_buffer_unref(buffer);
+}
+
+static void janus_streaming_incoming_source_packet(janus_streaming_mountpoint * mountpoint, gboolean is_video, packet_buffer * buffer)
+{
+	if (g_atomic_int_get(&stopping) || mountpoint->destroyed) {
+		return;
+	}
+
+	mountpoint->rtp_wakeups[is_video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO]++;
+
+	janus_streaming_relay_source_packet(mountpoint, is_video, buffer);
+}
+
+/* Clock rate of an rtpmap such as "opus/48000/2", 90 kHz when it has none */
+static guint32 janus_streaming_clock_rate(const gchar * rtpmap)
+{
+	const gchar *rate = rtpmap ? strchr(rtpmap, '/') : NULL;
+	guint64 value = rate ? g_ascii_strtoull(rate + 1, NULL, 10) : 0;
+
+	return value ? (guint32)value : 90000;
+}
+
+/* First packet since the source was lost, once its pipeline was built again; on the relay path */
+static void janus_streaming_source_reconnected(janus_streaming_mountpoint * mountpoint, gint64 now)
+{
+	if (g_atomic_int_get(&mountpoint->source_generation) == mountpoint->lost_generation)
+		return;	/* Still from the pipeline that was lost */
+
+	gint64 elapsed = (now - mountpoint->source_lost) / 1000;
+	if (mountpoint->failing_over) {
+		mountpoint->failovers++;
+		mountpoint->failover_time_last = elapsed;
+		mountpoint->failover_time_max = MAX(mountpoint->failover_time_max, elapsed);
+		mountpoint->failing_over = FALSE;
+		JANUS_LOG(LOG_INFO, "Source of %s failed over, %"SCNi64" ms without packets\n", mountpoint->id, elapsed);
+	} else {
+		mountpoint->reconnects++;
+		mountpoint->reconnect_time_last = elapsed;
+		mountpoint->reconnect_time_total += elapsed;
+		mountpoint->reconnect_time_max = MAX(mountpoint->reconnect_time_max, elapsed);
+		JANUS_LOG(LOG_INFO, "Source of %s reconnected after %"SCNi64" ms\n", mountpoint->id, elapsed);
+	}
+	mountpoint->source_lost = 0;
+	g_atomic_int_set(&mountpoint->reconnect_attempt, 0);
+}
+
+/* Lock-free: walks the listeners snapshot published by janus_streaming_publish_listeners().
+ * Whoever needs the packet past this call takes a reference on the buffer */
+static void janus_streaming_relay_source_packet(janus_streaming_mountpoint * mountpoint, gboolean is_video, packet_buffer * buffer)
+{
+	gssize len = buffer->length;
+
+	if (len < RTP_HEADER_SIZE) {
+		return;
+	}
+
+	janus_streaming_rtp_relay_packet packet;
+	rtp_header *rtp = (rtp_header *)buffer->data;
+
+	packet.data = rtp;
+	packet.length = len;
+	packet.is_video = is_video;
+	packet.is_vp8 = FALSE;
+
+	int stream_type = packet.is_video ? JANUS_STREAMING_STREAM_VIDEO : JANUS_STREAMING_STREAM_AUDIO;
+
+	/* The source's own SSRC, for the RTCP sent back to it */
+	mountpoint->ssrc[stream_type] = ntohl(packet.data->ssrc);
+	gint64 now = janus_get_monotonic_time();
+	mountpoint->source_last_packet = now;
+
+	if (G_UNLIKELY(mountpoint->source_lost))
+		janus_streaming_source_reconnected(mountpoint, now);
+	if (source_reconnect || mountpoint->has_backup) {
+		/* Viewers keep one SSRC and continuous numbering across reconnections of the source */
+		ladder_rewrite *rewrite = &mountpoint->source_rewrite[stream_type];
+		if (!rewrite->initialized)
+			rewrite->clock_rate = packet.is_video ? 90000 : janus_streaming_clock_rate(mountpoint->codecs.audio_rtpmap);
+		ladder_rewrite_packet(rewrite, rtp, g_atomic_int_get(&mountpoint->source_generation), now);
+	}
+
+	packet.timestamp = ntohl(packet.data->timestamp);
+	packet.seq_number = ntohs(packet.data->seq_number);
+
+	if (!mountpoint->rtp_packets[stream_type])
+		mountpoint->rtp_first_packet[stream_type] = janus_get_monotonic_time();
+	mountpoint->rtp_packets[stream_type]++;
+	mountpoint->rtp_bytes[stream_type] += len;
+
+	if(mountpoint->active == FALSE)
+		mountpoint->active = TRUE;
+
+	if (packet.is_video) {
+		if (mountpoint->video_codec == GOP_CACHE_CODEC_UNKNOWN)
+			mountpoint->video_codec = gop_cache_codec_from_rtpmap(mountpoint->codecs.video_rtpmap);
+		gboolean keyframe = gop_cache_is_keyframe_start(mountpoint->video_codec, buffer);
+		if (mountpoint->video_codec == GOP_CACHE_CODEC_VP8) {
+			int plen = 0;
+			char *payload = janus_rtp_payload(buffer->data, buffer->length, &plen);
+			packet.is_vp8 = payload && temporal_layers_parse_vp8((const guint8 *)payload, plen, &packet.vp8);
+			if (packet.is_vp8 && packet.vp8.has_tid && packet.vp8.tid >= mountpoint->temporal_layers)
+				mountpoint->temporal_layers = packet.vp8.tid + 1;
+		}
+		if (mountpoint->gop)
+			gop_cache_push(mountpoint->gop, buffer, keyframe);
+		if (mountpoint->nack)
+			nack_history_store(mountpoint->nack, buffer, packet.seq_number, now);
+		if (keyframe)
+			keyframe_requests_keyframe(mountpoint->keyframe_requests);
+		else
+			janus_streaming_flush_keyframe_requests(mountpoint);
+	}
+
+	janus_streaming_listeners *listeners = janus_streaming_listeners_get(mountpoint);
+	if (!listeners)
+		return;
+
+	gboolean parallel = fanout && listeners->shards > 1 && listeners->count >= fanout_threshold;
+	janus_streaming_listeners *last = mountpoint->fanout_last[stream_type];
+	if (!parallel && last) {
+		/* Back under the threshold: the workers may still be sending earlier packets, relaying
+		 * here meanwhile would reorder them. A session always has the same worker, whose queue
+		 * is in order, so they are all sent once the last snapshot handed out is done */
+		if (g_atomic_int_get(&last->tasks)) {
+			parallel = listeners->shards > 1;
+		} else {
+			janus_streaming_listeners_unref(last);
+			mountpoint->fanout_last[stream_type] = NULL;
+		}
+	}
+
+	if (parallel) {
+		/* Large audience: hand each shard a reference to the packet buffer */
+		if (mountpoint->fanout_last[stream_type] != listeners) {
+			janus_streaming_listeners_unref(mountpoint->fanout_last[stream_type]);
+			g_atomic_int_inc(&listeners->ref);
+			mountpoint->fanout_last[stream_type] = listeners;
+		}
+		for (guint shard = 0; shard < listeners->shards; shard++) {
+			if (listeners->shard_start[shard] == listeners->shard_start[shard + 1])
+				continue;
+			janus_streaming_fanout_task *task = g_slice_new(janus_streaming_fanout_task);
+			g_atomic_int_inc(&listeners->ref);
+			g_atomic_int_inc(&listeners->tasks);
+			task->listeners = listeners;
+			task->start = listeners->shard_start[shard];
+			task->end = listeners->shard_start[shard + 1];
+			task->buffer = packet_buffer_ref(buffer);
+			task->packet = packet;
+			fanout_pool_push(fanout, shard, task);
+		}
+		mountpoint->fanout_parallel_packets++;
+		janus_streaming_listeners_unref(listeners);
+		return;
+	}
+
+	for (guint i = 0; i < listeners->count; i++) {
+		janus_streaming_relay_rtp_packet(listeners->sessions[i], &packet);
+	}
+	janus_streaming_listeners_unref(listeners);
+}
+
+static void janus_streaming_fanout_task_run(gpointer data)
+{
+	janus_streaming_fanout_task *task = (janus_streaming_fanout_task *)data;
+
+	for (guint i = task->start; i < task->end; i++) {
+		janus_streaming_relay_rtp_packet(task->listeners->sessions[i], &task->packet);
+	}
+
+	packet_buffer_unref(task->buffer);
+	g_atomic_int_add(&task->listeners->tasks, -1);
+	janus_streaming_listeners_unref(task->listeners);
+	g_slice_free(janus_streaming_fanout_task, task);
+}
+
+/* Rebuilds the listeners snapshot after mp->listeners changed, must be called with mp->mutex held */
+static void janus_streaming_publish_listeners(janus_streaming_mountpoint *mp)
+{
+	guint count = g_list_length(mp->listeners);
+	guint shards = fanout ? fanout->size : 1;
+	janus_streaming_listeners *listeners = NULL;
+
+	if (count > 0) {
+		/* The shard offsets live in the same allocation, right after the sessions */
+		listeners = g_malloc0(sizeof(janus_streaming_listeners) + count * sizeof(gpointer) + (shards + 1) * sizeof(guint));
+		listeners->ref = 1;
+		listeners->count = count;
+		listeners->shards = shards;
+		listeners->shard_start = (guint *)&listeners->sessions[count];
+		/* Counting sort of the sessions by shard */
+		for (GList *l = mp->listeners; l; l = l->next) {
+			janus_streaming_session *session = (janus_streaming_session *)l->data;
+			listeners->shard_start[session->fanout_shard % shards + 1]++;
+		}
+		for (guint shard = 0; shard < shards; shard++) {
+			listeners->shard_start[shard + 1] += listeners->shard_start[shard];
+		}
+		guint *next = g_new(guint, shards);
+		memcpy(next, listeners->shard_start, shards * sizeof(guint));
+		for (GList *l = mp->listeners; l; l = l->next) {
+			janus_streaming_session *session = (janus_streaming_session *)l->data;
+			listeners->sessions[next[session->fanout_shard % shards]++] = session;
+		}
+		g_free(next);
+	}
+
+	janus_streaming_listeners *old = g_atomic_pointer_get(&mp->listeners_snapshot);
+	g_atomic_pointer_set(&mp->listeners_snapshot, listeners);
+	if (old) {
+		/* A relay thread that loaded the old snapshot holds its reference once no reader is
+		 * left, later ones load the new one; readers only span a load and an increment */
+		while (g_atomic_int_get(&mp->listeners_readers))
+			g_thread_yield();
+	}
+	/* Freed here, or by the last relay or fanout task still walking it */
+	janus_streaming_listeners_unref(old);
+}
+
+/* Reference on the published snapshot, NULL without listeners. Takes no lock: the readers
+ * count keeps janus_streaming_publish_listeners() from freeing the snapshot between the
+ * load and the increment */
+static janus_streaming_listeners *janus_streaming_listeners_get(janus_streaming_mountpoint *mp)
+{
+	g_atomic_int_inc(&mp->listeners_readers);
+	janus_streaming_listeners *listeners = g_atomic_pointer_get(&mp->listeners_snapshot);
+	if (listeners)
+		g_atomic_int_inc(&listeners->ref);
+	g_atomic_int_add(&mp->listeners_readers, -1);
+	return listeners;
+}
+
+static void janus_streaming_listeners_unref(janus_streaming_listeners *listeners)
+{
+	if (listeners && g_atomic_int_dec_and_test(&listeners->ref))
+		g_free(listeners);
+}
+
+static gint janus_streaming_parse_ingest(const char *value)
+{
+	if (!value || !strcasecmp(value, "udp"))
+		return JANUS_STREAMING_INGEST_UDP;
+	if (!strcasecmp(value, "appsink"))
+		return JANUS_STREAMING_INGEST_APPSINK;
+	if (!strcasecmp(value, "unix"))
+		return JANUS_STREAMING_INGEST_UNIX;
+	if (!strcasecmp(value, "shm"))
+		return JANUS_STREAMING_INGEST_SHM;
+	return -1;
+}
+
+static const char *janus_streaming_ingest_str(gint ingest)
+{
+	switch (ingest) {
+		case JANUS_STREAMING_INGEST_APPSINK:
+			return "appsink";
+		case JANUS_STREAMING_INGEST_UNIX:
+			return "unix";
+		case JANUS_STREAMING_INGEST_SHM:
+			return "shm";
+		case JANUS_STREAMING_INGEST_UDP:
+		default:
+			return "udp";
+	}
+}
+
+/* Per-mountpoint counters returned by the 'info' request */
+static json_t *janus_streaming_mountpoint_stats(janus_streaming_mountpoint *mp)
+{
+	json_t *stats = json_object();
+	gint64 now = janus_get_monotonic_time();
+
+	json_object_set_new(stats, "ingest", json_string(janus_streaming_ingest_str(mp->ingest)));
+	if (mp->relay_thread)
+		json_object_set_new(stats, "relay_thread", json_integer(mp->relay_thread->index));
+	janus_mutex_lock(&pipelines_mutex);
+	janus_streaming_pipeline *pipeline = g_hash_table_lookup(pipelines, mp->id);
+	if (pipeline)
+		json_object_set_new(stats, "pipeline_thread", json_integer(pipeline->thread->index));
+	if (pipeline && mp->has_backup) {
+		json_t *standby = json_object();
+		json_object_set_new(standby, "uri", json_string(pipeline->standby_uri));
+		json_object_set_new(standby, "ready", pipeline->standby && now - mp->standby_last_packet <= (gint64)failover_gap * 1000 ? json_true() : json_false());
+		json_object_set_new(standby, "dropped_packets", json_integer(mp->standby_packets));
+		json_object_set_new(standby, "dropped_bytes", json_integer(mp->standby_bytes));
+		json_object_set_new(standby, "failovers", json_integer(mp->failovers));
+		json_object_set_new(standby, "last_failover_ms", json_integer(mp->failover_time_last));
+		json_object_set_new(standby, "max_failover_ms", json_integer(mp->failover_time_max));
+		json_object_set_new(stats, "standby", standby);
+	}
+	janus_mutex_unlock(&pipelines_mutex);
+	janus_streaming_listeners *listeners = janus_streaming_listeners_get(mp);
+	json_object_set_new(stats, "listeners", json_integer(listeners ? listeners->count : 0));
+	if (mp->preloaded)
+		json_object_set_new(stats, "preloaded", json_true());
+	if (mp->aliases) {
+		/* Ids sharing this mountpoint's source, called with mountpoints_mutex held */
+		json_t *aliases = json_array();
+		for (GList *l = mp->aliases; l; l = l->next)
+			json_array_append_new(aliases, json_string((const gchar *)l->data));
+		json_object_set_new(stats, "aliases", aliases);
+	}
+	if (mp->linger_until)
+		json_object_set_new(stats, "linger_remaining_ms", json_integer(MAX(mp->linger_until - now, 0) / 1000));
+	if (source_reconnect) {
+		json_t *reconnect = json_object();
+		gint64 lost = mp->source_lost;
+		if (lost) {
+			json_object_set_new(reconnect, "lost_for_ms", json_integer((now - lost) / 1000));
+			json_object_set_new(reconnect, "attempt", json_integer(g_atomic_int_get(&mp->reconnect_attempt)));
+		}
+		json_object_set_new(reconnect, "reconnects", json_integer(mp->reconnects));
+		json_object_set_new(reconnect, "last_ms", json_integer(mp->reconnect_time_last));
+		json_object_set_new(reconnect, "max_ms", json_integer(mp->reconnect_time_max));
+		json_object_set_new(reconnect, "total_ms", json_integer(mp->reconnect_time_total));
+		json_object_set_new(stats, "reconnect", reconnect);
+	}
+	json_object_set_new(stats, "fanout_parallel_packets", json_integer(mp->fanout_parallel_packets));
+	json_t *kr = json_object();
+	janus_mutex_lock(&mp->keyframe_requests->mutex);
+	json_object_set_new(kr, "requested", json_integer(mp->keyframe_requests->requested));
+	json_object_set_new(kr, "forwarded", json_integer(mp->keyframe_requests->forwarded));
+	json_object_set_new(kr, "coalesced", json_integer(mp->keyframe_requests->coalesced));
+	json_object_set_new(kr, "suppressed", json_integer(mp->keyframe_requests->suppressed));
+	janus_mutex_unlock(&mp->keyframe_requests->mutex);
+	json_object_set_new(stats, "keyframe_requests", kr);
+	if (mp->temporal_layers > 1) {
+		json_t *tl = json_object();
+		guint64 dropped = 0;
+		guint viewers[TEMPORAL_LAYERS_MAX] = { 0 };
+		for (guint j = 0; listeners && j < listeners->count; j++) {
+			janus_streaming_session *session = (janus_streaming_session *)listeners->sessions[j];
+			if (!session)
+				continue;
+			janus_mutex_lock(&session->temporal_mutex);
+			dropped += session->temporal.dropped;
+			viewers[MIN(session->temporal.max_layer, mp->temporal_layers - 1)]++;
+			janus_mutex_unlock(&session->temporal_mutex);
+		}
+		json_t *per_layer = json_array();
+		for (gint layer = 0; layer < mp->temporal_layers; layer++)
+			json_array_append_new(per_layer, json_integer(viewers[layer]));
+		json_object_set_new(tl, "layers", json_integer(mp->temporal_layers));
+		json_object_set_new(tl, "video_bitrate", json_integer(mp->video_bitrate));
+		json_object_set_new(tl, "viewers_per_layer", per_layer);
+		json_object_set_new(tl, "dropped_packets", json_integer(dropped));
+		json_object_set_new(stats, "temporal_layers", tl);
+	}
+	if (mp->ladder_size) {
+		json_t *ladder = json_array();
+		for (guint i = 0; i < mp->ladder_size; i++) {
+			janus_streaming_rendition *rendition = &mp->renditions[i];
+			json_t *rj = json_object();
+			guint viewers = 0;
+			for (guint j = 0; listeners && j < listeners->count; j++) {
+				janus_streaming_session *session = (janus_streaming_session *)listeners->sessions[j];
+				if (session && session->rendition == (gint)i)
+					viewers++;
+			}
+			json_object_set_new(rj, "width", json_integer(rendition->spec.width));
+			json_object_set_new(rj, "height", json_integer(rendition->spec.height));
+			json_object_set_new(rj, "bitrate", json_integer(rendition->spec.bitrate));
+			json_object_set_new(rj, "ssrc", json_integer(rendition->ssrc));
+			json_object_set_new(rj, "packets", json_integer(rendition->packets));
+			json_object_set_new(rj, "bytes", json_integer(rendition->bytes));
+			json_object_set_new(rj, "keyframes", json_integer(rendition->keyframes));
+			json_object_set_new(rj, "viewers", json_integer(viewers));
+			json_array_append_new(ladder, rj);
+		}
+		json_object_set_new(stats, "ladder", ladder);
+	}
+	json_t *rs = json_object();
+	janus_mutex_lock(&mp->remb->mutex);
+	json_object_set_new(rs, "aggregate", json_integer(mp->remb->bitrate));
+	json_object_set_new(rs, "viewers", json_integer(g_hash_table_size(mp->remb->estimates)));
+	json_object_set_new(rs, "received", json_integer(mp->remb->received));
+	json_object_set_new(rs, "applied", json_integer(mp->remb->applied));
+	janus_mutex_unlock(&mp->remb->mutex);
+	json_object_set_new(stats, "remb", rs);
+	if (mp->nack) {
+		json_t *ns = json_object();
+		guint64 video_packets = mp->rtp_packets[JANUS_STREAMING_STREAM_VIDEO];
+		janus_mutex_lock(&mp->nack->mutex);
+		json_object_set_new(ns, "nacks", json_integer(mp->nack->nacks));
+		json_object_set_new(ns, "requested", json_integer(mp->nack->requested));
+		json_object_set_new(ns, "retransmitted", json_integer(mp->nack->retransmitted));
+		json_object_set_new(ns, "missed", json_integer(mp->nack->missed));
+		json_object_set_new(ns, "retransmission_rate", json_real(video_packets ? (double)mp->nack->retransmitted / video_packets : 0.0));
+		json_object_set_new(ns, "keyframe_requests_avoided", json_integer(mp->nack->recovered));
+		janus_mutex_unlock(&mp->nack->mutex);
+		json_object_set_new(stats, "nack", ns);
+	}
+	if (mp->gop) {
+		json_t *gs = json_object();
+		janus_mutex_lock(&mp->gop->mutex);
+		json_object_set_new(gs, "packets", json_integer(mp->gop->packets->len));
+		json_object_set_new(gs, "valid", mp->gop->valid ? json_true() : json_false());
+		json_object_set_new(gs, "keyframes", json_integer(mp->gop->keyframes));
+		json_object_set_new(gs, "overflows", json_integer(mp->gop->overflows));
+		json_object_set_new(gs, "bursts", json_integer(mp->gop->bursts));
+		janus_mutex_unlock(&mp->gop->mutex);
+		json_object_set_new(stats, "gop_cache", gs);
+	}
+	if (viewer_pacer) {
+		/* Queue delays of all the viewers, the latency that pacing adds */
+		json_t *ps = json_object();
+		guint64 delays[PACER_DELAY_BUCKETS] = { 0 };
+		guint64 sent = 0, delayed = 0, queued = 0;
+		for (guint i = 0; listeners && i < listeners->count; i++) {
+			janus_streaming_session *session = (janus_streaming_session *)listeners->sessions[i];
+			if (!session || !session->pacing)
+				continue;
+			janus_mutex_lock(&session->pacing->mutex);
+			pacer_delays_add(delays, session->pacing);
+			sent += session->pacing->sent;
+			delayed += session->pacing->delayed;
+			queued += session->pacing->queued_bytes;
+			janus_mutex_unlock(&session->pacing->mutex);
+		}
+		json_object_set_new(ps, "sent", json_integer(sent));
+		json_object_set_new(ps, "delayed", json_integer(delayed));
+		json_object_set_new(ps, "queued_bytes", json_integer(queued));
+		json_object_set_new(ps, "delay_p50_us", json_integer(pacer_delays_percentile(delays, 50)));
+		json_object_set_new(ps, "delay_p90_us", json_integer(pacer_delays_percentile(delays, 90)));
+		json_object_set_new(ps, "delay_p99_us", json_integer(pacer_delays_percentile(delays, 99)));
+		json_object_set_new(stats, "pacing", ps);
+	}
+	json_object_set_new(stats, "rtp_batch_size", json_integer(mp->rtp_batch[JANUS_STREAMING_STREAM_VIDEO].size ? mp->rtp_batch[JANUS_STREAMING_STREAM_VIDEO].size : 1));
+	for (int stream = 0; stream < JANUS_STREAMING_STREAM_MAX; stream++) {
+		json_t *st = json_object();
+		guint64 packets = mp->rtp_packets[stream];
+		gint64 elapsed = packets ? now - mp->rtp_first_packet[stream] : 0;
+		json_object_set_new(st, "packets", json_integer(packets));
+		json_object_set_new(st, "bytes", json_integer(mp->rtp_bytes[stream]));
+		json_object_set_new(st, "packets_per_second", json_integer(elapsed > 0 ? packets * G_USEC_PER_SEC / elapsed : 0));
+		json_object_set_new(st, "packets_per_wakeup", json_real(mp->rtp_wakeups[stream] ? (double)packets / mp->rtp_wakeups[stream] : 0.0));
+		socket_utils_socket *rtp_socket = &mp->socket[stream][JANUS_STREAMING_SOCKET_RTP_SRV];
+		if (rtp_socket->socket) {
+			/* With a socket pair the pipeline end counts what did not fit */
+			guint64 drops = rtp_socket->drops + mp->socket[stream][JANUS_STREAMING_SOCKET_RTP_CLI].drops;
+			json_object_set_new(st, "kernel_drops", json_integer(drops));
+			json_object_set_new(st, "rcvbuf", json_integer(rtp_socket->rcvbuf));
+			json_object_set_new(st, "rcvbuf_grows", json_integer(rtp_socket->rcvbuf_grows));
+		}
+		shm_ring *ring = mp->rtp_ring[stream];
+		if (ring) {
+			json_t *rs = json_object();
+			json_object_set_new(rs, "slots", json_integer(ring->slots));
+			json_object_set_new(rs, "overrun", json_string(shm_ring_overrun_str(ring->header->overrun)));
+			json_object_set_new(rs, "pushed", json_integer(ring->header->pushed));
+			json_object_set_new(rs, "popped", json_integer(ring->popped));
+			json_object_set_new(rs, "dropped_newest", json_integer(ring->header->dropped_newest));
+			json_object_set_new(rs, "dropped_oldest", json_integer(ring->dropped_oldest));
+			json_object_set_new(rs, "corrupt", json_integer(ring->corrupt));
+			json_object_set_new(rs, "wakeups", json_integer(ring->wakeups));
+			json_object_set_new(st, "shm_ring", rs);
+		}
+		json_object_set_new(stats, stream == JANUS_STREAMING_STREAM_VIDEO ? "video" : "audio", st);
+	}
+
+	janus_streaming_listeners_unref(listeners);
+	return stats;
+}
 
 static void janus_streaming_parse_ports_range(janus_config_item *ports_range, uint16_t *min_port, uint16_t * max_port)
 {
@@ -1934,13 +4229,138 @@ static void janus_streaming_parse_ports_range(janus_config_item *ports_range, ui
 	}
 }
 
+/* Plugin-wide counters returned by the 'stats' request */
+static json_t *janus_streaming_plugin_stats(void)
+{
+	json_t *stats = json_object();
+
+	json_t *threads = json_array();
+	for (guint i = 0; relay_pool && i < relay_pool->size; i++) {
+		context_pool_thread *thread = &relay_pool->threads[i];
+		json_t *th = json_object();
+		json_object_set_new(th, "index", json_integer(thread->index));
+		json_object_set_new(th, "mountpoints", json_integer(g_atomic_int_get(&thread->assigned)));
+		json_object_set_new(th, "wakeups", json_integer(thread->wakeups));
+		json_object_set_new(th, "load", json_real(context_pool_thread_load(thread)));
+		json_array_append_new(threads, th);
+	}
+	json_object_set_new(stats, "relay_threads", threads);
+
+	json_t *pthreads = json_array();
+	for (guint i = 0; pipeline_pool && i < pipeline_pool->size; i++) {
+		context_pool_thread *thread = &pipeline_pool->threads[i];
+		json_t *th = json_object();
+		json_object_set_new(th, "index", json_integer(thread->index));
+		json_object_set_new(th, "pipelines", json_integer(g_atomic_int_get(&thread->assigned)));
+		json_object_set_new(th, "wakeups", json_integer(thread->wakeups));
+		json_object_set_new(th, "load", json_real(context_pool_thread_load(thread)));
+		json_array_append_new(pthreads, th);
+	}
+	json_object_set_new(stats, "pipeline_threads", pthreads);
+
+	json_t *teardown = json_object();
+	json_t *histogram = json_array();
+	janus_mutex_lock(&reaper_mutex);
+	json_object_set_new(teardown, "timeout_ms", json_integer(teardown_timeout));
+	json_object_set_new(teardown, "pending", json_integer(g_list_length(reaping)));
+	json_object_set_new(teardown, "completed", json_integer(teardowns_completed));
+	json_object_set_new(teardown, "abandoned", json_integer(teardowns_abandoned));
+	json_object_set_new(teardown, "abandoned_stopped_later", json_integer(teardowns_late));
+	for (guint i = 0; i < JANUS_STREAMING_TEARDOWN_BUCKETS; i++) {
+		if (!teardown_latency[i])
+			continue;
+		json_t *bucket = json_object();
+		json_object_set_new(bucket, "below_ms", json_integer((gint64)1 << i));
+		json_object_set_new(bucket, "count", json_integer(teardown_latency[i]));
+		json_array_append_new(histogram, bucket);
+	}
+	janus_mutex_unlock(&reaper_mutex);
+	json_object_set_new(teardown, "latency", histogram);
+	json_object_set_new(stats, "teardown", teardown);
+	json_t *reconnect = json_object();
+	json_object_set_new(reconnect, "enabled", source_reconnect ? json_true() : json_false());
+	json_object_set_new(reconnect, "min_delay_ms", json_integer(reconnect_min_delay));
+	json_object_set_new(reconnect, "max_delay_ms", json_integer(reconnect_max_delay));
+	json_object_set_new(reconnect, "failover_gap_ms", json_integer(failover_gap));
+	json_object_set_new(stats, "reconnect", reconnect);
+	json_object_set_new(stats, "io_backend", json_string(socket_utils_backend_str(io_backend)));
+
+	json_t *workers = json_array();
+	for (guint i = 0; fanout && i < fanout->size; i++) {
+		fanout_pool_worker *worker = &fanout->workers[i];
+		json_t *wk = json_object();
+		json_object_set_new(wk, "index", json_integer(worker->index));
+		json_object_set_new(wk, "tasks", json_integer(worker->tasks));
+		json_object_set_new(wk, "queued", json_integer(g_async_queue_length(worker->queue)));
+		json_array_append_new(workers, wk);
+	}
+	json_object_set_new(stats, "fanout_threads", workers);
+	json_object_set_new(stats, "fanout_threshold", json_integer(fanout_threshold));
+	json_object_set_new(stats, "pacing_interval", json_integer(viewer_pacer ? pacing_interval : 0));
+	json_object_set_new(stats, "pacing_multiplier", json_real(pacing_multiplier));
+
+	json_t *linger = json_object();
+	janus_mutex_lock(&mountpoints_mutex);
+	json_object_set_new(linger, "linger_ms", json_integer(mountpoint_linger));
+	json_object_set_new(linger, "hits", json_integer(linger_hits));
+	json_object_set_new(linger, "misses", json_integer(linger_misses));
+	janus_mutex_unlock(&mountpoints_mutex);
+	json_object_set_new(stats, "mountpoint_linger", linger);
+
+	json_t *sharing = json_object();
+	janus_mutex_lock(&mountpoints_mutex);
+	json_object_set_new(sharing, "enabled", share_sources ? json_true() : json_false());
+	json_object_set_new(sharing, "sources", json_integer(g_hash_table_size(shared_sources)));
+	json_object_set_new(sharing, "ids", json_integer(g_hash_table_size(mountpoints)));
+	json_object_set_new(sharing, "attaches", json_integer(shared_attaches));
+	janus_mutex_unlock(&mountpoints_mutex);
+	json_object_set_new(stats, "shared_sources", sharing);
+
+	json_t *preloaded = json_array();
+	for (GList *l = preloads; l; l = l->next) {
+		janus_streaming_preload *preload = (janus_streaming_preload *)l->data;
+		gint state = g_atomic_int_get(&preload->state);
+		json_t *ps = json_object();
+		json_object_set_new(ps, "id", json_string(preload->id));
+		json_object_set_new(ps, "state", json_string(janus_streaming_preload_state_str(state)));
+		if (state == JANUS_STREAMING_PRELOAD_READY)
+			json_object_set_new(ps, "ready_ms", json_integer(preload->ready_time));
+		json_array_append_new(preloaded, ps);
+	}
+	json_object_set_new(stats, "preload", preloaded);
+
+	packet_pool_stats pps;
+	packet_pool_get_stats(&pps);
+	json_t *pool = json_object();
+	json_object_set_new(pool, "pools", json_integer(pps.pools));
+	json_object_set_new(pool, "size", json_integer(pps.size));
+	json_object_set_new(pool, "in_use", json_integer(pps.in_use));
+	json_object_set_new(pool, "high_watermark", json_integer(pps.high_watermark));
+	json_object_set_new(pool, "fallbacks", json_integer(pps.fallbacks));
+	json_object_set_new(stats, "packet_pool", pool);
+
+	return stats;
+}
+
 //todo: change as in source
-static gboolean janus_streaming_create_sockets(socket_utils_socket socket[JANUS_STREAMING_STREAM_MAX][JANUS_STREAMING_SOCKET_MAX]) {
+static gboolean janus_streaming_create_sockets(socket_utils_socket socket[JANUS_STREAMING_STREAM_MAX][JANUS_STREAMING_SOCKET_MAX], gint ingest) {
 	
 	gboolean result = TRUE;
 
 	for (int i = 0; i < JANUS_STREAMING_STREAM_MAX; i++)
 	{
+		if (ingest != JANUS_STREAMING_INGEST_UDP) {
+			/* No loopback: RTP (unix only) and RTCP towards the pipeline go over socket pairs, no ports needed */
+			if (ingest == JANUS_STREAMING_INGEST_UNIX &&
+				!socket_utils_create_socket_pair(&socket[i][JANUS_STREAMING_SOCKET_RTP_SRV], &socket[i][JANUS_STREAMING_SOCKET_RTP_CLI])) {
+				result = FALSE;
+			}
+			if (!socket_utils_create_socket_pair(&socket[i][JANUS_STREAMING_SOCKET_RTCP_RCV_CLI], &socket[i][JANUS_STREAMING_SOCKET_RTCP_RCV_SRV])) {
+				result = FALSE;
+			}
+			continue;
+		}
+
 		if (!socket_utils_create_server_socket(&socket[i][JANUS_STREAMING_SOCKET_RTP_SRV])) {
 			result = FALSE;
 		}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <glib.h>
+#include <gst/gst.h>
+#include "idilia_streaming_common.h"
 
 void janus_streaming_send_watch_request(gchar * id, gpointer handle);
 void janus_streaming_send_destroy_request(gchar * id, gpointer handle);
+void janus_streaming_source_lost(janus_streaming_mountpoint * mountpoint, GstElement * pipeline, gpointer handle);
+void janus_streaming_incoming_source_rtp(janus_streaming_mountpoint * mountpoint, gboolean is_video, char * buf, gssize len);
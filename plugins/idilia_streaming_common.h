@@ -2,6 +2,15 @@
 
 #include <gst/gst.h>
 #include "socket_utils.h"
+#include "context_pool.h"
+#include "shm_ring.h"
+#include "gop_cache.h"
+#include "keyframe_requests.h"
+#include "nack_history.h"
+#include "remb_aggregator.h"
+#include "ladder.h"
+#include "temporal_layers.h"
+#include "pacer.h"
 #include "../mutex.h"
 
 
@@ -18,15 +27,53 @@ enum
 	JANUS_STREAMING_SOCKET_RTCP_RCV_SRV,
 	JANUS_STREAMING_SOCKET_RTCP_RCV_CLI,
 	JANUS_STREAMING_SOCKET_RTCP_SND_SRV,
+	JANUS_STREAMING_SOCKET_RTP_CLI,		/* pipeline end of the RTP socket pair, unix ingest only */
 	JANUS_STREAMING_SOCKET_MAX
 };
+
+/* How RTP leaves the pipeline towards the relay */
+enum
+{
+	JANUS_STREAMING_INGEST_UDP = 0,		/* udpsink -> loopback -> RTP_SRV socket */
+	JANUS_STREAMING_INGEST_APPSINK,		/* appsink handing mapped buffers straight to the fanout */
+	JANUS_STREAMING_INGEST_UNIX,		/* appsink -> RTP_CLI -> socket pair -> RTP_SRV socket */
+	JANUS_STREAMING_INGEST_SHM,		/* appsink (or an external transcoder) -> shared memory ring -> eventfd */
+	JANUS_STREAMING_INGEST_MAX
+};
   
+struct janus_streaming_rendition;
+
 typedef struct socket_callback_data
 {
 	gpointer * session;
 	gboolean is_video;
+	struct janus_streaming_rendition *rendition;	/* NULL unless feeding a ladder rendition */
 } janus_streaming_socket_cbk_data;
 
+/* One encoding of a ladder mountpoint, fed to the relay over its own socket pair */
+typedef struct janus_streaming_rendition {
+	guint index;
+	ladder_rendition_spec spec;
+	guint32 ssrc;
+	socket_utils_socket socket;	/* relay end */
+	socket_utils_socket pipeline_socket;	/* written by the rendition's appsink */
+	janus_streaming_socket_cbk_data cbk_data;
+	/* only written by the thread feeding the rendition */
+	guint64 packets;
+	guint64 bytes;
+	guint64 keyframes;
+} janus_streaming_rendition;
+
+/* Immutable, contiguous copy of a mountpoint's listeners, read by the relay path without locking */
+typedef struct janus_streaming_listeners {
+	volatile gint ref;	/* Held by the mountpoint while published, by relays in progress and queued fanout tasks */
+	volatile gint tasks;	/* Fanout tasks queued on it and not done yet */
+	guint count;
+	guint shards;		/* sessions are grouped by fanout shard, */
+	guint *shard_start;	/* shard i covers [shard_start[i], shard_start[i+1]) */
+	gpointer sessions[];	/* janus_streaming_session */
+} janus_streaming_listeners;
+
 typedef struct janus_streaming_codecs {
 	gint audio_pt;
 	char *audio_rtpmap;
@@ -52,11 +99,68 @@ typedef struct janus_streaming_mountpoint {
 	//void *source;	/* Can differ according to the source type */
 	//GDestroyNotify source_destroy;
 	janus_streaming_codecs codecs;
-	GList/*<unowned janus_streaming_session>*/ *listeners;
+	GList/*<unowned janus_streaming_session>*/ *listeners;	/* Writers only, under mutex */
+	janus_streaming_listeners * volatile listeners_snapshot;	/* Published copy of listeners for the relay path, read and replaced atomically */
+	volatile gint listeners_readers;	/* Relay threads between loading listeners_snapshot and taking their reference on it */
 	gint64 destroyed;
+	gboolean preloaded;	/* Started from the configuration, kept running without viewers */
+	/* Under mountpoints_mutex: ids registered besides id for the same source, and their count plus one */
+	gchar *source_key;	/* normalized uri, NULL if not shared */
+	GList *aliases;
+	guint names;
+	gint64 linger_until;	/* Unwatched but kept running until then, 0 otherwise; under mountpoints_mutex */
+	guint reaping;	/* Teardowns not done yet, the mountpoint is only freed after them; under reaper_mutex */
+	gboolean free_pending;
+	/* Reconnection of a lost source: set on the pipeline thread, cleared by the first packet of the new build */
+	volatile gint source_generation;	/* pipelines built after the first one */
+	gint lost_generation;
+	gint64 source_lost;	/* when it was lost, 0 while it is up */
+	volatile gint reconnect_attempt;	/* since it was lost, picks the backoff */
+	guint64 reconnects;
+	gint64 reconnect_time_last;	/* milliseconds from the loss to the first packet */
+	gint64 reconnect_time_max;
+	gint64 reconnect_time_total;
+	ladder_rewrite source_rewrite[JANUS_STREAMING_STREAM_MAX];	/* Continuity of what viewers see across builds */
+	gint64 source_last_packet;
+	/* Hot standby of a source with a backup: what it received and dropped, and the failovers to it */
+	gboolean has_backup;
+	guint64 standby_packets;
+	guint64 standby_bytes;
+	gint64 standby_last_packet;
+	gboolean failing_over;	/* source_lost is then when the primary went quiet */
+	guint64 failovers;
+	gint64 failover_time_last;	/* milliseconds from the last packet of the primary to the first of the standby */
+	gint64 failover_time_max;
 	janus_mutex mutex;
 	socket_utils_socket socket[JANUS_STREAMING_STREAM_MAX][JANUS_STREAMING_SOCKET_MAX];
 	janus_streaming_socket_cbk_data rtp_cbk_data[JANUS_STREAMING_STREAM_MAX];
 	guint32 ssrc[JANUS_STREAMING_STREAM_MAX];
+	gint ingest;
+	socket_utils_batch rtp_batch[JANUS_STREAMING_STREAM_MAX];
+	shm_ring *rtp_ring[JANUS_STREAMING_STREAM_MAX];
+	GSource *rtp_ring_source[JANUS_STREAMING_STREAM_MAX];
+	GSource *keyframe_requests_source;	/* Sends the coalesced PLI even when the source stalls */
+	context_pool_thread *relay_thread;	/* NULL when relaying from the default context */
+	gint video_codec;	/* GOP_CACHE_CODEC_*, resolved from the video rtpmap on the relay path */
+	gop_cache *gop;	/* NULL unless new viewers get the latest keyframe burst to them */
+	keyframe_requests *keyframe_requests;	/* PLI/FIR aggregation toward the source */
+	nack_history *nack;	/* NULL when viewer NACKs are not answered */
+	remb_aggregator *remb;	/* Viewer bandwidth estimates driving the source bitrate */
+	GstElement *encoder;	/* Set while a transcoding pipeline runs, under mutex */
+	guint ladder_size;	/* 0 unless video is transcoded into several renditions */
+	ladder_rendition_spec *ladder;
+	janus_streaming_rendition *renditions;
+	gint temporal_layers;	/* VP8 temporal layers seen on the video, relay thread only */
+	guint64 video_bitrate;	/* refreshed from the RTCP path, see janus_streaming_video_bitrate() */
+	guint64 video_bitrate_bytes;
+	gint64 video_bitrate_time;
+	/* ingest statistics, only written by the thread feeding the stream */
+	guint64 rtp_wakeups[JANUS_STREAMING_STREAM_MAX];
+	guint64 rtp_packets[JANUS_STREAMING_STREAM_MAX];
+	guint64 rtp_bytes[JANUS_STREAMING_STREAM_MAX];
+	gint64 rtp_first_packet[JANUS_STREAMING_STREAM_MAX];
+	guint64 fanout_parallel_packets;
+	/* Per stream, the last snapshot handed to the fanout workers, held until they are done with it */
+	janus_streaming_listeners *fanout_last[JANUS_STREAMING_STREAM_MAX];
 } janus_streaming_mountpoint;
 
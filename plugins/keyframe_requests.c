@@ -0,0 +1,101 @@
+#include "keyframe_requests.h"
+#include "debug.h"
+
+
+keyframe_requests * keyframe_requests_new(guint window_ms, guint keyframe_timeout_ms)
+{
+	keyframe_requests * requests = g_malloc0(sizeof(keyframe_requests));
+
+	janus_mutex_init(&requests->mutex);
+	requests->window = (gint64)window_ms * 1000;
+	requests->keyframe_timeout = (gint64)keyframe_timeout_ms * 1000;
+
+	return requests;
+}
+
+void keyframe_requests_free(keyframe_requests * requests)
+{
+	if (!requests) {
+		return;
+	}
+
+	janus_mutex_destroy(&requests->mutex);
+	g_free(requests);
+}
+
+/* A viewer asked for a keyframe; TRUE when the caller has to forward it upstream now */
+gboolean keyframe_requests_add(keyframe_requests * requests, gint64 now)
+{
+	gboolean forward = FALSE;
+	gint64 elapsed;
+
+	janus_mutex_lock(&requests->mutex);
+
+	requests->requested++;
+	elapsed = now - requests->last_forwarded;
+	if (requests->in_flight && elapsed < requests->keyframe_timeout) {
+		/* The keyframe already requested will do for this viewer too */
+		requests->suppressed++;
+	}
+	else if (!requests->last_forwarded || elapsed >= requests->window) {
+		requests->last_forwarded = now;
+		requests->in_flight = TRUE;
+		requests->forwarded++;
+		forward = TRUE;
+	}
+	else {
+		/* Too soon after the previous one, sent by keyframe_requests_poll() when the window is over */
+		requests->coalesced++;
+		g_atomic_int_set(&requests->pending, 1);
+	}
+
+	janus_mutex_unlock(&requests->mutex);
+
+	return forward;
+}
+
+/* Called on the relay path and from a timer on the relay thread; TRUE when a coalesced request is due */
+gboolean keyframe_requests_poll(keyframe_requests * requests, gint64 now)
+{
+	gboolean forward = FALSE;
+
+	if (!g_atomic_int_get(&requests->pending)) {
+		return FALSE;
+	}
+
+	janus_mutex_lock(&requests->mutex);
+
+	if (requests->pending && now - requests->last_forwarded >= requests->window) {
+		g_atomic_int_set(&requests->pending, 0);
+		requests->last_forwarded = now;
+		requests->in_flight = TRUE;
+		requests->forwarded++;
+		forward = TRUE;
+	}
+
+	janus_mutex_unlock(&requests->mutex);
+
+	return forward;
+}
+
+/* A viewer asked for a keyframe the source produces on its own anyway, counted as suppressed */
+void keyframe_requests_ignore(keyframe_requests * requests)
+{
+	janus_mutex_lock(&requests->mutex);
+	requests->requested++;
+	requests->suppressed++;
+	janus_mutex_unlock(&requests->mutex);
+}
+
+/* A keyframe reached the relay, later requests are for a new one. It also answers
+ * a coalesced request still waiting for its window, which is dropped */
+void keyframe_requests_keyframe(keyframe_requests * requests)
+{
+	janus_mutex_lock(&requests->mutex);
+	requests->in_flight = FALSE;
+	if (requests->pending) {
+		g_atomic_int_set(&requests->pending, 0);
+		requests->suppressed++;
+	}
+	janus_mutex_unlock(&requests->mutex);
+}
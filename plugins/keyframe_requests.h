@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glib.h>
+#include "../mutex.h"
+
+/* Collapses the PLI/FIR of all viewers of a mountpoint into as few upstream
+ * requests as possible: one per window, none while a keyframe is on its way */
+typedef struct keyframe_requests {
+	janus_mutex mutex;
+	gint64 window;			/* microseconds between two upstream requests */
+	gint64 keyframe_timeout;	/* microseconds a requested keyframe is waited for */
+	gint64 last_forwarded;
+	gboolean in_flight;		/* forwarded and no keyframe seen since */
+	volatile gint pending;		/* coalesced request to forward once the window is over */
+	guint64 requested;
+	guint64 forwarded;
+	guint64 coalesced;
+	guint64 suppressed;
+} keyframe_requests;
+
+keyframe_requests * keyframe_requests_new(guint window_ms, guint keyframe_timeout_ms);
+void keyframe_requests_free(keyframe_requests * requests);
+gboolean keyframe_requests_add(keyframe_requests * requests, gint64 now);
+gboolean keyframe_requests_poll(keyframe_requests * requests, gint64 now);
+void keyframe_requests_ignore(keyframe_requests * requests);
+void keyframe_requests_keyframe(keyframe_requests * requests);
@@ -0,0 +1,158 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ladder.h"
+#include "../rtcp.h"
+#include "debug.h"
+
+
+/* Share of the estimate a rendition may use, leaves room for audio and retransmissions */
+#define LADDER_HEADROOM_PERCENT 85
+/* Fraction lost (out of 256) above which a viewer is moved down, and below which it may go up */
+#define LADDER_LOSS_DOWN 26
+#define LADDER_LOSS_UP 5
+/* Timestamp gap put between the last frame of a rendition and the first of the next one, 1/30 s */
+#define LADDER_MIN_TS_STEP(rate) ((rate) / 30)
+
+static gint ladder_compare(gconstpointer a, gconstpointer b)
+{
+	const ladder_rendition_spec *x = a, *y = b;
+
+	return x->bitrate < y->bitrate ? 1 : (x->bitrate > y->bitrate ? -1 : 0);
+}
+
+/* "WIDTHxHEIGHT@KBPS,..." sorted from the highest bitrate down; NULL when malformed */
+ladder_rendition_spec * ladder_parse(const gchar * value, guint * count)
+{
+	gchar ** items = g_strsplit(value ? value : LADDER_DEFAULT_RENDITIONS, ",", -1);
+	guint n = g_strv_length(items);
+	ladder_rendition_spec * specs = g_new0(ladder_rendition_spec, n ? n : 1);
+
+	*count = 0;
+	for (guint i = 0; i < n; i++) {
+		guint width = 0, height = 0, kbps = 0;
+		gchar * item = g_strstrip(items[i]);
+		if (!*item) {
+			continue;
+		}
+		if (sscanf(item, "%ux%u@%u", &width, &height, &kbps) != 3 || !width || !height || !kbps) {
+			JANUS_LOG(LOG_ERR, "Invalid rendition '%s', expected WIDTHxHEIGHT@KBPS\n", item);
+			g_free(specs);
+			g_strfreev(items);
+			*count = 0;
+			return NULL;
+		}
+		specs[*count].width = width;
+		specs[*count].height = height;
+		specs[*count].bitrate = (guint64)kbps * 1000;
+		(*count)++;
+	}
+	g_strfreev(items);
+
+	if (!*count) {
+		g_free(specs);
+		return NULL;
+	}
+	qsort(specs, *count, sizeof(ladder_rendition_spec), ladder_compare);
+
+	return specs;
+}
+
+/* Rendition a viewer should receive given its bandwidth estimate (0 = unknown) and the
+ * fraction of packets it reports lost (-1 = unknown). Downgrades apply at once, upgrades
+ * only when the caller allows them */
+gint ladder_select(const ladder_rendition_spec * specs, guint count, gint current, guint64 estimate, gint fraction_lost, gboolean may_upgrade)
+{
+	gint target = current < 0 ? (gint)count / 2 : current;
+
+	if (estimate > 0) {
+		guint64 usable = estimate * LADDER_HEADROOM_PERCENT / 100;
+		target = count - 1;
+		for (guint i = 0; i < count; i++) {
+			if (specs[i].bitrate <= usable) {
+				target = i;
+				break;
+			}
+		}
+	}
+
+	if (current >= 0) {
+		if (fraction_lost > LADDER_LOSS_DOWN) {
+			target = MAX(target, MIN(current + 1, (gint)count - 1));
+		}
+		if (target < current && (!may_upgrade || fraction_lost > LADDER_LOSS_UP)) {
+			target = current;
+		}
+	}
+
+	return target;
+}
+
+/* Highest fraction lost in the report blocks of a compound RTCP packet, -1 when there are none */
+gint ladder_fraction_lost(const char * buf, int len)
+{
+	gint lost = -1;
+	int offset = 0;
+
+	while (offset + (int)sizeof(rtcp_header) <= len) {
+		const rtcp_header * header = (const rtcp_header *)(buf + offset);
+		int length = (ntohs(header->length) + 1) * 4;
+		const report_block * blocks = NULL;
+
+		if (header->version != 2 || offset + length > len) {
+			break;
+		}
+		if (header->type == RTCP_RR) {
+			blocks = ((const rtcp_rr *)header)->rb;
+		}
+		else if (header->type == RTCP_SR) {
+			blocks = ((const rtcp_sr *)header)->rb;
+		}
+		for (guint i = 0; blocks && i < header->rc; i++) {
+			if ((const char *)&blocks[i + 1] > buf + offset + length) {
+				break;
+			}
+			lost = MAX(lost, (gint)(ntohl(blocks[i].flcnpl) >> 24));
+		}
+		offset += length;
+	}
+
+	return lost;
+}
+
+/* Rewrites an RTP header in place so the viewer sees a single stream; the first packet
+ * after a change of rendition continues right after the last one sent */
+void ladder_rewrite_packet(ladder_rewrite * rewrite, rtp_header * rtp, gint source, gint64 now)
+{
+	guint16 seq = ntohs(rtp->seq_number);
+	guint32 ts = ntohl(rtp->timestamp);
+
+	if (!rewrite->initialized) {
+		rewrite->initialized = TRUE;
+		rewrite->ssrc = ntohl(rtp->ssrc);
+		rewrite->source = source;
+		rewrite->seq_offset = 0;
+		rewrite->ts_offset = 0;
+	}
+	else if (rewrite->source != source) {
+		/* Advance the clock by the wall time elapsed since the last packet */
+		guint32 rate = rewrite->clock_rate ? rewrite->clock_rate : 90000;
+		guint32 step = MAX((guint32)((now - rewrite->last_sent) * rate / G_USEC_PER_SEC), LADDER_MIN_TS_STEP(rate));
+		rewrite->source = source;
+		rewrite->seq_offset = (guint16)(rewrite->last_seq + 1 - seq);
+		rewrite->ts_offset = rewrite->last_ts + step - ts;
+	}
+
+	guint16 out_seq = seq + rewrite->seq_offset;
+	guint32 out_ts = ts + rewrite->ts_offset;
+	if (rewrite->last_sent == 0 || (gint16)(out_seq - rewrite->last_seq) > 0) {
+		/* Reordered packets keep their place without moving the reference back */
+		rewrite->last_seq = out_seq;
+		rewrite->last_ts = out_ts;
+	}
+	rewrite->last_sent = now;
+
+	rtp->ssrc = htonl(rewrite->ssrc);
+	rtp->seq_number = htons(out_seq);
+	rtp->timestamp = htonl(out_ts);
+}
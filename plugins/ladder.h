@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glib.h>
+#include "../rtp.h"
+
+/* Renditions configured when none are given */
+#define LADDER_DEFAULT_RENDITIONS "1920x1080@4000,1280x720@2000,640x360@600"
+
+/* One encoding of the ladder, bitrate in bits per second */
+typedef struct ladder_rendition_spec {
+	guint width;
+	guint height;
+	guint64 bitrate;
+} ladder_rendition_spec;
+
+/* Keeps the SSRC, sequence numbers and timestamps a viewer sees continuous
+ * while it is moved from one rendition to another, or a source is reconnected */
+typedef struct ladder_rewrite {
+	gboolean initialized;
+	guint32 clock_rate;		/* of the timestamps, 0 for 90 kHz */
+	guint32 ssrc;
+	gint source;			/* rendition (or build of the source) the last packet came from */
+	guint16 seq_offset;
+	guint32 ts_offset;
+	guint16 last_seq;		/* last values sent, rewritten */
+	guint32 last_ts;
+	gint64 last_sent;
+} ladder_rewrite;
+
+ladder_rendition_spec * ladder_parse(const gchar * value, guint * count);
+gint ladder_select(const ladder_rendition_spec * specs, guint count, gint current, guint64 estimate, gint fraction_lost, gboolean may_upgrade);
+gint ladder_fraction_lost(const char * buf, int len);
+void ladder_rewrite_packet(ladder_rewrite * rewrite, rtp_header * rtp, gint source, gint64 now);
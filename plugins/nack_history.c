@@ -0,0 +1,94 @@
+#include "nack_history.h"
+#include "debug.h"
+
+
+static void nack_history_reset(nack_history * history)
+{
+	for (guint i = 0; i < NACK_HISTORY_SLOTS; i++) {
+		if (history->slots[i].buffer) {
+			packet_buffer_unref(history->slots[i].buffer);
+			history->slots[i].buffer = NULL;
+		}
+	}
+}
+
+nack_history * nack_history_new(guint depth_ms)
+{
+	nack_history * history = g_malloc0(sizeof(nack_history));
+
+	janus_mutex_init(&history->mutex);
+	history->depth = (gint64)depth_ms * 1000;
+
+	return history;
+}
+
+void nack_history_free(nack_history * history)
+{
+	if (!history) {
+		return;
+	}
+
+	nack_history_reset(history);
+	janus_mutex_destroy(&history->mutex);
+	g_free(history);
+}
+
+/* Called from the relay path for every video packet, replaces whatever shared its slot */
+void nack_history_store(nack_history * history, packet_buffer * buffer, guint16 seq, gint64 now)
+{
+	nack_history_slot * slot = &history->slots[seq % NACK_HISTORY_SLOTS];
+	packet_buffer * old;
+
+	packet_buffer_ref(buffer);
+
+	janus_mutex_lock(&history->mutex);
+	old = slot->buffer;
+	slot->buffer = buffer;
+	slot->seq = seq;
+	slot->stored = now;
+	janus_mutex_unlock(&history->mutex);
+
+	if (old) {
+		packet_buffer_unref(old);
+	}
+}
+
+/* A reference to the packet with that sequence number, NULL when it is not in the history
+ * or older than the configured depth. Only the hit/miss counters are updated here */
+packet_buffer * nack_history_lookup(nack_history * history, guint16 seq, gint64 now)
+{
+	nack_history_slot * slot = &history->slots[seq % NACK_HISTORY_SLOTS];
+	packet_buffer * buffer = NULL;
+
+	janus_mutex_lock(&history->mutex);
+	history->requested++;
+	if (slot->buffer && slot->seq == seq && now - slot->stored <= history->depth) {
+		buffer = packet_buffer_ref(slot->buffer);
+		history->retransmitted++;
+	}
+	else {
+		history->missed++;
+	}
+	janus_mutex_unlock(&history->mutex);
+
+	return buffer;
+}
+
+/* Drops the stored packets, e.g. when the source restarts with a new sequence space */
+void nack_history_clear(nack_history * history)
+{
+	janus_mutex_lock(&history->mutex);
+	nack_history_reset(history);
+	janus_mutex_unlock(&history->mutex);
+}
+
+/* Accounts for one NACK message, recovered when every packet it asked for was found */
+void nack_history_feedback(nack_history * history, gboolean recovered)
+{
+	janus_mutex_lock(&history->mutex);
+	history->nacks++;
+	if (recovered) {
+		history->recovered++;
+	}
+	janus_mutex_unlock(&history->mutex);
+}
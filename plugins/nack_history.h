@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glib.h>
+#include "packet_pool.h"
+#include "../mutex.h"
+
+/* Ring slots, indexed by sequence number; at least a second of video at 1000 packets/s */
+#define NACK_HISTORY_SLOTS 1024
+
+typedef struct nack_history_slot {
+	packet_buffer *buffer;	/* one reference, NULL while empty */
+	guint16 seq;
+	gint64 stored;
+} nack_history_slot;
+
+/* Recently relayed video packets, kept to answer viewer NACKs */
+typedef struct nack_history {
+	janus_mutex mutex;
+	gint64 depth;	/* microseconds a packet can be retransmitted for */
+	nack_history_slot slots[NACK_HISTORY_SLOTS];
+	guint64 nacks;			/* NACK feedback messages received */
+	guint64 requested;		/* sequence numbers asked for */
+	guint64 retransmitted;
+	guint64 missed;			/* asked for but too old or never seen */
+	guint64 recovered;		/* NACKs answered in full, each one a keyframe request avoided */
+} nack_history;
+
+nack_history * nack_history_new(guint depth_ms);
+void nack_history_free(nack_history * history);
+void nack_history_store(nack_history * history, packet_buffer * buffer, guint16 seq, gint64 now);
+packet_buffer * nack_history_lookup(nack_history * history, guint16 seq, gint64 now);
+void nack_history_clear(nack_history * history);
+void nack_history_feedback(nack_history * history, gboolean recovered);
@@ -0,0 +1,313 @@
+#include <string.h>
+#include "pacer.h"
+#include "debug.h"
+#include "utils.h"
+
+
+/* Packets a queue may send back to back after being idle */
+#define PACER_BURST_PACKETS 4
+#define PACER_PACKET_SIZE 1200
+
+typedef struct pacer_packet {
+	gint64 queued;
+	gboolean is_video;
+	gint length;
+	gchar data[];
+} pacer_packet;
+
+static gpointer pacer_thread(gpointer data);
+static void pacer_queue_drain(pacer_queue * queue, gint64 now);
+
+pacer * pacer_new(guint interval_ms)
+{
+	GError *error = NULL;
+	pacer * pacer = g_malloc0(sizeof(struct pacer));
+
+	janus_mutex_init(&pacer->mutex);
+	janus_condition_init(&pacer->cond);
+	pacer->interval = (gint64)MIN(interval_ms, PACER_WHEEL_SLOTS - 1) * 1000;
+	pacer->burst = PACER_BURST_PACKETS * PACER_PACKET_SIZE;
+	pacer->started = janus_get_monotonic_time();
+
+	pacer->thread = g_thread_try_new("streaming pacer", pacer_thread, pacer, &error);
+	if (!pacer->thread) {
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the pacer thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		janus_condition_destroy(&pacer->cond);
+		janus_mutex_destroy(&pacer->mutex);
+		g_free(pacer);
+		return NULL;
+	}
+
+	return pacer;
+}
+
+void pacer_free(pacer * pacer)
+{
+	if (!pacer) {
+		return;
+	}
+
+	janus_mutex_lock(&pacer->mutex);
+	g_atomic_int_set(&pacer->stopping, 1);
+	janus_condition_signal(&pacer->cond);
+	janus_mutex_unlock(&pacer->mutex);
+	g_thread_join(pacer->thread);
+
+	for (guint i = 0; i < PACER_WHEEL_SLOTS; i++) {
+		for (GSList *l = pacer->slots[i]; l; l = l->next) {
+			pacer_queue_unref((pacer_queue *)l->data);
+		}
+		g_slist_free(pacer->slots[i]);
+	}
+	janus_condition_destroy(&pacer->cond);
+	janus_mutex_destroy(&pacer->mutex);
+	g_free(pacer);
+}
+
+static guint64 pacer_tick_at(pacer * pacer, gint64 when)
+{
+	return (guint64)((when - pacer->started) / PACER_TICK_USEC);
+}
+
+/* Puts a queue on the wheel, the wheel keeps a reference until the slot is serviced */
+static void pacer_schedule(pacer * pacer, pacer_queue * queue, gint64 when)
+{
+	janus_mutex_lock(&pacer->mutex);
+	if (!pacer->scheduled) {
+		/* The thread slept over empty slots, the wheel starts again from now */
+		guint64 current = pacer_tick_at(pacer, janus_get_monotonic_time());
+		if (current > pacer->tick + 1)
+			pacer->tick = current - 1;
+		janus_condition_signal(&pacer->cond);
+	}
+	guint64 tick = MAX(pacer_tick_at(pacer, when), pacer->tick + 1);
+	tick = MIN(tick, pacer->tick + PACER_WHEEL_SLOTS - 1);
+	g_atomic_int_inc(&queue->ref);
+	pacer->slots[tick % PACER_WHEEL_SLOTS] = g_slist_prepend(pacer->slots[tick % PACER_WHEEL_SLOTS], queue);
+	pacer->scheduled++;
+	janus_mutex_unlock(&pacer->mutex);
+}
+
+static gpointer pacer_thread(gpointer data)
+{
+	pacer * pacer = (struct pacer *)data;
+
+	JANUS_LOG(LOG_INFO, "Streaming pacer started\n");
+
+	while (!g_atomic_int_get(&pacer->stopping)) {
+		gint64 now = janus_get_monotonic_time();
+		guint64 current = pacer_tick_at(pacer, now);
+		GSList *due = NULL;
+
+		janus_mutex_lock(&pacer->mutex);
+		/* Catch up on the ticks missed while servicing or sleeping */
+		while (pacer->tick < current) {
+			pacer->tick++;
+			guint slot = pacer->tick % PACER_WHEEL_SLOTS;
+			pacer->scheduled -= g_slist_length(pacer->slots[slot]);
+			due = g_slist_concat(due, pacer->slots[slot]);
+			pacer->slots[slot] = NULL;
+		}
+		janus_mutex_unlock(&pacer->mutex);
+
+		for (GSList *l = due; l; l = l->next) {
+			pacer_queue * queue = (pacer_queue *)l->data;
+			janus_mutex_lock(&queue->mutex);
+			queue->scheduled = FALSE;
+			pacer_queue_drain(queue, now);
+			janus_mutex_unlock(&queue->mutex);
+			pacer_queue_unref(queue);
+		}
+		g_slist_free(due);
+
+		/* Nothing to pace: no wake up every tick until a queue is scheduled */
+		janus_mutex_lock(&pacer->mutex);
+		while (!pacer->scheduled && !g_atomic_int_get(&pacer->stopping)) {
+			janus_condition_wait(&pacer->cond, &pacer->mutex);
+			current = pacer->tick;
+		}
+		janus_mutex_unlock(&pacer->mutex);
+
+		gint64 next = pacer->started + (gint64)(current + 1) * PACER_TICK_USEC;
+		now = janus_get_monotonic_time();
+		if (next > now) {
+			g_usleep(next - now);
+		}
+	}
+
+	JANUS_LOG(LOG_INFO, "Streaming pacer stopped\n");
+	return NULL;
+}
+
+pacer_queue * pacer_queue_new(pacer * pacer, pacer_send_func send, gpointer user_data)
+{
+	pacer_queue * queue = g_malloc0(sizeof(pacer_queue));
+
+	queue->pacer = pacer;
+	queue->ref = 1;
+	janus_mutex_init(&queue->mutex);
+	g_queue_init(&queue->packets);
+	queue->send = send;
+	queue->user_data = user_data;
+
+	return queue;
+}
+
+static void pacer_queue_flush(pacer_queue * queue)
+{
+	pacer_packet * packet;
+
+	while ((packet = g_queue_pop_head(&queue->packets)) != NULL) {
+		g_free(packet);
+	}
+	queue->queued_bytes = 0;
+}
+
+void pacer_queue_unref(pacer_queue * queue)
+{
+	if (!queue || !g_atomic_int_dec_and_test(&queue->ref)) {
+		return;
+	}
+
+	pacer_queue_flush(queue);
+	janus_mutex_destroy(&queue->mutex);
+	g_free(queue);
+}
+
+/* Bitrate in bits per second the viewer is paced at, 0 to send everything at once */
+void pacer_queue_set_rate(pacer_queue * queue, guint64 bitrate)
+{
+	janus_mutex_lock(&queue->mutex);
+	queue->rate = bitrate / 8;
+	janus_mutex_unlock(&queue->mutex);
+}
+
+static void pacer_queue_record(pacer_queue * queue, gint64 delay)
+{
+	guint bucket = delay > 0 ? MIN(g_bit_storage((gulong)delay), PACER_DELAY_BUCKETS - 1) : 0;
+
+	queue->delays[bucket]++;
+	queue->sent++;
+	if (delay > 0) {
+		queue->delayed++;
+	}
+}
+
+/* Sends what the bucket allows plus whatever reached the interval; must be called with the mutex held */
+static void pacer_queue_drain(pacer_queue * queue, gint64 now)
+{
+	pacer * pacer = queue->pacer;
+	pacer_packet * packet;
+
+	if (queue->closed) {
+		pacer_queue_flush(queue);
+		return;
+	}
+
+	if (queue->rate) {
+		queue->tokens = MIN(queue->tokens + (gdouble)queue->rate * (now - queue->refilled) / G_USEC_PER_SEC, pacer->burst);
+	}
+	queue->refilled = now;
+
+	while ((packet = g_queue_peek_head(&queue->packets)) != NULL) {
+		gboolean overdue = now - packet->queued >= pacer->interval;
+		if (queue->rate && queue->tokens < packet->length && !overdue) {
+			break;
+		}
+		g_queue_pop_head(&queue->packets);
+		queue->queued_bytes -= packet->length;
+		queue->tokens -= packet->length;
+		pacer_queue_record(queue, now - packet->queued);
+		queue->send(queue->user_data, packet->is_video, packet->data, packet->length);
+		g_free(packet);
+	}
+	if (queue->tokens < 0) {
+		queue->tokens = 0;
+	}
+
+	if (packet && !queue->scheduled) {
+		/* Back when the head packet has enough tokens, or is due anyway */
+		gint64 wait = (gint64)((packet->length - queue->tokens) * G_USEC_PER_SEC / queue->rate);
+		gint64 when = MIN(now + wait, packet->queued + pacer->interval);
+		queue->scheduled = TRUE;
+		pacer_schedule(pacer, queue, when);
+	}
+}
+
+/* Called on the relay path instead of relaying the packet directly */
+void pacer_queue_push(pacer_queue * queue, gboolean is_video, const char * buf, int len)
+{
+	gint64 now = janus_get_monotonic_time();
+
+	janus_mutex_lock(&queue->mutex);
+
+	if (queue->closed) {
+		janus_mutex_unlock(&queue->mutex);
+		return;
+	}
+
+	pacer_packet * packet = g_malloc(sizeof(pacer_packet) + len);
+	packet->queued = now;
+	packet->is_video = is_video;
+	packet->length = len;
+	memcpy(packet->data, buf, len);
+	g_queue_push_tail(&queue->packets, packet);
+	queue->queued_bytes += len;
+
+	/* Nothing waiting ahead of it: it may leave right away if the bucket allows */
+	if (!queue->scheduled) {
+		pacer_queue_drain(queue, now);
+	}
+
+	janus_mutex_unlock(&queue->mutex);
+}
+
+/* Drops what is queued and anything pushed until reopened, e.g. while the viewer has no PeerConnection */
+void pacer_queue_close(pacer_queue * queue)
+{
+	janus_mutex_lock(&queue->mutex);
+	queue->closed = TRUE;
+	pacer_queue_flush(queue);
+	janus_mutex_unlock(&queue->mutex);
+}
+
+void pacer_queue_reopen(pacer_queue * queue)
+{
+	janus_mutex_lock(&queue->mutex);
+	queue->closed = FALSE;
+	queue->tokens = queue->pacer->burst;
+	queue->refilled = janus_get_monotonic_time();
+	janus_mutex_unlock(&queue->mutex);
+}
+
+/* Adds the delay histogram of a queue to total */
+void pacer_delays_add(guint64 * total, const pacer_queue * queue)
+{
+	for (guint i = 0; i < PACER_DELAY_BUCKETS; i++) {
+		total[i] += queue->delays[i];
+	}
+}
+
+/* Upper bound in microseconds of the given percentile of a delay histogram, -1 when empty */
+gint64 pacer_delays_percentile(const guint64 * delays, guint percentile)
+{
+	guint64 count = 0, seen = 0;
+
+	for (guint i = 0; i < PACER_DELAY_BUCKETS; i++) {
+		count += delays[i];
+	}
+	if (!count) {
+		return -1;
+	}
+
+	guint64 rank = (count * percentile + 99) / 100;
+	for (guint i = 0; i < PACER_DELAY_BUCKETS; i++) {
+		seen += delays[i];
+		if (seen >= rank) {
+			return i ? (gint64)1 << i : 0;
+		}
+	}
+	return (gint64)1 << (PACER_DELAY_BUCKETS - 1);
+}
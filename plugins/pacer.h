@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glib.h>
+#include "../mutex.h"
+
+/* Wheel resolution and size: a queue can be scheduled up to PACER_WHEEL_SLOTS ticks ahead */
+#define PACER_TICK_USEC 1000
+#define PACER_WHEEL_SLOTS 256
+/* Queue delay histogram, bucket i counts delays below 2^i microseconds */
+#define PACER_DELAY_BUCKETS 24
+
+typedef void (*pacer_send_func)(gpointer user_data, gboolean is_video, char * buf, int len);
+
+struct pacer;
+
+/* Leaky bucket of one viewer; packets leave at the viewer's rate, and none waits
+ * longer than the pacing interval */
+typedef struct pacer_queue {
+	struct pacer *pacer;
+	volatile gint ref;
+	janus_mutex mutex;
+	GQueue packets;
+	gsize queued_bytes;
+	guint64 rate;			/* bytes per second, 0 = not paced */
+	gdouble tokens;			/* bytes that may leave right now */
+	gint64 refilled;
+	gboolean scheduled;		/* on the wheel */
+	gboolean closed;
+	pacer_send_func send;
+	gpointer user_data;
+	guint64 sent;
+	guint64 delayed;
+	guint64 delays[PACER_DELAY_BUCKETS];
+} pacer_queue;
+
+/* One thread servicing every queue from a hashed timing wheel */
+typedef struct pacer {
+	GThread *thread;
+	volatile gint stopping;
+	janus_mutex mutex;
+	janus_condition cond;		/* signaled when the wheel gets a queue or the pacer stops */
+	gint64 interval;		/* microseconds */
+	gdouble burst;			/* bytes a queue may send back to back when idle */
+	gint64 started;
+	guint64 tick;			/* last tick serviced */
+	GSList *slots[PACER_WHEEL_SLOTS];
+	guint scheduled;		/* queues on the wheel, the thread sleeps while there is none */
+} pacer;
+
+pacer * pacer_new(guint interval_ms);
+void pacer_free(pacer * pacer);
+pacer_queue * pacer_queue_new(pacer * pacer, pacer_send_func send, gpointer user_data);
+void pacer_queue_unref(pacer_queue * queue);
+void pacer_queue_set_rate(pacer_queue * queue, guint64 bitrate);
+void pacer_queue_push(pacer_queue * queue, gboolean is_video, const char * buf, int len);
+void pacer_queue_close(pacer_queue * queue);
+void pacer_queue_reopen(pacer_queue * queue);
+void pacer_delays_add(guint64 * total, const pacer_queue * queue);
+gint64 pacer_delays_percentile(const guint64 * delays, guint percentile);
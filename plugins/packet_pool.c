@@ -0,0 +1,202 @@
+#include <string.h>
+#include "packet_pool.h"
+#include "debug.h"
+#include "mutex.h"
+
+
+static void packet_pool_thread_exit(gpointer data);
+
+static GPrivate current_pool = G_PRIVATE_INIT(packet_pool_thread_exit);
+static janus_mutex pools_mutex;
+static GList *pools = NULL;
+static guint pool_size = 0;
+static guint next_index = 0;
+
+static void packet_pool_free(packet_pool * pool)
+{
+	g_free(pool->buffers);
+	g_free(pool);
+}
+
+/* Pools outlive the threads using them: buffers may still be queued somewhere,
+ * so the pool is left for the next thread to adopt instead of being freed */
+static void packet_pool_thread_exit(gpointer data)
+{
+	packet_pool * pool = (packet_pool *)data;
+
+	janus_mutex_lock(&pools_mutex);
+	pool->owner = NULL;
+	if (pool->detached && !g_atomic_int_get(&pool->in_use)) {
+		janus_mutex_unlock(&pools_mutex);
+		packet_pool_free(pool);
+		return;
+	}
+	janus_mutex_unlock(&pools_mutex);
+}
+
+static packet_pool * packet_pool_new(guint size)
+{
+	packet_pool * pool = g_malloc0(sizeof(packet_pool));
+
+	pool->size = size;
+	pool->buffers = size ? g_new(packet_buffer, size) : NULL;
+	for (guint i = 0; i < size; i++) {
+		pool->buffers[i].pool = pool;
+		pool->buffers[i].next = i + 1 < size ? &pool->buffers[i + 1] : NULL;
+	}
+	pool->free_list = pool->buffers;
+
+	return pool;
+}
+
+static packet_pool * packet_pool_get_current(void)
+{
+	packet_pool * pool = g_private_get(&current_pool);
+	GList * l;
+
+	if (pool) {
+		return pool;
+	}
+
+	janus_mutex_lock(&pools_mutex);
+	for (l = pools; l; l = l->next) {
+		packet_pool * candidate = (packet_pool *)l->data;
+		if (!candidate->owner) {
+			pool = candidate;
+			break;
+		}
+	}
+	if (!pool) {
+		pool = packet_pool_new(pool_size);
+		pool->index = next_index++;
+		pools = g_list_append(pools, pool);
+		JANUS_LOG(LOG_VERB, "Created packet pool %u with %u buffers\n", pool->index, pool->size);
+	}
+	pool->owner = g_thread_self();
+	janus_mutex_unlock(&pools_mutex);
+
+	g_private_set(&current_pool, pool);
+	return pool;
+}
+
+void packet_pool_init(guint size)
+{
+	janus_mutex_init(&pools_mutex);
+	pool_size = size;
+}
+
+/* Pools still owned by a running thread are detached and freed when that thread exits */
+void packet_pool_destroy(void)
+{
+	GList * l;
+
+	janus_mutex_lock(&pools_mutex);
+	for (l = pools; l; l = l->next) {
+		packet_pool * pool = (packet_pool *)l->data;
+		if (pool->owner || g_atomic_int_get(&pool->in_use)) {
+			g_atomic_int_set(&pool->detached, TRUE);
+		}
+		else {
+			packet_pool_free(pool);
+		}
+	}
+	g_list_free(pools);
+	pools = NULL;
+	janus_mutex_unlock(&pools_mutex);
+}
+
+packet_buffer * packet_pool_acquire(void)
+{
+	packet_pool * pool = packet_pool_get_current();
+	packet_buffer * buffer = pool->free_list;
+
+	if (!buffer) {
+		/* Take everything other threads gave back in one go, only the owner ever empties the stack */
+		do {
+			buffer = g_atomic_pointer_get(&pool->returned);
+		} while (buffer && !g_atomic_pointer_compare_and_exchange(&pool->returned, buffer, NULL));
+	}
+
+	if (buffer) {
+		gint in_use = g_atomic_int_add(&pool->in_use, 1) + 1;
+		pool->free_list = buffer->next;
+		if (in_use > g_atomic_int_get(&pool->high_watermark)) {
+			g_atomic_int_set(&pool->high_watermark, in_use);
+		}
+	}
+	else {
+		g_atomic_int_inc(&pool->fallbacks);
+		buffer = g_malloc(sizeof(packet_buffer));
+		buffer->pool = NULL;
+	}
+
+	buffer->ref = 1;
+	buffer->next = NULL;
+	buffer->length = 0;
+	return buffer;
+}
+
+packet_buffer * packet_buffer_ref(packet_buffer * buffer)
+{
+	g_atomic_int_inc(&buffer->ref);
+	return buffer;
+}
+
+void packet_buffer_unref(packet_buffer * buffer)
+{
+	packet_pool * pool;
+	packet_buffer * head;
+
+	if (!buffer || !g_atomic_int_dec_and_test(&buffer->ref)) {
+		return;
+	}
+
+	pool = buffer->pool;
+	if (!pool) {
+		g_free(buffer);
+		return;
+	}
+
+	if (pool == g_private_get(&current_pool)) {
+		buffer->next = pool->free_list;
+		pool->free_list = buffer;
+	}
+	else {
+		do {
+			head = g_atomic_pointer_get(&pool->returned);
+			buffer->next = head;
+		} while (!g_atomic_pointer_compare_and_exchange(&pool->returned, head, buffer));
+	}
+
+	if (!g_atomic_int_get(&pool->detached)) {
+		g_atomic_int_add(&pool->in_use, -1);
+		return;
+	}
+
+	/* Shutting down: whoever drops the last reference of an ownerless pool frees it */
+	janus_mutex_lock(&pools_mutex);
+	if (g_atomic_int_dec_and_test(&pool->in_use) && !pool->owner) {
+		janus_mutex_unlock(&pools_mutex);
+		packet_pool_free(pool);
+		return;
+	}
+	janus_mutex_unlock(&pools_mutex);
+}
+
+void packet_pool_get_stats(packet_pool_stats * stats)
+{
+	GList * l;
+
+	memset(stats, 0, sizeof(*stats));
+
+	janus_mutex_lock(&pools_mutex);
+	for (l = pools; l; l = l->next) {
+		packet_pool * pool = (packet_pool *)l->data;
+		stats->pools++;
+		stats->size += pool->size;
+		stats->in_use += g_atomic_int_get(&pool->in_use);
+		stats->high_watermark += g_atomic_int_get(&pool->high_watermark);
+		stats->fallbacks += g_atomic_int_get(&pool->fallbacks);
+	}
+	janus_mutex_unlock(&pools_mutex);
+}
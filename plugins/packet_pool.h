@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glib.h>
+
+#define PACKET_POOL_BUFFER_SIZE 1500
+
+struct packet_pool;
+
+/* Refcounted packet storage; the last unref hands it back to the pool it came from */
+typedef struct packet_buffer {
+	volatile gint ref;
+	struct packet_pool *pool;	/* NULL when it was allocated because the pool ran dry */
+	struct packet_buffer *next;	/* free list linkage */
+	gsize length;
+	gchar data[PACKET_POOL_BUFFER_SIZE];
+} packet_buffer;
+
+/* Each thread acquires from its own pool, any thread may return buffers to it */
+typedef struct packet_pool {
+	guint index;
+	guint size;
+	GThread *owner;				/* NULL while no thread is acquiring from this pool */
+	volatile gint detached;			/* freed by its owner thread on exit, see packet_pool_destroy() */
+	packet_buffer *free_list;		/* only touched by the owner */
+	packet_buffer * volatile returned;	/* lock-free stack filled by other threads */
+	volatile gint in_use;
+	volatile gint high_watermark;
+	volatile gint fallbacks;		/* acquisitions served by malloc because the pool ran dry */
+	packet_buffer *buffers;
+} packet_pool;
+
+typedef struct packet_pool_stats {
+	guint pools;
+	guint size;
+	guint in_use;
+	guint high_watermark;
+	guint fallbacks;
+} packet_pool_stats;
+
+void packet_pool_init(guint size);
+void packet_pool_destroy(void);
+packet_buffer * packet_pool_acquire(void);
+packet_buffer * packet_buffer_ref(packet_buffer * buffer);
+void packet_buffer_unref(packet_buffer * buffer);
+void packet_pool_get_stats(packet_pool_stats * stats);
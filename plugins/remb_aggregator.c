@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "remb_aggregator.h"
+#include "debug.h"
+
+
+/* Estimates not refreshed for this many intervals are from viewers gone quiet; never
+ * sooner than the floor, receivers send a REMB about once a second whatever the interval */
+#define REMB_AGGREGATOR_STALE_INTERVALS 5
+#define REMB_AGGREGATOR_STALE_MIN (5 * G_USEC_PER_SEC)
+
+typedef struct remb_aggregator_estimate {
+	guint64 bitrate;
+	gint64 updated;
+} remb_aggregator_estimate;
+
+remb_aggregator * remb_aggregator_new(guint percentile, guint interval_ms)
+{
+	remb_aggregator * aggregator = g_malloc0(sizeof(remb_aggregator));
+
+	janus_mutex_init(&aggregator->mutex);
+	aggregator->percentile = MIN(percentile, 100);
+	aggregator->interval = (gint64)interval_ms * 1000;
+	aggregator->estimates = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+	return aggregator;
+}
+
+void remb_aggregator_free(remb_aggregator * aggregator)
+{
+	if (!aggregator) {
+		return;
+	}
+
+	g_hash_table_destroy(aggregator->estimates);
+	janus_mutex_destroy(&aggregator->mutex);
+	g_free(aggregator);
+}
+
+static gint remb_aggregator_compare(gconstpointer a, gconstpointer b)
+{
+	guint64 x = *(const guint64 *)a, y = *(const guint64 *)b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* Must be called with the mutex held */
+static guint64 remb_aggregator_compute(remb_aggregator * aggregator, gint64 now)
+{
+	GHashTableIter iter;
+	gpointer value;
+	guint64 * bitrates = g_new(guint64, g_hash_table_size(aggregator->estimates) + 1);
+	guint count = 0;
+	guint64 bitrate = 0;
+	gint64 stale = MAX(REMB_AGGREGATOR_STALE_INTERVALS * aggregator->interval, REMB_AGGREGATOR_STALE_MIN);
+
+	g_hash_table_iter_init(&iter, aggregator->estimates);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		remb_aggregator_estimate * estimate = (remb_aggregator_estimate *)value;
+		if (now - estimate->updated > stale) {
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+		bitrates[count++] = estimate->bitrate;
+	}
+
+	if (count) {
+		qsort(bitrates, count, sizeof(guint64), remb_aggregator_compare);
+		bitrate = bitrates[(count - 1) * aggregator->percentile / 100];
+	}
+	g_free(bitrates);
+
+	return bitrate;
+}
+
+/* Records the estimate of a viewer; returns the new aggregate when one is due, 0 otherwise */
+guint64 remb_aggregator_update(remb_aggregator * aggregator, gpointer viewer, guint64 bitrate, gint64 now)
+{
+	guint64 aggregate = 0;
+
+	janus_mutex_lock(&aggregator->mutex);
+
+	remb_aggregator_estimate * estimate = g_hash_table_lookup(aggregator->estimates, viewer);
+	if (!estimate) {
+		estimate = g_malloc0(sizeof(remb_aggregator_estimate));
+		g_hash_table_insert(aggregator->estimates, viewer, estimate);
+	}
+	estimate->bitrate = bitrate;
+	estimate->updated = now;
+	aggregator->received++;
+
+	if (now - aggregator->last_aggregate >= aggregator->interval) {
+		aggregator->last_aggregate = now;
+		aggregate = remb_aggregator_compute(aggregator, now);
+		if (aggregate) {
+			aggregator->bitrate = aggregate;
+			aggregator->applied++;
+		}
+	}
+
+	janus_mutex_unlock(&aggregator->mutex);
+
+	return aggregate;
+}
+
+/* The viewer left, its estimate no longer bounds the others */
+void remb_aggregator_remove(remb_aggregator * aggregator, gpointer viewer)
+{
+	janus_mutex_lock(&aggregator->mutex);
+	g_hash_table_remove(aggregator->estimates, viewer);
+	janus_mutex_unlock(&aggregator->mutex);
+}
+
+/* "min" or "pN" with N in 0..100; -1 when not recognized */
+gint remb_aggregator_parse_percentile(const gchar * value)
+{
+	if (!value || !strcasecmp(value, "min"))
+		return 0;
+	if ((value[0] == 'p' || value[0] == 'P') && value[1]) {
+		gchar * end = NULL;
+		gint64 percentile = g_ascii_strtoll(value + 1, &end, 10);
+		if (end && !*end && percentile >= 0 && percentile <= 100)
+			return (gint)percentile;
+	}
+	return -1;
+}
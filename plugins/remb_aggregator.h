@@ -0,0 +1,23 @@
+#pragma once
+
+#include <glib.h>
+#include "../mutex.h"
+
+/* Combines the bandwidth estimates (REMB) of the viewers of a mountpoint into
+ * the bitrate the source should produce */
+typedef struct remb_aggregator {
+	janus_mutex mutex;
+	guint percentile;		/* 0 = the lowest estimate */
+	gint64 interval;		/* microseconds between two aggregates */
+	gint64 last_aggregate;
+	GHashTable *estimates;		/* viewer -> remb_aggregator_estimate */
+	guint64 bitrate;		/* latest aggregate, 0 until the first one */
+	guint64 received;
+	guint64 applied;
+} remb_aggregator;
+
+remb_aggregator * remb_aggregator_new(guint percentile, guint interval_ms);
+void remb_aggregator_free(remb_aggregator * aggregator);
+guint64 remb_aggregator_update(remb_aggregator * aggregator, gpointer viewer, guint64 bitrate, gint64 now);
+void remb_aggregator_remove(remb_aggregator * aggregator, gpointer viewer);
+gint remb_aggregator_parse_percentile(const gchar * value);
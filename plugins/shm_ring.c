@@ -0,0 +1,283 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_ring.h"
+#include "debug.h"
+
+
+#define SHM_RING_MAGIC 0x52544252	/* "RBTR" */
+#define SHM_RING_VERSION 1
+/* The header gets a page of its own, slots start right after it */
+#define SHM_RING_HEADER_SIZE 4096
+
+/* GLib only has atomics for gint and pointers, the 64-bit counters use the compiler builtins */
+#define shm_ring_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define shm_ring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static gboolean shm_ring_map(shm_ring * ring, int fd, gsize size)
+{
+	void * base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (base == MAP_FAILED) {
+		JANUS_LOG(LOG_ERR, "Could not map shared ring: %s\n", g_strerror(errno));
+		return FALSE;
+	}
+
+	ring->fd = fd;
+	ring->size = size;
+	ring->header = (shm_ring_header *)base;
+	ring->slot = (shm_ring_slot *)((gchar *)base + SHM_RING_HEADER_SIZE);
+	return TRUE;
+}
+
+shm_ring * shm_ring_new(const gchar * name, guint slots, shm_ring_overrun overrun)
+{
+	shm_ring * ring;
+	gsize size;
+	int fd;
+
+	/* Power of two, so a sequence number maps to its slot with a mask */
+	slots = slots < 2 ? 2 : slots;
+	slots = 1U << g_bit_storage(slots - 1);
+	size = SHM_RING_HEADER_SIZE + (gsize)slots * sizeof(shm_ring_slot);
+
+	fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		JANUS_LOG(LOG_ERR, "Could not create shared ring memory: %s\n", g_strerror(errno));
+		return NULL;
+	}
+
+	/* Sealed, so a misbehaving producer cannot shrink it under us and fault the gateway with SIGBUS */
+	if (ftruncate(fd, size) < 0 ||
+		fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		JANUS_LOG(LOG_ERR, "Could not size shared ring memory: %s\n", g_strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	ring = g_malloc0(sizeof(shm_ring));
+	if (!shm_ring_map(ring, fd, size)) {
+		close(fd);
+		g_free(ring);
+		return NULL;
+	}
+
+	ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->event_fd < 0) {
+		JANUS_LOG(LOG_ERR, "Could not create shared ring eventfd: %s\n", g_strerror(errno));
+		ring->event_fd = -1;
+		shm_ring_free(ring);
+		return NULL;
+	}
+
+	ring->slots = slots;
+	ring->mask = slots - 1;
+	ring->header->magic = SHM_RING_MAGIC;
+	ring->header->version = SHM_RING_VERSION;
+	ring->header->slots = slots;
+	ring->header->overrun = overrun;
+	/* Nothing to read yet, so the first push must wake us up */
+	ring->header->consumer_waiting = 1;
+
+	return ring;
+}
+
+/* Producer side, e.g. in a transcoder process that received both descriptors; takes ownership of them */
+shm_ring * shm_ring_attach(int fd, int event_fd)
+{
+	shm_ring * ring;
+	shm_ring_header header;
+	struct stat st;
+
+	if (fstat(fd, &st) < 0 || (gsize)st.st_size < SHM_RING_HEADER_SIZE ||
+		pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		JANUS_LOG(LOG_ERR, "Invalid shared ring\n");
+		return NULL;
+	}
+
+	if (header.magic != SHM_RING_MAGIC || header.version != SHM_RING_VERSION ||
+		header.slots < 2 || (header.slots & (header.slots - 1)) || header.overrun >= SHM_RING_OVERRUN_MAX ||
+		(gsize)st.st_size != SHM_RING_HEADER_SIZE + (gsize)header.slots * sizeof(shm_ring_slot)) {
+		JANUS_LOG(LOG_ERR, "Shared ring header does not match its size\n");
+		return NULL;
+	}
+
+	ring = g_malloc0(sizeof(shm_ring));
+	if (!shm_ring_map(ring, fd, st.st_size)) {
+		g_free(ring);
+		return NULL;
+	}
+	ring->event_fd = event_fd;
+	ring->slots = header.slots;
+	ring->mask = header.slots - 1;
+
+	return ring;
+}
+
+void shm_ring_free(shm_ring * ring)
+{
+	if (!ring) {
+		return;
+	}
+
+	if (ring->header) {
+		munmap(ring->header, ring->size);
+	}
+	if (ring->fd >= 0) {
+		close(ring->fd);
+	}
+	if (ring->event_fd >= 0) {
+		close(ring->event_fd);
+	}
+	g_free(ring);
+}
+
+gboolean shm_ring_push(shm_ring * ring, const gchar * buf, gsize len)
+{
+	shm_ring_header * header = ring->header;
+	guint64 head = header->head;
+	shm_ring_slot * slot;
+
+	if (len > SHM_RING_MAX_PACKET) {
+		return FALSE;
+	}
+
+	if (header->overrun == SHM_RING_DROP_NEWEST && head - shm_ring_load(&header->tail) >= ring->slots) {
+		shm_ring_store(&header->dropped_newest, header->dropped_newest + 1);
+		return FALSE;
+	}
+
+	/* Seqlock style: a consumer reading this slot while we rewrite it sees the sequence change */
+	slot = &ring->slot[head & ring->mask];
+	shm_ring_store(&slot->seq, 0);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(slot->data, buf, len);
+	slot->length = len;
+	shm_ring_store(&slot->seq, head + 1);
+	shm_ring_store(&header->head, head + 1);
+	shm_ring_store(&header->pushed, header->pushed + 1);
+
+	/* Pairs with the barrier in shm_ring_prepare_wait(), one of us always sees the other */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (g_atomic_int_get(&header->consumer_waiting)) {
+		g_atomic_int_set(&header->consumer_waiting, 0);
+		shm_ring_kick(ring);
+	}
+
+	return TRUE;
+}
+
+/* Returns the packet length, -1 once the ring is empty. Slots that were
+ * overwritten while we were behind, or that do not make sense, are skipped and counted */
+gssize shm_ring_pop(shm_ring * ring, gchar * buf, gsize size, guint64 * seq)
+{
+	shm_ring_header * header = ring->header;
+	guint64 tail = header->tail;
+
+	for (;;) {
+		guint64 head = shm_ring_load(&header->head);
+		shm_ring_slot * slot;
+		guint64 first, last;
+		guint32 length;
+
+		if (head == tail) {
+			shm_ring_store(&header->tail, tail);
+			return -1;
+		}
+		if (head < tail) {
+			/* The producer went backwards, it restarted or it is broken: resync on its view */
+			ring->corrupt++;
+			shm_ring_store(&header->tail, head);
+			return -1;
+		}
+		if (head - tail > ring->slots) {
+			ring->dropped_oldest += head - tail - ring->slots;
+			tail = head - ring->slots;
+		}
+
+		slot = &ring->slot[tail & ring->mask];
+		first = shm_ring_load(&slot->seq);
+		length = slot->length;
+		if (first != tail + 1) {
+			/* Overwritten by a producer that lapped us, or being rewritten right now */
+			if (first == 0 || first > tail + 1) {
+				ring->dropped_oldest++;
+			}
+			else {
+				ring->corrupt++;
+			}
+			tail++;
+			continue;
+		}
+		if (length > SHM_RING_MAX_PACKET || length > size) {
+			ring->corrupt++;
+			tail++;
+			continue;
+		}
+
+		memcpy(buf, slot->data, length);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		last = shm_ring_load(&slot->seq);
+		tail++;
+		if (last != first) {
+			ring->dropped_oldest++;
+			continue;
+		}
+
+		shm_ring_store(&header->tail, tail);
+		ring->popped++;
+		if (seq) {
+			*seq = first - 1;
+		}
+		return length;
+	}
+}
+
+/* Returns FALSE if packets arrived meanwhile and the consumer should not go to sleep */
+gboolean shm_ring_prepare_wait(shm_ring * ring)
+{
+	g_atomic_int_set(&ring->header->consumer_waiting, 1);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (shm_ring_load(&ring->header->head) != ring->header->tail) {
+		g_atomic_int_set(&ring->header->consumer_waiting, 0);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void shm_ring_ack_wakeup(shm_ring * ring)
+{
+	guint64 value;
+
+	if (read(ring->event_fd, &value, sizeof(value)) == sizeof(value)) {
+		ring->wakeups++;
+	}
+}
+
+void shm_ring_kick(shm_ring * ring)
+{
+	guint64 one = 1;
+
+	if (write(ring->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+		JANUS_LOG(LOG_ERR, "Could not wake up shared ring consumer: %s\n", g_strerror(errno));
+	}
+}
+
+gint shm_ring_parse_overrun(const gchar * value)
+{
+	if (!value || !strcasecmp(value, "drop-oldest"))
+		return SHM_RING_DROP_OLDEST;
+	if (!strcasecmp(value, "drop-newest"))
+		return SHM_RING_DROP_NEWEST;
+	return -1;
+}
+
+const gchar * shm_ring_overrun_str(gint overrun)
+{
+	return overrun == SHM_RING_DROP_NEWEST ? "drop-newest" : "drop-oldest";
+}
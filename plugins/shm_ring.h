@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glib.h>
+
+#define SHM_RING_MAX_PACKET 1500
+
+/* What the producer does when the consumer is a full ring behind */
+typedef enum shm_ring_overrun {
+	SHM_RING_DROP_OLDEST = 0,	/* keep writing, the consumer skips what was overwritten */
+	SHM_RING_DROP_NEWEST,		/* refuse the new packet until the consumer catches up */
+	SHM_RING_OVERRUN_MAX
+} shm_ring_overrun;
+
+/* Everything below lives in the shared mapping and is written by the other process too,
+ * the consumer never trusts any of it beyond what it can bounds-check */
+typedef struct shm_ring_slot {
+	volatile guint64 seq;		/* packet sequence + 1 once complete, 0 while being written */
+	guint32 length;
+	guint32 reserved;
+	gchar data[SHM_RING_MAX_PACKET];
+} shm_ring_slot;
+
+typedef struct shm_ring_header {
+	guint32 magic;
+	guint32 version;
+	guint32 slots;
+	guint32 overrun;
+	/* producer cache line */
+	volatile guint64 head;
+	volatile guint64 pushed;
+	volatile guint64 dropped_newest;
+	guint64 producer_pad[5];
+	/* consumer cache line */
+	volatile guint64 tail;
+	volatile gint consumer_waiting;
+} shm_ring_header;
+
+/* Single producer, single consumer ring in a sealed memfd, with an eventfd to wake the consumer up */
+typedef struct shm_ring {
+	int fd;
+	int event_fd;
+	guint32 slots;
+	guint32 mask;
+	gsize size;
+	shm_ring_header *header;
+	shm_ring_slot *slot;
+	/* consumer side, private to this process */
+	guint64 popped;
+	guint64 dropped_oldest;
+	guint64 corrupt;
+	guint64 wakeups;
+} shm_ring;
+
+shm_ring * shm_ring_new(const gchar * name, guint slots, shm_ring_overrun overrun);
+shm_ring * shm_ring_attach(int fd, int event_fd);
+void shm_ring_free(shm_ring * ring);
+gboolean shm_ring_push(shm_ring * ring, const gchar * buf, gsize len);
+gssize shm_ring_pop(shm_ring * ring, gchar * buf, gsize size, guint64 * seq);
+gboolean shm_ring_prepare_wait(shm_ring * ring);
+void shm_ring_ack_wakeup(shm_ring * ring);
+void shm_ring_kick(shm_ring * ring);
+gint shm_ring_parse_overrun(const gchar * value);
+const gchar * shm_ring_overrun_str(gint overrun);
@@ -1,18 +1,70 @@
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 #include "socket_utils.h"
 #include "ports_pool.h"
 #include "debug.h"
 #include "mutex.h"
 
 
+/* Room for the SO_RXQ_OVFL counter */
+#define SOCKET_UTILS_CONTROL_SIZE CMSG_SPACE(sizeof(guint32))
+/* Events fetched per epoll_wait() and callback calls per socket per dispatch */
+#define SOCKET_UTILS_EPOLL_EVENTS 64
+#define SOCKET_UTILS_DISPATCH_BUDGET 16
+
+/* One per GMainContext: a single GSource polling the epoll fd on behalf of all its sockets */
+typedef struct socket_utils_reactor {
+	GSource source;
+	int epoll_fd;
+	gpointer epoll_tag;
+	GMainContext *context;
+	janus_mutex mutex;	/* held while dispatching, so a socket cannot be detached under its callback */
+	GQueue ready;		/* sockets whose callback stopped before draining them */
+} socket_utils_reactor;
+
+typedef struct socket_utils_watch {
+	socket_utils_socket *sck;
+	GSocketSourceFunc func;
+	gpointer data;
+	socket_utils_reactor *reactor;
+	gboolean queued;
+} socket_utils_watch;
+
 static janus_mutex ports_pool_mutex;
 static ports_pool * pp;
+static gint rcvbuf_size = 0;
+static gint sndbuf_size = 0;
+static gint rcvbuf_max = 0;
+static socket_utils_backend backend = SOCKET_UTILS_BACKEND_GLIB;
+static janus_mutex reactors_mutex;
+static GHashTable * reactors = NULL;
 
 static gboolean socket_utils_create_socket(socket_utils_socket * sck, gboolean is_client, int req_port);
+static gboolean socket_utils_wrap_fd(socket_utils_socket * sck, int fd, gboolean is_client);
+static void socket_utils_setup_buffers(socket_utils_socket * sck);
+static void socket_utils_check_overflow(socket_utils_socket * sck, struct msghdr * msg);
 
 void socket_utils_init(uint16_t udp_min_port, uint16_t udp_max_port)
 {
 	janus_mutex_init(&ports_pool_mutex);
 	ports_pool_init(&pp, udp_min_port, udp_max_port);
+	janus_mutex_init(&reactors_mutex);
+	reactors = g_hash_table_new(NULL, NULL);
+}
+
+static void socket_utils_reactor_destroy(gpointer key, gpointer value, gpointer user_data)
+{
+	socket_utils_reactor * reactor = (socket_utils_reactor *)value;
+	GMainContext * context = reactor->context;
+
+	if (!g_source_is_destroyed(&reactor->source)) {
+		g_source_destroy(&reactor->source);
+	}
+	g_source_unref(&reactor->source);
+	g_main_context_unref(context);
 }
 
 void socket_utils_destroy(void)
@@ -20,6 +72,126 @@ void socket_utils_destroy(void)
 	janus_mutex_lock(&ports_pool_mutex);
 	ports_pool_free(pp);
 	janus_mutex_unlock(&ports_pool_mutex);
+
+	janus_mutex_lock(&reactors_mutex);
+	g_hash_table_foreach(reactors, socket_utils_reactor_destroy, NULL);
+	g_hash_table_destroy(reactors);
+	reactors = NULL;
+	janus_mutex_unlock(&reactors_mutex);
+}
+
+void socket_utils_set_backend(socket_utils_backend value)
+{
+	backend = value;
+}
+
+gint socket_utils_parse_backend(const gchar * value)
+{
+	if (!value || !strcasecmp(value, "glib"))
+		return SOCKET_UTILS_BACKEND_GLIB;
+	if (!strcasecmp(value, "epoll"))
+		return SOCKET_UTILS_BACKEND_EPOLL;
+	return -1;
+}
+
+const gchar * socket_utils_backend_str(gint value)
+{
+	return value == SOCKET_UTILS_BACKEND_EPOLL ? "epoll" : "glib";
+}
+
+/* 0 keeps the kernel defaults; receive buffers are doubled up to rcvbuf_max whenever the kernel drops datagrams */
+void socket_utils_set_buffer_sizes(gint rcvbuf, gint sndbuf, gint max_rcvbuf)
+{
+	rcvbuf_size = rcvbuf;
+	sndbuf_size = sndbuf;
+	rcvbuf_max = max_rcvbuf;
+}
+
+/* SO_RCVBUFFORCE goes past net.core.rmem_max when we have CAP_NET_ADMIN */
+static gboolean socket_utils_set_rcvbuf(int fd, gint size)
+{
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == 0) {
+		return TRUE;
+	}
+	return setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == 0;
+}
+
+static gint socket_utils_get_rcvbuf(int fd)
+{
+	gint size = 0;
+	socklen_t len = sizeof(size);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0) {
+		return 0;
+	}
+	return size / 2;
+}
+
+static void socket_utils_setup_buffers(socket_utils_socket * sck)
+{
+	int fd = g_socket_get_fd(sck->socket);
+	int on = 1;
+
+	sck->overflows = 0;
+	sck->drops = 0;
+	sck->rcvbuf_grows = 0;
+	sck->last_grow = 0;
+
+	if (rcvbuf_size > 0 && !socket_utils_set_rcvbuf(fd, rcvbuf_size)) {
+		JANUS_LOG(LOG_WARN, "Could not set receive buffer to %d: %s\n", rcvbuf_size, g_strerror(errno));
+	}
+	if (sndbuf_size > 0 && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf_size, sizeof(sndbuf_size)) < 0) {
+		JANUS_LOG(LOG_WARN, "Could not set send buffer to %d: %s\n", sndbuf_size, g_strerror(errno));
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+		JANUS_LOG(LOG_WARN, "Could not enable drop reporting: %s\n", g_strerror(errno));
+	}
+	sck->rcvbuf = socket_utils_get_rcvbuf(fd);
+}
+
+/* At most once a second, so a single burst does not take the buffer straight to the maximum */
+static void socket_utils_grow_rcvbuf(socket_utils_socket * sck)
+{
+	gint64 now = g_get_monotonic_time();
+	int fd = g_socket_get_fd(sck->socket);
+	gint size;
+
+	if (!rcvbuf_max || sck->rcvbuf >= rcvbuf_max || now - sck->last_grow < G_USEC_PER_SEC) {
+		return;
+	}
+	sck->last_grow = now;
+
+	size = MIN(sck->rcvbuf * 2, rcvbuf_max);
+	if (!socket_utils_set_rcvbuf(fd, size)) {
+		JANUS_LOG(LOG_WARN, "Could not grow receive buffer on port %d: %s\n", sck->port, g_strerror(errno));
+		return;
+	}
+	size = socket_utils_get_rcvbuf(fd);
+	if (size > sck->rcvbuf) {
+		sck->rcvbuf_grows++;
+		JANUS_LOG(LOG_INFO, "Kernel dropped %"G_GUINT64_FORMAT" datagrams on port %d so far, receive buffer grown to %d\n",
+			sck->drops, sck->port, size);
+	}
+	sck->rcvbuf = size;
+}
+
+/* The kernel attaches its running drop counter to every datagram once it is non zero */
+static void socket_utils_check_overflow(socket_utils_socket * sck, struct msghdr * msg)
+{
+	struct cmsghdr * cmsg;
+	guint32 overflows;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL) {
+			continue;
+		}
+		memcpy(&overflows, CMSG_DATA(cmsg), sizeof(overflows));
+		if (overflows != sck->overflows) {
+			sck->drops += (guint32)(overflows - sck->overflows);
+			sck->overflows = overflows;
+			socket_utils_grow_rcvbuf(sck);
+		}
+	}
 }
 
 gboolean socket_utils_create_client_socket(socket_utils_socket * sck, int port_to_connect) {
@@ -30,6 +202,48 @@ gboolean socket_utils_create_server_socket(socket_utils_socket * sck) {
 	return socket_utils_create_socket(sck, FALSE, 0);
 }
 
+static gboolean socket_utils_wrap_fd(socket_utils_socket * sck, int fd, gboolean is_client) {
+	GError *error = NULL;
+
+	sck->source = NULL;
+	sck->watch = NULL;
+	sck->port = 0;
+	sck->is_client = is_client;
+	sck->socket = g_socket_new_from_fd(fd, &error);
+
+	if (!sck->socket) {
+		JANUS_LOG(LOG_ERR, "Error wrapping socket: %s\n", error->message);
+		g_error_free(error);
+		close(fd);
+		return FALSE;
+	}
+
+	socket_utils_setup_buffers(sck);
+	return TRUE;
+}
+
+/* Connected AF_UNIX SOCK_SEQPACKET pair: keeps datagram boundaries and takes no port from the pool */
+gboolean socket_utils_create_socket_pair(socket_utils_socket * local, socket_utils_socket * remote) {
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		JANUS_LOG(LOG_ERR, "Error creating socket pair: %s\n", g_strerror(errno));
+		return FALSE;
+	}
+
+	if (!socket_utils_wrap_fd(local, fds[0], FALSE)) {
+		close(fds[1]);
+		return FALSE;
+	}
+
+	if (!socket_utils_wrap_fd(remote, fds[1], TRUE)) {
+		socket_utils_close_socket(local);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean socket_utils_create_socket(socket_utils_socket * sck, gboolean is_client, int req_port) {
 
 	GSocketAddress * address = NULL;
@@ -38,6 +252,7 @@ static gboolean socket_utils_create_socket(socket_utils_socket * sck, gboolean i
 	int port;
 
 	sck->source = NULL;
+	sck->watch = NULL;
 
 	sck->socket = g_socket_new(G_SOCKET_FAMILY_IPV4,
 		G_SOCKET_TYPE_DATAGRAM,
@@ -50,6 +265,8 @@ static gboolean socket_utils_create_socket(socket_utils_socket * sck, gboolean i
 		JANUS_LOG(LOG_ERR, "Error creating socket\n");
 		return FALSE;
 	}
+
+	socket_utils_setup_buffers(sck);
 	
 	do
 	{
@@ -116,7 +333,7 @@ static gboolean socket_utils_create_socket(socket_utils_socket * sck, gboolean i
 
 void socket_utils_close_socket(socket_utils_socket * sck) {
 	
-	if (sck->source) {
+	if (sck->source || sck->watch) {
 		socket_utils_deattach_callback(sck);
 	}
 	
@@ -125,22 +342,336 @@ void socket_utils_close_socket(socket_utils_socket * sck) {
 		g_clear_object(&sck->socket);
 	}
 	
-	janus_mutex_lock(&ports_pool_mutex);
-	ports_pool_return(pp, sck->port);
-	janus_mutex_unlock(&ports_pool_mutex);
+	/* client sockets borrow the port of the server socket they are connected to */
+	if (sck->port && !sck->is_client) {
+		janus_mutex_lock(&ports_pool_mutex);
+		ports_pool_return(pp, sck->port);
+		janus_mutex_unlock(&ports_pool_mutex);
+		sck->port = 0;
+	}
+}
+
+/* Calls the callback again while it keeps finding data, edge-triggered epoll
+ * will not report the socket again until it has been read to EAGAIN */
+static void socket_utils_reactor_invoke(socket_utils_reactor * reactor, socket_utils_watch * watch)
+{
+	for (guint i = 0; i < SOCKET_UTILS_DISPATCH_BUDGET; i++) {
+		watch->sck->drained = TRUE;
+		watch->func(watch->sck->socket, G_IO_IN, watch->data);
+		if (watch->sck->drained) {
+			return;
+		}
+	}
+
+	/* Out of budget: finish it on the next iteration, after the other sockets had their turn */
+	watch->queued = TRUE;
+	g_queue_push_tail(&reactor->ready, watch);
+}
+
+static gboolean socket_utils_reactor_prepare(GSource * source, gint * timeout)
+{
+	socket_utils_reactor * reactor = (socket_utils_reactor *)source;
+	gboolean ready;
+
+	janus_mutex_lock(&reactor->mutex);
+	ready = !g_queue_is_empty(&reactor->ready);
+	janus_mutex_unlock(&reactor->mutex);
+
+	*timeout = ready ? 0 : -1;
+	return ready;
+}
+
+static gboolean socket_utils_reactor_check(GSource * source)
+{
+	socket_utils_reactor * reactor = (socket_utils_reactor *)source;
+	gboolean ready;
+
+	janus_mutex_lock(&reactor->mutex);
+	ready = !g_queue_is_empty(&reactor->ready);
+	janus_mutex_unlock(&reactor->mutex);
+
+	return ready || (g_source_query_unix_fd(source, reactor->epoll_tag) & G_IO_IN);
+}
+
+static gboolean socket_utils_reactor_dispatch(GSource * source, GSourceFunc callback, gpointer user_data)
+{
+	socket_utils_reactor * reactor = (socket_utils_reactor *)source;
+	struct epoll_event events[SOCKET_UTILS_EPOLL_EVENTS];
+	guint pending;
+	int count;
+
+	janus_mutex_lock(&reactor->mutex);
+
+	pending = g_queue_get_length(&reactor->ready);
+	for (guint i = 0; i < pending; i++) {
+		socket_utils_watch * watch = g_queue_pop_head(&reactor->ready);
+		watch->queued = FALSE;
+		socket_utils_reactor_invoke(reactor, watch);
+	}
+
+	do {
+		count = epoll_wait(reactor->epoll_fd, events, SOCKET_UTILS_EPOLL_EVENTS, 0);
+	} while (count < 0 && errno == EINTR);
+
+	for (int i = 0; i < count; i++) {
+		socket_utils_watch * watch = (socket_utils_watch *)events[i].data.ptr;
+		if (!watch->queued) {
+			socket_utils_reactor_invoke(reactor, watch);
+		}
+	}
+
+	janus_mutex_unlock(&reactor->mutex);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void socket_utils_reactor_finalize(GSource * source)
+{
+	socket_utils_reactor * reactor = (socket_utils_reactor *)source;
+
+	close(reactor->epoll_fd);
+	g_queue_clear(&reactor->ready);
+	janus_mutex_destroy(&reactor->mutex);
+}
+
+static GSourceFuncs socket_utils_reactor_funcs = {
+	socket_utils_reactor_prepare,
+	socket_utils_reactor_check,
+	socket_utils_reactor_dispatch,
+	socket_utils_reactor_finalize,
+	NULL,
+	NULL
+};
+
+/* Reactors live until socket_utils_destroy(), they keep their context alive
+ * so that its address cannot be reused by another one in the meantime */
+static socket_utils_reactor * socket_utils_get_reactor(GMainContext * context)
+{
+	socket_utils_reactor * reactor;
+	int epoll_fd;
+
+	janus_mutex_lock(&reactors_mutex);
+	reactor = g_hash_table_lookup(reactors, context);
+	if (reactor) {
+		janus_mutex_unlock(&reactors_mutex);
+		return reactor;
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		janus_mutex_unlock(&reactors_mutex);
+		JANUS_LOG(LOG_ERR, "Could not create epoll instance: %s\n", g_strerror(errno));
+		return NULL;
+	}
+
+	reactor = (socket_utils_reactor *)g_source_new(&socket_utils_reactor_funcs, sizeof(socket_utils_reactor));
+	reactor->epoll_fd = epoll_fd;
+	reactor->context = g_main_context_ref(context);
+	janus_mutex_init(&reactor->mutex);
+	g_queue_init(&reactor->ready);
+	reactor->epoll_tag = g_source_add_unix_fd(&reactor->source, epoll_fd, G_IO_IN);
+	g_source_attach(&reactor->source, context);
+	g_hash_table_insert(reactors, context, reactor);
+	janus_mutex_unlock(&reactors_mutex);
+
+	return reactor;
 }
 
 void socket_utils_attach_callback(socket_utils_socket * sck, GSourceFunc func, gpointer * user_data) {
+	socket_utils_attach_callback_to_context(sck, func, user_data, NULL);
+}
+
+void socket_utils_attach_callback_to_context(socket_utils_socket * sck, GSourceFunc func, gpointer * user_data, GMainContext * context) {
+	socket_utils_reactor * reactor;
+	socket_utils_watch * watch;
+	struct epoll_event event;
+
+	context = context ? context : g_main_context_default();
+
+	if (backend == SOCKET_UTILS_BACKEND_EPOLL && (reactor = socket_utils_get_reactor(context))) {
+		watch = g_malloc0(sizeof(socket_utils_watch));
+		watch->sck = sck;
+		watch->func = (GSocketSourceFunc)func;
+		watch->data = user_data;
+		watch->reactor = reactor;
+
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN | EPOLLET;
+		event.data.ptr = watch;
+		if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, g_socket_get_fd(sck->socket), &event) == 0) {
+			sck->watch = watch;
+			return;
+		}
+		JANUS_LOG(LOG_ERR, "Could not add socket to epoll, falling back to a GSource: %s\n", g_strerror(errno));
+		g_free(watch);
+	}
+
 	sck->source = g_socket_create_source(sck->socket, G_IO_IN, NULL);
 	g_assert(sck->source);
 	g_source_set_callback(sck->source, func, user_data, NULL);
-	g_source_attach(sck->source, g_main_context_default());
+	g_source_attach(sck->source, context);
 }
 
 void socket_utils_deattach_callback(socket_utils_socket * sck) {
+	socket_utils_watch * watch = sck->watch;
+
+	if (watch) {
+		socket_utils_reactor * reactor = watch->reactor;
+		janus_mutex_lock(&reactor->mutex);
+		if (sck->socket) {
+			epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, g_socket_get_fd(sck->socket), NULL);
+		}
+		if (watch->queued) {
+			g_queue_remove(&reactor->ready, watch);
+		}
+		janus_mutex_unlock(&reactor->mutex);
+		g_free(watch);
+		sck->watch = NULL;
+	}
+
 	if (sck->source) {
 		g_source_destroy(sck->source);
 		g_source_unref(sck->source);
 		sck->source = NULL;
 	}
 }
+
+static void socket_utils_batch_set_packet(socket_utils_batch * batch, guint i, packet_buffer * packet) {
+	batch->packets[i] = packet;
+	batch->iovecs[i].iov_base = packet->data;
+	batch->iovecs[i].iov_len = SOCKET_UTILS_MAX_PACKET;
+}
+
+void socket_utils_batch_init(socket_utils_batch * batch, guint size) {
+	batch->size = size ? size : 1;
+	batch->packets = g_new0(packet_buffer *, batch->size);
+	batch->iovecs = g_new0(struct iovec, batch->size);
+	batch->msgs = g_new0(struct mmsghdr, batch->size);
+	batch->controls = g_malloc0(batch->size * SOCKET_UTILS_CONTROL_SIZE);
+
+	for (guint i = 0; i < batch->size; i++) {
+		socket_utils_batch_set_packet(batch, i, packet_pool_acquire());
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		batch->msgs[i].msg_hdr.msg_control = batch->controls + i * SOCKET_UTILS_CONTROL_SIZE;
+	}
+}
+
+void socket_utils_batch_free(socket_utils_batch * batch) {
+	for (guint i = 0; batch->packets && i < batch->size; i++) {
+		packet_buffer_unref(batch->packets[i]);
+	}
+	g_free(batch->packets);
+	g_free(batch->iovecs);
+	g_free(batch->msgs);
+	g_free(batch->controls);
+	memset(batch, 0, sizeof(*batch));
+}
+
+/* Single datagram receive that also keeps track of kernel drops, -1 if nothing was pending */
+gssize socket_utils_receive(socket_utils_socket * sck, gchar * buf, gsize size) {
+	gchar control[SOCKET_UTILS_CONTROL_SIZE];
+	struct iovec iov = { buf, size };
+	struct msghdr msg;
+	gssize received;
+
+	if (!sck->socket) {
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do {
+		received = recvmsg(g_socket_get_fd(sck->socket), &msg, MSG_DONTWAIT);
+	} while (received < 0 && errno == EINTR);
+
+	if (received < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			JANUS_LOG(LOG_ERR, "recvmsg failed on port %d: %s\n", sck->port, g_strerror(errno));
+		}
+		sck->drained = TRUE;
+		return -1;
+	}
+
+	sck->drained = FALSE;
+	socket_utils_check_overflow(sck, &msg);
+	return received;
+}
+
+/* Never blocks the caller: a datagram that does not fit in the socket buffer is dropped and counted */
+gssize socket_utils_send(socket_utils_socket * sck, const gchar * buf, gsize size) {
+	gssize sent;
+
+	if (!sck->socket) {
+		return -1;
+	}
+
+	do {
+		sent = send(g_socket_get_fd(sck->socket), buf, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+	} while (sent < 0 && errno == EINTR);
+
+	if (sent < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			sck->drops++;
+		}
+		else {
+			JANUS_LOG(LOG_ERR, "send failed: %s\n", g_strerror(errno));
+		}
+	}
+
+	return sent;
+}
+
+/* Returns the number of datagrams now sitting in the batch, 0 if none were pending */
+gint socket_utils_receive_batch(socket_utils_socket * sck, socket_utils_batch * batch) {
+	int fd;
+	int received;
+
+	if (!sck->socket || !batch->size) {
+		return 0;
+	}
+
+	fd = g_socket_get_fd(sck->socket);
+
+	for (guint i = 0; i < batch->size; i++) {
+		batch->msgs[i].msg_hdr.msg_controllen = SOCKET_UTILS_CONTROL_SIZE;
+	}
+
+	do {
+		received = recvmmsg(fd, batch->msgs, batch->size, MSG_DONTWAIT, NULL);
+	} while (received < 0 && errno == EINTR);
+
+	/* A short batch means the queue was emptied */
+	sck->drained = received < (int)batch->size;
+
+	if (received < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			JANUS_LOG(LOG_ERR, "recvmmsg failed on port %d: %s\n", sck->port, g_strerror(errno));
+		}
+		return 0;
+	}
+
+	for (gint i = 0; i < received; i++) {
+		batch->packets[i]->length = batch->msgs[i].msg_len;
+	}
+	/* The counter only grows, the last datagram carries the latest value */
+	if (received > 0) {
+		socket_utils_check_overflow(sck, &batch->msgs[received - 1].msg_hdr);
+	}
+
+	return received;
+}
+
+/* Slots whose packet is still referenced elsewhere get a fresh buffer, the others are reused as they are */
+void socket_utils_batch_recycle(socket_utils_batch * batch, guint count) {
+	for (guint i = 0; i < count && i < batch->size; i++) {
+		if (g_atomic_int_get(&batch->packets[i]->ref) > 1) {
+			packet_buffer_unref(batch->packets[i]);
+			socket_utils_batch_set_packet(batch, i, packet_pool_acquire());
+		}
+	}
+}
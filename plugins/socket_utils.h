@@ -2,18 +2,62 @@
 
 #include <gio/gio.h>
 #include <stdint.h>
+#include <sys/socket.h>
+#include "packet_pool.h"
+
+#define SOCKET_UTILS_MAX_PACKET PACKET_POOL_BUFFER_SIZE
+
+/* How attached callbacks are dispatched */
+typedef enum socket_utils_backend {
+	SOCKET_UTILS_BACKEND_GLIB = 0,	/* one GSource per socket */
+	SOCKET_UTILS_BACKEND_EPOLL,	/* one edge-triggered epoll instance per GMainContext */
+	SOCKET_UTILS_BACKEND_MAX
+} socket_utils_backend;
+
+struct socket_utils_watch;
 
 typedef struct socket_utils_socket {
 	int port;
 	GSocket *socket;
 	gboolean is_client;
 	GSource *source;
+	struct socket_utils_watch *watch;	/* epoll backend registration, instead of source */
+	gboolean drained;	/* last receive found the socket empty */
+	gint rcvbuf;		/* SO_RCVBUF as requested, the kernel reserves twice as much */
+	guint32 overflows;	/* last SO_RXQ_OVFL counter reported by the kernel */
+	guint64 drops;		/* datagrams dropped because the receive (or, for pairs, send) buffer was full */
+	guint rcvbuf_grows;
+	gint64 last_grow;
 } socket_utils_socket;
 
+/* Receive slots for draining a datagram socket with a single recvmmsg(),
+ * each slot holds a pool buffer that can be kept past the callback with packet_buffer_ref() */
+typedef struct socket_utils_batch {
+	guint size;
+	packet_buffer **packets;
+	struct iovec *iovecs;
+	struct mmsghdr *msgs;
+	gchar *controls;
+} socket_utils_batch;
+
+#define socket_utils_batch_packet(batch, i) ((batch)->packets[i])
+
 void socket_utils_init(uint16_t udp_min_port, uint16_t udp_max_port);
 void socket_utils_destroy(void);
+void socket_utils_set_buffer_sizes(gint rcvbuf, gint sndbuf, gint rcvbuf_max);
+void socket_utils_set_backend(socket_utils_backend backend);
+gint socket_utils_parse_backend(const gchar * value);
+const gchar * socket_utils_backend_str(gint backend);
 gboolean socket_utils_create_client_socket(socket_utils_socket * sck, int port_to_connect);
 gboolean socket_utils_create_server_socket(socket_utils_socket * sck);
+gboolean socket_utils_create_socket_pair(socket_utils_socket * local, socket_utils_socket * remote);
 void socket_utils_close_socket(socket_utils_socket * sck);
 void socket_utils_attach_callback(socket_utils_socket * sck, GSourceFunc func, gpointer * user_data);
+void socket_utils_attach_callback_to_context(socket_utils_socket * sck, GSourceFunc func, gpointer * user_data, GMainContext * context);
 void socket_utils_deattach_callback(socket_utils_socket * sck);
+void socket_utils_batch_init(socket_utils_batch * batch, guint size);
+void socket_utils_batch_free(socket_utils_batch * batch);
+gssize socket_utils_receive(socket_utils_socket * sck, gchar * buf, gsize size);
+gssize socket_utils_send(socket_utils_socket * sck, const gchar * buf, gsize size);
+gint socket_utils_receive_batch(socket_utils_socket * sck, socket_utils_batch * batch);
+void socket_utils_batch_recycle(socket_utils_batch * batch, guint count);
@@ -0,0 +1,201 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "temporal_layers.h"
+#include "../rtp.h"
+#include "debug.h"
+
+
+/* Share of the estimate the forwarded layers may use */
+#define TEMPORAL_LAYERS_HEADROOM_PERCENT 90
+
+/* Cumulative share of the stream bitrate up to each layer, as configured on the encoder */
+static const guint temporal_layers_shares[TEMPORAL_LAYERS_MAX][TEMPORAL_LAYERS_MAX] = {
+	{ 100 },
+	{ 60, 100 },
+	{ 40, 60, 100 },
+	{ 25, 40, 60, 100 },
+};
+
+/* RFC 7741 payload descriptor; FALSE when the payload is too short for it */
+gboolean temporal_layers_parse_vp8(const guint8 * p, gint plen, temporal_layers_vp8_info * info)
+{
+	gint offset = 1;
+
+	info->frame_start = FALSE;
+	info->has_tid = FALSE;
+	info->tid = 0;
+	info->layer_sync = FALSE;
+	info->picture_id = -1;
+	info->picture_id_offset = 0;
+	info->picture_id_long = FALSE;
+
+	if (plen < 1) {
+		return FALSE;
+	}
+	info->frame_start = (p[0] & 0x10) && !(p[0] & 0x07);
+	if (!(p[0] & 0x80)) {
+		return TRUE;
+	}
+
+	if (plen < 2) {
+		return FALSE;
+	}
+	guint8 x = p[1];
+	offset++;
+	if (x & 0x80) {
+		if (offset >= plen) {
+			return FALSE;
+		}
+		info->picture_id_offset = offset;
+		if (p[offset] & 0x80) {
+			if (offset + 1 >= plen) {
+				return FALSE;
+			}
+			info->picture_id_long = TRUE;
+			info->picture_id = ((p[offset] & 0x7f) << 8) | p[offset + 1];
+			offset += 2;
+		}
+		else {
+			info->picture_id = p[offset] & 0x7f;
+			offset++;
+		}
+	}
+	if (x & 0x40) {
+		offset++;
+	}
+	if (x & 0x30) {
+		if (offset >= plen) {
+			return FALSE;
+		}
+		if (x & 0x20) {
+			info->has_tid = TRUE;
+			info->tid = p[offset] >> 6;
+			info->layer_sync = (p[offset] & 0x20) != 0;
+		}
+	}
+
+	return TRUE;
+}
+
+void temporal_layers_filter_reset(temporal_layers_filter * filter)
+{
+	g_atomic_int_set(&filter->target_layer, TEMPORAL_LAYERS_MAX - 1);
+	filter->max_layer = TEMPORAL_LAYERS_MAX - 1;
+	filter->switched = 0;
+	filter->seq_offset = 0;
+	filter->picture_id_offset = 0;
+	filter->last_dropped_picture_id = -1;
+	memset(filter->sent, 0, sizeof(filter->sent));
+}
+
+/* Called on the relay path for each video packet of the viewer; FALSE when it is dropped */
+gboolean temporal_layers_filter_forward(temporal_layers_filter * filter, const temporal_layers_vp8_info * info)
+{
+	if (!info->has_tid) {
+		return TRUE;
+	}
+
+	/* Going down is safe on any frame, going up only where the layer can be decoded from */
+	gint target = g_atomic_int_get(&filter->target_layer);
+	if (target != filter->max_layer && info->frame_start && (target < filter->max_layer || info->tid == 0 || info->layer_sync)) {
+		filter->max_layer = target;
+	}
+
+	if (info->tid <= filter->max_layer) {
+		return TRUE;
+	}
+
+	filter->seq_offset++;
+	filter->dropped++;
+	if (info->picture_id >= 0 && info->picture_id != filter->last_dropped_picture_id) {
+		filter->picture_id_offset++;
+		filter->last_dropped_picture_id = info->picture_id;
+	}
+
+	return FALSE;
+}
+
+/* Records the offsets a forwarded packet goes out with, seq being the source's number.
+ * The offsets keep growing as layers are dropped, so a NACK can only be mapped back
+ * with the ones in effect when the packet was sent */
+void temporal_layers_filter_sent(temporal_layers_filter * filter, guint16 seq)
+{
+	guint16 sent = seq - filter->seq_offset;
+	temporal_layers_sent * slot = &filter->sent[sent % TEMPORAL_LAYERS_SENT_SLOTS];
+
+	slot->seq = sent;
+	slot->seq_offset = filter->seq_offset;
+	slot->picture_id_offset = filter->picture_id_offset;
+	slot->valid = 1;
+}
+
+/* FALSE when the viewer's sequence number is not in the history anymore */
+gboolean temporal_layers_filter_sent_offsets(const temporal_layers_filter * filter, guint16 seq, guint16 * seq_offset, guint16 * picture_id_offset)
+{
+	const temporal_layers_sent * slot = &filter->sent[seq % TEMPORAL_LAYERS_SENT_SLOTS];
+
+	if (!slot->valid || slot->seq != seq) {
+		return FALSE;
+	}
+	*seq_offset = slot->seq_offset;
+	*picture_id_offset = slot->picture_id_offset;
+	return TRUE;
+}
+
+/* Closes the gaps left by the dropped packets, on the viewer's own copy of the packet, with
+ * the offsets in effect when it was forwarded */
+void temporal_layers_rewrite(guint16 seq_offset, guint16 picture_id_offset, char * buf, int len, const temporal_layers_vp8_info * info)
+{
+	rtp_header * rtp = (rtp_header *)buf;
+	int plen = 0;
+	guint8 * payload = (guint8 *)janus_rtp_payload(buf, len, &plen);
+
+	rtp->seq_number = htons(ntohs(rtp->seq_number) - seq_offset);
+
+	if (!payload || info->picture_id < 0) {
+		return;
+	}
+	guint8 * pid = payload + info->picture_id_offset;
+	if (info->picture_id_long) {
+		guint16 value = (info->picture_id - picture_id_offset) & 0x7fff;
+		pid[0] = 0x80 | (value >> 8);
+		pid[1] = value & 0xff;
+	}
+	else {
+		pid[0] = (info->picture_id - picture_id_offset) & 0x7f;
+	}
+}
+
+/* Cumulative percentage of the stream bitrate carried by layers 0..layer */
+guint temporal_layers_share(guint layers, guint layer)
+{
+	layers = CLAMP(layers, 1, TEMPORAL_LAYERS_MAX);
+	return temporal_layers_shares[layers - 1][MIN(layer, layers - 1)];
+}
+
+/* Highest layer whose cumulative bitrate fits the viewer's estimate; upgrades only when allowed */
+gint temporal_layers_select(guint layers, gint current, guint64 stream_bitrate, guint64 estimate, gboolean may_upgrade)
+{
+	gint target = 0;
+
+	if (layers < 2 || !stream_bitrate || !estimate) {
+		return current;
+	}
+
+	guint64 usable = estimate * TEMPORAL_LAYERS_HEADROOM_PERCENT / 100;
+	for (gint layer = layers - 1; layer >= 0; layer--) {
+		if (stream_bitrate * temporal_layers_share(layers, layer) / 100 <= usable) {
+			target = layer;
+			break;
+		}
+	}
+	/* Everything the encoder produces, beyond it nothing changes */
+	if (target == (gint)layers - 1) {
+		target = TEMPORAL_LAYERS_MAX - 1;
+	}
+
+	if (target > current && !may_upgrade) {
+		return current;
+	}
+	return target;
+}
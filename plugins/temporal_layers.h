@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glib.h>
+
+/* VP8 carries at most four temporal layers (2 bit TID) */
+#define TEMPORAL_LAYERS_MAX 4
+
+/* What the VP8 payload descriptor says about a packet */
+typedef struct temporal_layers_vp8_info {
+	gboolean frame_start;		/* S bit set on partition 0 */
+	gboolean has_tid;
+	gint tid;
+	gboolean layer_sync;		/* Y bit */
+	gint picture_id;		/* -1 when absent */
+	gint picture_id_offset;		/* byte offset of the PictureID in the payload */
+	gboolean picture_id_long;	/* 15 bit PictureID */
+} temporal_layers_vp8_info;
+
+/* Same depth as the NACK history, older sequence numbers cannot be retransmitted anyway */
+#define TEMPORAL_LAYERS_SENT_SLOTS 1024
+
+/* Offsets in effect when a sequence number went out to the viewer */
+typedef struct temporal_layers_sent {
+	guint16 seq;			/* as seen by the viewer */
+	guint16 seq_offset;
+	guint16 picture_id_offset;
+	guint16 valid;
+} temporal_layers_sent;
+
+/* Per-viewer state: which layers are forwarded and how far the stream has been shifted */
+typedef struct temporal_layers_filter {
+	volatile gint target_layer;	/* highest TID wanted, set from the viewer's REMB */
+	gint max_layer;			/* highest TID forwarded, follows target on layer boundaries */
+	gint64 switched;
+	guint16 seq_offset;		/* packets dropped so far */
+	guint16 picture_id_offset;	/* pictures dropped so far */
+	gint last_dropped_picture_id;
+	guint64 dropped;
+	temporal_layers_sent sent[TEMPORAL_LAYERS_SENT_SLOTS];	/* indexed by the viewer's sequence number */
+} temporal_layers_filter;
+
+gboolean temporal_layers_parse_vp8(const guint8 * payload, gint plen, temporal_layers_vp8_info * info);
+void temporal_layers_filter_reset(temporal_layers_filter * filter);
+gboolean temporal_layers_filter_forward(temporal_layers_filter * filter, const temporal_layers_vp8_info * info);
+void temporal_layers_filter_sent(temporal_layers_filter * filter, guint16 seq);
+gboolean temporal_layers_filter_sent_offsets(const temporal_layers_filter * filter, guint16 seq, guint16 * seq_offset, guint16 * picture_id_offset);
+void temporal_layers_rewrite(guint16 seq_offset, guint16 picture_id_offset, char * buf, int len, const temporal_layers_vp8_info * info);
+guint temporal_layers_share(guint layers, guint layer);
+gint temporal_layers_select(guint layers, gint current, guint64 stream_bitrate, guint64 estimate, gboolean may_upgrade);
@@ -0,0 +1,26 @@
+#include "trace.h"
+
+
+void trace_counter_report(trace_counter * counter, gint64 now)
+{
+	gint hits;
+
+	if (!counter->last_report) {
+		counter->last_report = now;
+		return;
+	}
+	if (now - counter->last_report < TRACE_COUNTER_INTERVAL) {
+		return;
+	}
+
+	do {
+		hits = g_atomic_int_get(&counter->pending);
+	} while (hits && !g_atomic_int_compare_and_exchange(&counter->pending, hits, 0));
+
+	if (hits) {
+		counter->total += hits;
+		JANUS_LOG(counter->level, "%s: %d times in the last %"G_GINT64_FORMAT" ms (%"G_GUINT64_FORMAT" total)\n",
+			counter->what, hits, (now - counter->last_report) / 1000, counter->total);
+	}
+	counter->last_report = now;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glib.h>
+#include "debug.h"
+
+/* Hot-path traces are only compiled in up to this level,
+ * pick it at configure time with --with-streaming-trace-level */
+#ifndef STREAMING_TRACE_LEVEL
+#define STREAMING_TRACE_LEVEL LOG_NONE
+#endif
+
+#define STREAMING_TRACE(level, format, ...) \
+do { \
+	if (level <= STREAMING_TRACE_LEVEL) { \
+		JANUS_LOG(level, format, ##__VA_ARGS__); \
+	} \
+} while (0)
+
+#define TRACE_COUNTER_INTERVAL (5 * G_USEC_PER_SEC)
+
+/* Counts a per-packet condition and logs it at most once per interval, as an aggregate */
+typedef struct trace_counter {
+	const gchar *what;
+	int level;
+	volatile gint pending;		/* hits since the last report */
+	guint64 total;
+	gint64 last_report;
+} trace_counter;
+
+#define TRACE_COUNTER_INIT(level, what) { (what), (level), 0, 0, 0 }
+
+#define trace_counter_hit(counter) g_atomic_int_inc(&(counter)->pending)
+
+void trace_counter_report(trace_counter * counter, gint64 now);
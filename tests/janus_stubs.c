@@ -0,0 +1,54 @@
+/* What the plugin sources take from the gateway, for the tests that link them without it */
+
+#include <arpa/inet.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include "../debug.h"
+#include "../mutex.h"
+#include "../rtp.h"
+#include "../utils.h"
+
+int janus_log_level = LOG_ERR;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+int lock_debug = 0;
+
+void janus_vprintf(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+gint64 janus_get_monotonic_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * G_GINT64_CONSTANT(1000000)) + (ts.tv_nsec / G_GINT64_CONSTANT(1000));
+}
+
+/* Same as the gateway's: skips the CSRCs and the header extension */
+char *janus_rtp_payload(char *buf, int len, int *plen)
+{
+	if (!buf || len < 12)
+		return NULL;
+
+	rtp_header *rtp = (rtp_header *)buf;
+	int hlen = 12;
+	if (rtp->csrccount)
+		hlen += rtp->csrccount * 4;
+	if (rtp->extension) {
+		janus_rtp_header_extension *ext = (janus_rtp_header_extension *)(buf + hlen);
+		int extlen = ntohs(ext->length) * 4;
+		hlen += 4;
+		if (len > (hlen + extlen))
+			hlen += extlen;
+	}
+	if (plen)
+		*plen = len - hlen;
+	return buf + hlen;
+}
@@ -0,0 +1,181 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "../plugins/gop_cache.h"
+#include "../rtp.h"
+
+
+static packet_buffer * make_packet(guint16 seq, guint32 ts, const guint8 * payload, gsize plen)
+{
+	packet_buffer * buffer = packet_pool_acquire();
+	rtp_header * rtp = (rtp_header *)buffer->data;
+
+	memset(rtp, 0, RTP_HEADER_SIZE);
+	rtp->version = 2;
+	rtp->seq_number = htons(seq);
+	rtp->timestamp = htonl(ts);
+	if (plen)
+		memcpy(buffer->data + RTP_HEADER_SIZE, payload, plen);
+	buffer->length = RTP_HEADER_SIZE + plen;
+	return buffer;
+}
+
+static gboolean is_keyframe(gint codec, const guint8 * payload, gsize plen)
+{
+	packet_buffer * buffer = make_packet(1, 0, payload, plen);
+	gboolean keyframe = gop_cache_is_keyframe_start(codec, buffer);
+
+	packet_buffer_unref(buffer);
+	return keyframe;
+}
+
+#define KEYFRAME(codec, ...) is_keyframe(codec, (const guint8[]){ __VA_ARGS__ }, sizeof((const guint8[]){ __VA_ARGS__ }))
+
+static void test_codec_from_rtpmap(void)
+{
+	g_assert_cmpint(gop_cache_codec_from_rtpmap("96 VP8/90000"), ==, GOP_CACHE_CODEC_VP8);
+	g_assert_cmpint(gop_cache_codec_from_rtpmap("98 vp9/90000"), ==, GOP_CACHE_CODEC_VP9);
+	g_assert_cmpint(gop_cache_codec_from_rtpmap("H264/90000"), ==, GOP_CACHE_CODEC_H264);
+	g_assert_cmpint(gop_cache_codec_from_rtpmap("111 opus/48000/2"), ==, GOP_CACHE_CODEC_UNKNOWN);
+	g_assert_cmpint(gop_cache_codec_from_rtpmap(NULL), ==, GOP_CACHE_CODEC_UNKNOWN);
+}
+
+static void test_vp8_keyframe(void)
+{
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x10, 0x00));
+	/* P bit set: interframe */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x10, 0x01));
+	/* Not the start of partition 0 */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x00, 0x00));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x11, 0x00));
+	/* Extended descriptor with a 15 bit PictureID */
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x90, 0x80, 0x81, 0x23, 0x00));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x90, 0x80, 0x81, 0x23, 0x01));
+	/* Descriptor running past the payload */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x90, 0x80, 0x81, 0x23));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x90, 0xf0, 0x01, 0x02));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x90));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP8, 0x10));
+}
+
+static void test_vp9_keyframe(void)
+{
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x08));
+	/* Inter-picture predicted */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x48));
+	/* Not the beginning of a frame */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x00));
+	/* Layer indices: only the base spatial layer */
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x28, 0x00));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x28, 0x02));
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_VP9, 0xa8, 0x80, 0x01, 0x00));
+	/* Layer indices announced past the payload */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP9, 0x28));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_VP9, 0xa8, 0x80, 0x01));
+}
+
+static void test_h264_keyframe(void)
+{
+	/* IDR slice and SPS */
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_H264, 0x65, 0x88));
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_H264, 0x67, 0x42));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_H264, 0x41, 0x9a));
+	/* STAP-A carrying an SPS after a non-IDR unit */
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_H264, 0x18, 0x00, 0x01, 0x41, 0x00, 0x02, 0x67, 0x42));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_H264, 0x18, 0x00, 0x01, 0x41));
+	/* STAP-A unit size running past the payload */
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_H264, 0x18, 0xff, 0xff, 0x41, 0x67));
+	/* FU-A: only the first fragment of an IDR */
+	g_assert_true(KEYFRAME(GOP_CACHE_CODEC_H264, 0x7c, 0x85));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_H264, 0x7c, 0x05));
+	g_assert_false(KEYFRAME(GOP_CACHE_CODEC_H264, 0x7c));
+}
+
+static void test_empty_payload(void)
+{
+	packet_buffer * buffer = make_packet(1, 0, NULL, 0);
+
+	g_assert_false(gop_cache_is_keyframe_start(GOP_CACHE_CODEC_VP8, buffer));
+	g_assert_false(gop_cache_is_keyframe_start(GOP_CACHE_CODEC_VP9, buffer));
+	g_assert_false(gop_cache_is_keyframe_start(GOP_CACHE_CODEC_H264, buffer));
+	/* Shorter than an RTP header */
+	buffer->length = 8;
+	g_assert_false(gop_cache_is_keyframe_start(GOP_CACHE_CODEC_H264, buffer));
+	packet_buffer_unref(buffer);
+}
+
+static void push(gop_cache * cache, guint16 seq, gboolean keyframe)
+{
+	packet_buffer * buffer = make_packet(seq, seq / 3 * 3000, (const guint8[]){ 0x10, 0x00 }, 2);
+
+	gop_cache_push(cache, buffer, keyframe);
+	packet_buffer_unref(buffer);
+}
+
+static void test_snapshot(void)
+{
+	gop_cache * cache = gop_cache_new(16);
+
+	/* Nothing to start from before the first keyframe */
+	push(cache, 8, FALSE);
+	push(cache, 9, FALSE);
+	g_assert_null(gop_cache_snapshot(cache, 10));
+
+	push(cache, 10, TRUE);
+	push(cache, 11, FALSE);
+	push(cache, 12, FALSE);
+	GPtrArray * snapshot = gop_cache_snapshot(cache, 12);
+	g_assert_nonnull(snapshot);
+	g_assert_cmpuint(snapshot->len, ==, 2);
+	g_assert_cmpuint(ntohs(((rtp_header *)((packet_buffer *)g_ptr_array_index(snapshot, 0))->data)->seq_number), ==, 10);
+	g_ptr_array_free(snapshot, TRUE);
+
+	/* Wrapping sequence numbers */
+	push(cache, 65535, TRUE);
+	push(cache, 0, FALSE);
+	snapshot = gop_cache_snapshot(cache, 1);
+	g_assert_cmpuint(snapshot->len, ==, 2);
+	g_ptr_array_free(snapshot, TRUE);
+
+	gop_cache_clear(cache);
+	g_assert_null(gop_cache_snapshot(cache, 2));
+	gop_cache_free(cache);
+}
+
+static void test_overflow(void)
+{
+	gop_cache * cache = gop_cache_new(3);
+
+	push(cache, 1, TRUE);
+	push(cache, 2, FALSE);
+	push(cache, 3, FALSE);
+	push(cache, 4, FALSE);
+	g_assert_cmpuint(cache->overflows, ==, 1);
+	g_assert_null(gop_cache_snapshot(cache, 5));
+
+	/* Until the next keyframe */
+	push(cache, 5, FALSE);
+	g_assert_null(gop_cache_snapshot(cache, 6));
+	push(cache, 6, TRUE);
+	GPtrArray * snapshot = gop_cache_snapshot(cache, 7);
+	g_assert_cmpuint(snapshot->len, ==, 1);
+	g_ptr_array_free(snapshot, TRUE);
+	gop_cache_free(cache);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	packet_pool_init(32);
+
+	g_test_add_func("/gop_cache/codec_from_rtpmap", test_codec_from_rtpmap);
+	g_test_add_func("/gop_cache/vp8_keyframe", test_vp8_keyframe);
+	g_test_add_func("/gop_cache/vp9_keyframe", test_vp9_keyframe);
+	g_test_add_func("/gop_cache/h264_keyframe", test_h264_keyframe);
+	g_test_add_func("/gop_cache/empty_payload", test_empty_payload);
+	g_test_add_func("/gop_cache/snapshot", test_snapshot);
+	g_test_add_func("/gop_cache/overflow", test_overflow);
+
+	int result = g_test_run();
+	packet_pool_destroy();
+	return result;
+}
@@ -0,0 +1,107 @@
+#include "../plugins/keyframe_requests.h"
+
+
+#define MS(ms) ((gint64)(ms) * 1000)
+#define T0 G_USEC_PER_SEC
+
+static void test_first_forwarded(void)
+{
+	keyframe_requests * requests = keyframe_requests_new(100, 500);
+
+	g_assert_true(keyframe_requests_add(requests, T0));
+	g_assert_cmpuint(requests->requested, ==, 1);
+	g_assert_cmpuint(requests->forwarded, ==, 1);
+	g_assert_true(requests->in_flight);
+	/* Nothing coalesced, nothing to flush */
+	g_assert_false(keyframe_requests_poll(requests, T0 + MS(1000)));
+	keyframe_requests_free(requests);
+}
+
+/* Requests while the keyframe is on its way are answered by it */
+static void test_suppressed_in_flight(void)
+{
+	keyframe_requests * requests = keyframe_requests_new(100, 500);
+
+	g_assert_true(keyframe_requests_add(requests, T0));
+	g_assert_false(keyframe_requests_add(requests, T0 + MS(50)));
+	g_assert_false(keyframe_requests_add(requests, T0 + MS(300)));
+	g_assert_cmpuint(requests->suppressed, ==, 2);
+	g_assert_false(keyframe_requests_poll(requests, T0 + MS(300)));
+
+	/* The keyframe never came: asked again once timed out */
+	g_assert_true(keyframe_requests_add(requests, T0 + MS(500)));
+	g_assert_cmpuint(requests->forwarded, ==, 2);
+	keyframe_requests_free(requests);
+}
+
+/* Once the keyframe arrived, a new request within the window is held back until the window is over */
+static void test_coalesced_window(void)
+{
+	keyframe_requests * requests = keyframe_requests_new(100, 500);
+
+	g_assert_true(keyframe_requests_add(requests, T0));
+	keyframe_requests_keyframe(requests);
+	g_assert_false(requests->in_flight);
+
+	g_assert_false(keyframe_requests_add(requests, T0 + MS(40)));
+	g_assert_false(keyframe_requests_add(requests, T0 + MS(60)));
+	g_assert_cmpuint(requests->coalesced, ==, 2);
+	g_assert_false(keyframe_requests_poll(requests, T0 + MS(99)));
+
+	g_assert_true(keyframe_requests_poll(requests, T0 + MS(100)));
+	g_assert_true(requests->in_flight);
+	/* Flushed only once for all the coalesced requests */
+	g_assert_false(keyframe_requests_poll(requests, T0 + MS(300)));
+	g_assert_cmpuint(requests->requested, ==, 3);
+	g_assert_cmpuint(requests->forwarded, ==, 2);
+
+	/* Past the window with no keyframe pending: forwarded straight away */
+	keyframe_requests_keyframe(requests);
+	g_assert_true(keyframe_requests_add(requests, T0 + MS(200)));
+	g_assert_cmpuint(requests->forwarded, ==, 3);
+	keyframe_requests_free(requests);
+}
+
+/* A keyframe the source sent on its own answers the request held back */
+static void test_keyframe_answers_pending(void)
+{
+	keyframe_requests * requests = keyframe_requests_new(100, 500);
+
+	g_assert_true(keyframe_requests_add(requests, T0));
+	keyframe_requests_keyframe(requests);
+	g_assert_false(keyframe_requests_add(requests, T0 + MS(40)));
+	g_assert_cmpuint(requests->coalesced, ==, 1);
+
+	keyframe_requests_keyframe(requests);
+	g_assert_cmpint(g_atomic_int_get(&requests->pending), ==, 0);
+	g_assert_cmpuint(requests->suppressed, ==, 1);
+	g_assert_false(keyframe_requests_poll(requests, T0 + MS(100)));
+	g_assert_cmpuint(requests->forwarded, ==, 1);
+	keyframe_requests_free(requests);
+}
+
+static void test_ignore(void)
+{
+	keyframe_requests * requests = keyframe_requests_new(100, 500);
+
+	keyframe_requests_ignore(requests);
+	keyframe_requests_ignore(requests);
+	g_assert_cmpuint(requests->requested, ==, 2);
+	g_assert_cmpuint(requests->suppressed, ==, 2);
+	g_assert_cmpuint(requests->forwarded, ==, 0);
+	g_assert_false(keyframe_requests_poll(requests, T0));
+	keyframe_requests_free(requests);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/keyframe_requests/first_forwarded", test_first_forwarded);
+	g_test_add_func("/keyframe_requests/suppressed_in_flight", test_suppressed_in_flight);
+	g_test_add_func("/keyframe_requests/coalesced_window", test_coalesced_window);
+	g_test_add_func("/keyframe_requests/keyframe_answers_pending", test_keyframe_answers_pending);
+	g_test_add_func("/keyframe_requests/ignore", test_ignore);
+
+	return g_test_run();
+}
@@ -0,0 +1,207 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "../plugins/ladder.h"
+#include "../rtcp.h"
+
+
+#define MS(ms) ((gint64)(ms) * 1000)
+#define T0 G_USEC_PER_SEC
+
+static void test_parse(void)
+{
+	guint count = 0;
+	ladder_rendition_spec * specs = ladder_parse("640x360@600, 1920x1080@4000,,1280x720@2000", &count);
+
+	/* Sorted from the highest bitrate down, empty items skipped */
+	g_assert_nonnull(specs);
+	g_assert_cmpuint(count, ==, 3);
+	g_assert_cmpuint(specs[0].width, ==, 1920);
+	g_assert_cmpuint(specs[0].height, ==, 1080);
+	g_assert_cmpuint(specs[0].bitrate, ==, 4000000);
+	g_assert_cmpuint(specs[1].width, ==, 1280);
+	g_assert_cmpuint(specs[1].bitrate, ==, 2000000);
+	g_assert_cmpuint(specs[2].width, ==, 640);
+	g_assert_cmpuint(specs[2].bitrate, ==, 600000);
+	g_free(specs);
+
+	specs = ladder_parse(NULL, &count);
+	g_assert_nonnull(specs);
+	g_assert_cmpuint(count, ==, 3);
+	g_assert_cmpuint(specs[0].bitrate, ==, 4000000);
+	g_free(specs);
+
+	g_assert_null(ladder_parse("1280x720", &count));
+	g_assert_cmpuint(count, ==, 0);
+	g_assert_null(ladder_parse("1280x720@2000,0x360@600", &count));
+	g_assert_null(ladder_parse("1280x720@0", &count));
+	g_assert_null(ladder_parse("", &count));
+	g_assert_null(ladder_parse(" , ", &count));
+}
+
+static void test_select_estimate(void)
+{
+	guint count = 0;
+	ladder_rendition_spec * specs = ladder_parse(NULL, &count);
+
+	/* Nothing known yet: the middle one */
+	g_assert_cmpint(ladder_select(specs, count, -1, 0, -1, FALSE), ==, 1);
+	/* The highest bitrate fitting in 85% of the estimate */
+	g_assert_cmpint(ladder_select(specs, count, -1, 5000000, -1, FALSE), ==, 0);
+	g_assert_cmpint(ladder_select(specs, count, -1, 2400000, -1, FALSE), ==, 1);
+	g_assert_cmpint(ladder_select(specs, count, -1, 2000000, -1, FALSE), ==, 2);
+	/* Below the lowest rendition */
+	g_assert_cmpint(ladder_select(specs, count, -1, 100000, -1, FALSE), ==, 2);
+	/* No estimate keeps the current one */
+	g_assert_cmpint(ladder_select(specs, count, 0, 0, -1, TRUE), ==, 0);
+
+	g_free(specs);
+}
+
+static void test_select_hysteresis(void)
+{
+	guint count = 0;
+	ladder_rendition_spec * specs = ladder_parse(NULL, &count);
+
+	/* Downgrades apply at once */
+	g_assert_cmpint(ladder_select(specs, count, 0, 2400000, -1, FALSE), ==, 1);
+	g_assert_cmpint(ladder_select(specs, count, 0, 2400000, 50, FALSE), ==, 1);
+	/* Upgrades only when allowed and with little loss */
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, 0, FALSE), ==, 2);
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, 0, TRUE), ==, 0);
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, -1, TRUE), ==, 0);
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, 5, TRUE), ==, 0);
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, 10, TRUE), ==, 2);
+	/* Heavy loss moves one step down whatever the estimate */
+	g_assert_cmpint(ladder_select(specs, count, 0, 5000000, 30, TRUE), ==, 1);
+	g_assert_cmpint(ladder_select(specs, count, 1, 0, 30, TRUE), ==, 2);
+	g_assert_cmpint(ladder_select(specs, count, 2, 5000000, 30, TRUE), ==, 2);
+	/* and never above what the estimate allows */
+	g_assert_cmpint(ladder_select(specs, count, 0, 100000, 30, TRUE), ==, 2);
+
+	g_free(specs);
+}
+
+static int build_report(char * buf, int type, guint8 fraction_lost)
+{
+	rtcp_header * header = (rtcp_header *)buf;
+	report_block * block;
+	int len;
+
+	if (type == RTCP_SR) {
+		len = sizeof(rtcp_sr);
+		memset(buf, 0, len);
+		block = ((rtcp_sr *)buf)->rb;
+	}
+	else {
+		len = sizeof(rtcp_rr);
+		memset(buf, 0, len);
+		block = ((rtcp_rr *)buf)->rb;
+	}
+	header->version = 2;
+	header->type = type;
+	header->rc = 1;
+	header->length = htons(len / 4 - 1);
+	block->flcnpl = htonl((guint32)fraction_lost << 24 | 12);
+	return len;
+}
+
+static void test_fraction_lost(void)
+{
+	char buf[256];
+	rtcp_header * header = (rtcp_header *)buf;
+	int len;
+
+	len = build_report(buf, RTCP_RR, 30);
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, 30);
+	/* Truncated report */
+	g_assert_cmpint(ladder_fraction_lost(buf, len - 4), ==, -1);
+
+	/* Compound SR + RR: the highest of the two */
+	len = build_report(buf, RTCP_SR, 10);
+	len += build_report(buf + len, RTCP_RR, 40);
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, 40);
+	len = build_report(buf, RTCP_SR, 50);
+	len += build_report(buf + len, RTCP_RR, 0);
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, 50);
+
+	/* No report block */
+	len = build_report(buf, RTCP_RR, 30);
+	header->rc = 0;
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, -1);
+	len = build_report(buf, RTCP_RR, 30);
+	header->type = RTCP_SDES;
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, -1);
+	len = build_report(buf, RTCP_RR, 30);
+	header->version = 1;
+	g_assert_cmpint(ladder_fraction_lost(buf, len), ==, -1);
+	g_assert_cmpint(ladder_fraction_lost(buf, 0), ==, -1);
+}
+
+static void rewrite(ladder_rewrite * state, gint source, guint32 ssrc, guint16 seq, guint32 ts, gint64 now,
+		guint16 expected_seq, guint32 expected_ts)
+{
+	rtp_header rtp;
+
+	memset(&rtp, 0, sizeof(rtp));
+	rtp.version = 2;
+	rtp.ssrc = htonl(ssrc);
+	rtp.seq_number = htons(seq);
+	rtp.timestamp = htonl(ts);
+	ladder_rewrite_packet(state, &rtp, source, now);
+	g_assert_cmpuint(ntohl(rtp.ssrc), ==, 0x1111);
+	g_assert_cmpuint(ntohs(rtp.seq_number), ==, expected_seq);
+	g_assert_cmpuint(ntohl(rtp.timestamp), ==, expected_ts);
+}
+
+static void test_rewrite(void)
+{
+	ladder_rewrite state;
+
+	memset(&state, 0, sizeof(state));
+	/* The first rendition goes through untouched, its SSRC is kept for the others */
+	rewrite(&state, 0, 0x1111, 1000, 5000, T0, 1000, 5000);
+	rewrite(&state, 0, 0x1111, 1001, 8000, T0 + MS(33), 1001, 8000);
+
+	/* Switch: right after the last packet, at least 1/30 s later */
+	rewrite(&state, 1, 0x2222, 50, 100000, T0 + MS(66), 1002, 11000);
+	rewrite(&state, 1, 0x2222, 51, 103000, T0 + MS(99), 1003, 14000);
+
+	/* A late packet keeps its place and does not move the reference back */
+	rewrite(&state, 1, 0x2222, 50, 100000, T0 + MS(100), 1002, 11000);
+	g_assert_cmpuint(state.last_seq, ==, 1003);
+	g_assert_cmpuint(state.last_ts, ==, 14000);
+
+	/* Back after a second: the clock advanced by the wall time */
+	rewrite(&state, 0, 0x1111, 1002, 9000, T0 + MS(1100), 1004, 104000);
+
+	/* Sequence numbers wrap */
+	rewrite(&state, 2, 0x3333, 65535, 0, T0 + MS(1200), 1005, 113000);
+	rewrite(&state, 2, 0x3333, 0, 3000, T0 + MS(1233), 1006, 116000);
+}
+
+static void test_rewrite_clock_rate(void)
+{
+	ladder_rewrite state;
+
+	memset(&state, 0, sizeof(state));
+	state.clock_rate = 48000;
+	rewrite(&state, 0, 0x1111, 10, 960, T0, 10, 960);
+	/* 1/30 s at 48 kHz */
+	rewrite(&state, 1, 0x2222, 500, 48000, T0 + MS(1), 11, 2560);
+	/* 100 ms at 48 kHz */
+	rewrite(&state, 0, 0x1111, 11, 1920, T0 + MS(101), 12, 7360);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/ladder/parse", test_parse);
+	g_test_add_func("/ladder/select_estimate", test_select_estimate);
+	g_test_add_func("/ladder/select_hysteresis", test_select_hysteresis);
+	g_test_add_func("/ladder/fraction_lost", test_fraction_lost);
+	g_test_add_func("/ladder/rewrite", test_rewrite);
+	g_test_add_func("/ladder/rewrite_clock_rate", test_rewrite_clock_rate);
+
+	return g_test_run();
+}
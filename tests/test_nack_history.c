@@ -0,0 +1,105 @@
+#include "../plugins/nack_history.h"
+
+
+#define MS(ms) ((gint64)(ms) * 1000)
+#define T0 G_USEC_PER_SEC
+
+static void assert_hit(nack_history * history, guint16 seq, gint64 now, packet_buffer * expected)
+{
+	packet_buffer * buffer = nack_history_lookup(history, seq, now);
+
+	g_assert_true(buffer == expected);
+	packet_buffer_unref(buffer);
+}
+
+static void test_lookup(void)
+{
+	nack_history * history = nack_history_new(500);
+	packet_buffer * buffer = packet_pool_acquire();
+
+	nack_history_store(history, buffer, 7, T0);
+	g_assert_cmpint(g_atomic_int_get(&buffer->ref), ==, 2);
+	assert_hit(history, 7, T0 + MS(10), buffer);
+	/* Never stored */
+	g_assert_null(nack_history_lookup(history, 8, T0 + MS(10)));
+	g_assert_cmpuint(history->requested, ==, 2);
+	g_assert_cmpuint(history->retransmitted, ==, 1);
+	g_assert_cmpuint(history->missed, ==, 1);
+
+	nack_history_free(history);
+	g_assert_cmpint(g_atomic_int_get(&buffer->ref), ==, 1);
+	packet_buffer_unref(buffer);
+}
+
+/* Sequence numbers a ring apart share a slot, the older one is gone */
+static void test_slot_wraparound(void)
+{
+	nack_history * history = nack_history_new(500);
+	packet_buffer * first = packet_pool_acquire();
+	packet_buffer * second = packet_pool_acquire();
+
+	nack_history_store(history, first, 5, T0);
+	nack_history_store(history, second, 5 + NACK_HISTORY_SLOTS, T0 + MS(1));
+	g_assert_cmpint(g_atomic_int_get(&first->ref), ==, 1);
+	g_assert_null(nack_history_lookup(history, 5, T0 + MS(2)));
+	assert_hit(history, 5 + NACK_HISTORY_SLOTS, T0 + MS(2), second);
+
+	/* Across the 16 bit wrap */
+	nack_history_store(history, first, 65535, T0);
+	nack_history_store(history, second, 0, T0);
+	assert_hit(history, 65535, T0, first);
+	assert_hit(history, 0, T0, second);
+	g_assert_null(nack_history_lookup(history, 65535 - NACK_HISTORY_SLOTS, T0));
+
+	nack_history_free(history);
+	packet_buffer_unref(first);
+	packet_buffer_unref(second);
+}
+
+static void test_depth(void)
+{
+	nack_history * history = nack_history_new(200);
+	packet_buffer * buffer = packet_pool_acquire();
+
+	nack_history_store(history, buffer, 100, T0);
+	assert_hit(history, 100, T0 + MS(200), buffer);
+	g_assert_null(nack_history_lookup(history, 100, T0 + MS(201)));
+	g_assert_cmpuint(history->missed, ==, 1);
+
+	nack_history_free(history);
+	packet_buffer_unref(buffer);
+}
+
+static void test_clear_and_feedback(void)
+{
+	nack_history * history = nack_history_new(500);
+	packet_buffer * buffer = packet_pool_acquire();
+
+	nack_history_store(history, buffer, 1, T0);
+	nack_history_clear(history);
+	g_assert_cmpint(g_atomic_int_get(&buffer->ref), ==, 1);
+	g_assert_null(nack_history_lookup(history, 1, T0));
+
+	nack_history_feedback(history, TRUE);
+	nack_history_feedback(history, FALSE);
+	g_assert_cmpuint(history->nacks, ==, 2);
+	g_assert_cmpuint(history->recovered, ==, 1);
+
+	nack_history_free(history);
+	packet_buffer_unref(buffer);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	packet_pool_init(8);
+
+	g_test_add_func("/nack_history/lookup", test_lookup);
+	g_test_add_func("/nack_history/slot_wraparound", test_slot_wraparound);
+	g_test_add_func("/nack_history/depth", test_depth);
+	g_test_add_func("/nack_history/clear_and_feedback", test_clear_and_feedback);
+
+	int result = g_test_run();
+	packet_pool_destroy();
+	return result;
+}
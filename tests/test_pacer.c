@@ -0,0 +1,248 @@
+#include <string.h>
+#include "../plugins/pacer.h"
+
+
+#define INTERVAL_MS 20
+#define PACKET_SIZE 1200
+/* How long a test waits for the pacer thread before giving up */
+#define WAIT_USEC (2 * G_USEC_PER_SEC)
+
+/* What the pacer handed to a viewer, filled from the pacer thread */
+typedef struct sent_packets {
+	GMutex mutex;
+	guint count;
+	guint8 first[64];	/* first byte of each packet, in order */
+} sent_packets;
+
+static void collect(gpointer user_data, gboolean is_video, char * buf, int len)
+{
+	sent_packets * sent = (sent_packets *)user_data;
+
+	g_assert_true(is_video);
+	g_assert_cmpint(len, ==, PACKET_SIZE);
+	g_mutex_lock(&sent->mutex);
+	if (sent->count < sizeof(sent->first)) {
+		sent->first[sent->count] = (guint8)buf[0];
+	}
+	sent->count++;
+	g_mutex_unlock(&sent->mutex);
+}
+
+static guint sent_count(sent_packets * sent)
+{
+	guint count;
+
+	g_mutex_lock(&sent->mutex);
+	count = sent->count;
+	g_mutex_unlock(&sent->mutex);
+	return count;
+}
+
+static gboolean wait_sent(sent_packets * sent, guint count)
+{
+	gint64 deadline = g_get_monotonic_time() + WAIT_USEC;
+
+	while (sent_count(sent) < count) {
+		if (g_get_monotonic_time() > deadline) {
+			return FALSE;
+		}
+		g_usleep(1000);
+	}
+	return TRUE;
+}
+
+static void push(pacer_queue * queue, guint8 first)
+{
+	char buf[PACKET_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	buf[0] = (char)first;
+	pacer_queue_push(queue, TRUE, buf, sizeof(buf));
+}
+
+static void test_unpaced(void)
+{
+	sent_packets sent;
+	pacer * pacer = pacer_new(INTERVAL_MS);
+	pacer_queue * queue = pacer_queue_new(pacer, collect, &sent);
+
+	memset(&sent, 0, sizeof(sent));
+	g_mutex_init(&sent.mutex);
+
+	/* Without a rate everything leaves from push, undelayed */
+	for (guint i = 0; i < 10; i++) {
+		push(queue, i);
+	}
+	g_assert_cmpuint(sent_count(&sent), ==, 10);
+	g_assert_cmpuint(queue->sent, ==, 10);
+	g_assert_cmpuint(queue->delayed, ==, 0);
+	g_assert_cmpuint(queue->delays[0], ==, 10);
+	g_assert_cmpuint(queue->queued_bytes, ==, 0);
+
+	pacer_queue_unref(queue);
+	pacer_free(pacer);
+	g_mutex_clear(&sent.mutex);
+}
+
+static void test_burst_then_interval(void)
+{
+	sent_packets sent;
+	pacer * pacer = pacer_new(INTERVAL_MS);
+	pacer_queue * queue = pacer_queue_new(pacer, collect, &sent);
+	guint64 delays[PACER_DELAY_BUCKETS];
+
+	memset(&sent, 0, sizeof(sent));
+	g_mutex_init(&sent.mutex);
+	/* 1000 bytes per second: a packet waits for the interval, not for its tokens */
+	pacer_queue_set_rate(queue, 8000);
+
+	/* An idle queue sends its burst at once */
+	for (guint i = 0; i < 4; i++) {
+		push(queue, i);
+	}
+	g_assert_cmpuint(sent_count(&sent), ==, 4);
+
+	/* The next one is left to the pacer thread, sleeping until now */
+	push(queue, 4);
+	push(queue, 5);
+	g_assert_true(wait_sent(&sent, 6));
+	g_assert_cmpuint(queue->delayed, ==, 2);
+	memset(delays, 0, sizeof(delays));
+	pacer_delays_add(delays, queue);
+	g_assert_cmpint(pacer_delays_percentile(delays, 50), ==, 0);
+	g_assert_cmpint(pacer_delays_percentile(delays, 100), >=, INTERVAL_MS * 1000);
+
+	/* Idle again without tokens: the thread wakes up for the next one too */
+	g_usleep(50000);
+	push(queue, 6);
+	g_assert_true(wait_sent(&sent, 7));
+	g_assert_cmpuint(queue->delayed, ==, 3);
+
+	for (guint i = 0; i < 7; i++) {
+		g_assert_cmpuint(sent.first[i], ==, i);
+	}
+
+	pacer_queue_unref(queue);
+	pacer_free(pacer);
+	g_mutex_clear(&sent.mutex);
+}
+
+static void test_rate(void)
+{
+	sent_packets sent;
+	pacer * pacer = pacer_new(INTERVAL_MS);
+	pacer_queue * queue = pacer_queue_new(pacer, collect, &sent);
+
+	memset(&sent, 0, sizeof(sent));
+	g_mutex_init(&sent.mutex);
+	/* 1 MB per second: a packet every 1.2 ms past the burst */
+	pacer_queue_set_rate(queue, 8000000);
+
+	for (guint i = 0; i < 20; i++) {
+		push(queue, i);
+	}
+	g_assert_true(wait_sent(&sent, 20));
+	g_assert_cmpuint(queue->sent, ==, 20);
+	g_assert_cmpuint(queue->queued_bytes, ==, 0);
+	for (guint i = 0; i < 20; i++) {
+		g_assert_cmpuint(sent.first[i], ==, i);
+	}
+
+	pacer_queue_unref(queue);
+	pacer_free(pacer);
+	g_mutex_clear(&sent.mutex);
+}
+
+static void test_close_and_reopen(void)
+{
+	sent_packets sent;
+	pacer * pacer = pacer_new(INTERVAL_MS);
+	pacer_queue * queue = pacer_queue_new(pacer, collect, &sent);
+
+	memset(&sent, 0, sizeof(sent));
+	g_mutex_init(&sent.mutex);
+	pacer_queue_set_rate(queue, 8000);
+
+	for (guint i = 0; i < 6; i++) {
+		push(queue, i);
+	}
+	g_assert_cmpuint(sent_count(&sent), ==, 4);
+
+	/* What waited is dropped, and whatever comes until reopened */
+	pacer_queue_close(queue);
+	g_assert_cmpuint(queue->queued_bytes, ==, 0);
+	push(queue, 6);
+	g_assert_cmpuint(queue->queued_bytes, ==, 0);
+	g_usleep(3 * INTERVAL_MS * 1000);
+	g_assert_cmpuint(sent_count(&sent), ==, 4);
+
+	/* Reopened with a full burst */
+	pacer_queue_reopen(queue);
+	for (guint i = 7; i < 11; i++) {
+		push(queue, i);
+	}
+	g_assert_cmpuint(sent_count(&sent), ==, 8);
+	g_assert_cmpuint(sent.first[4], ==, 7);
+
+	pacer_queue_unref(queue);
+	pacer_free(pacer);
+	g_mutex_clear(&sent.mutex);
+}
+
+static void test_free_with_queued(void)
+{
+	sent_packets sent;
+	pacer * pacer = pacer_new(INTERVAL_MS);
+	pacer_queue * queue = pacer_queue_new(pacer, collect, &sent);
+
+	memset(&sent, 0, sizeof(sent));
+	g_mutex_init(&sent.mutex);
+	pacer_queue_set_rate(queue, 8000);
+
+	/* The wheel holds its own reference to a scheduled queue */
+	for (guint i = 0; i < 6; i++) {
+		push(queue, i);
+	}
+	pacer_queue_unref(queue);
+	pacer_free(pacer);
+	g_assert_cmpuint(sent_count(&sent), <=, 6);
+	g_mutex_clear(&sent.mutex);
+}
+
+static void test_delays_percentile(void)
+{
+	guint64 delays[PACER_DELAY_BUCKETS];
+	pacer_queue queue;
+
+	memset(delays, 0, sizeof(delays));
+	g_assert_cmpint(pacer_delays_percentile(delays, 50), ==, -1);
+
+	memset(&queue, 0, sizeof(queue));
+	queue.delays[0] = 90;
+	queue.delays[10] = 9;
+	queue.delays[PACER_DELAY_BUCKETS - 1] = 1;
+	pacer_delays_add(delays, &queue);
+	pacer_delays_add(delays, &queue);
+	g_assert_cmpuint(delays[0], ==, 180);
+
+	/* Upper bound of the bucket the percentile falls in */
+	g_assert_cmpint(pacer_delays_percentile(delays, 0), ==, 0);
+	g_assert_cmpint(pacer_delays_percentile(delays, 90), ==, 0);
+	g_assert_cmpint(pacer_delays_percentile(delays, 91), ==, 1 << 10);
+	g_assert_cmpint(pacer_delays_percentile(delays, 99), ==, 1 << 10);
+	g_assert_cmpint(pacer_delays_percentile(delays, 100), ==, 1 << (PACER_DELAY_BUCKETS - 1));
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/pacer/unpaced", test_unpaced);
+	g_test_add_func("/pacer/burst_then_interval", test_burst_then_interval);
+	g_test_add_func("/pacer/rate", test_rate);
+	g_test_add_func("/pacer/close_and_reopen", test_close_and_reopen);
+	g_test_add_func("/pacer/free_with_queued", test_free_with_queued);
+	g_test_add_func("/pacer/delays_percentile", test_delays_percentile);
+
+	return g_test_run();
+}
@@ -0,0 +1,218 @@
+#include "../plugins/packet_pool.h"
+
+
+#define POOL_SIZE 4
+
+/* Pools stay with the thread that first acquired from them: every test runs on a thread
+ * of its own so it starts from an empty set of pools and leaves them all ownerless */
+static gpointer run_body(gpointer data)
+{
+	((void (*)(void))data)();
+	return NULL;
+}
+
+static void run_in_thread(void (*body)(void))
+{
+	g_thread_join(g_thread_new("packet-pool-test", run_body, body));
+	packet_pool_destroy();
+}
+
+static gpointer acquire_and_release(gpointer data)
+{
+	packet_buffer * buffer = packet_pool_acquire();
+	packet_pool * pool = buffer->pool;
+
+	packet_buffer_unref(buffer);
+	return pool;
+}
+
+static gpointer acquire(gpointer data)
+{
+	return packet_pool_acquire();
+}
+
+static gpointer release(gpointer data)
+{
+	packet_buffer_unref((packet_buffer *)data);
+	return NULL;
+}
+
+static void recycle(void)
+{
+	packet_pool_stats stats;
+	packet_buffer * buffer = packet_pool_acquire();
+	packet_buffer * again;
+
+	g_assert_nonnull(buffer->pool);
+	g_assert_cmpint(buffer->ref, ==, 1);
+	g_assert_cmpuint(buffer->length, ==, 0);
+	buffer->length = 100;
+	packet_buffer_unref(buffer);
+
+	/* The free list hands back the buffer just released, reset */
+	again = packet_pool_acquire();
+	g_assert_true(again == buffer);
+	g_assert_cmpuint(again->length, ==, 0);
+
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.pools, ==, 1);
+	g_assert_cmpuint(stats.size, ==, POOL_SIZE);
+	g_assert_cmpuint(stats.in_use, ==, 1);
+	g_assert_cmpuint(stats.fallbacks, ==, 0);
+	packet_buffer_unref(again);
+}
+
+static void test_recycle(void)
+{
+	run_in_thread(recycle);
+}
+
+static void references(void)
+{
+	packet_pool_stats stats;
+	packet_buffer * buffer = packet_pool_acquire();
+
+	g_assert_true(packet_buffer_ref(buffer) == buffer);
+	packet_buffer_unref(buffer);
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.in_use, ==, 1);
+
+	packet_buffer_unref(buffer);
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.in_use, ==, 0);
+
+	packet_buffer_unref(NULL);
+}
+
+static void test_references(void)
+{
+	run_in_thread(references);
+}
+
+static void exhaustion(void)
+{
+	packet_pool_stats stats;
+	packet_buffer * buffers[POOL_SIZE];
+	packet_buffer * extra;
+
+	for (guint i = 0; i < POOL_SIZE; i++) {
+		buffers[i] = packet_pool_acquire();
+		g_assert_nonnull(buffers[i]->pool);
+	}
+
+	/* Dry pool: served by malloc, freed rather than returned */
+	extra = packet_pool_acquire();
+	g_assert_null(extra->pool);
+	g_assert_cmpint(extra->ref, ==, 1);
+
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.in_use, ==, POOL_SIZE);
+	g_assert_cmpuint(stats.high_watermark, ==, POOL_SIZE);
+	g_assert_cmpuint(stats.fallbacks, ==, 1);
+
+	packet_buffer_unref(extra);
+	for (guint i = 0; i < POOL_SIZE; i++) {
+		packet_buffer_unref(buffers[i]);
+	}
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.in_use, ==, 0);
+	g_assert_cmpuint(stats.high_watermark, ==, POOL_SIZE);
+	g_assert_cmpuint(stats.fallbacks, ==, 1);
+}
+
+static void test_exhaustion(void)
+{
+	run_in_thread(exhaustion);
+}
+
+static void returned_by_other_thread(void)
+{
+	packet_pool_stats stats;
+	packet_buffer * buffers[POOL_SIZE];
+	packet_buffer * again;
+
+	for (guint i = 0; i < POOL_SIZE; i++) {
+		buffers[i] = packet_pool_acquire();
+	}
+
+	/* Released elsewhere, it waits on the returned stack until the free list runs out */
+	g_thread_join(g_thread_new("packet-pool-release", release, buffers[2]));
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.pools, ==, 1);
+	g_assert_cmpuint(stats.in_use, ==, POOL_SIZE - 1);
+
+	again = packet_pool_acquire();
+	g_assert_true(again == buffers[2]);
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.in_use, ==, POOL_SIZE);
+	g_assert_cmpuint(stats.fallbacks, ==, 0);
+
+	for (guint i = 0; i < POOL_SIZE; i++) {
+		packet_buffer_unref(buffers[i]);
+	}
+}
+
+static void test_returned_by_other_thread(void)
+{
+	run_in_thread(returned_by_other_thread);
+}
+
+static void adopted_after_exit(void)
+{
+	packet_pool_stats stats;
+	packet_pool * first = g_thread_join(g_thread_new("packet-pool-first", acquire_and_release, NULL));
+	packet_pool * second = g_thread_join(g_thread_new("packet-pool-second", acquire_and_release, NULL));
+	packet_buffer * buffer, * busy;
+
+	/* The second thread took over the pool the first one left */
+	g_assert_true(first == second);
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.pools, ==, 1);
+
+	/* Ownerless again, this thread adopts it too */
+	buffer = packet_pool_acquire();
+	g_assert_true(buffer->pool == first);
+	busy = g_thread_join(g_thread_new("packet-pool-busy", acquire, NULL));
+	g_assert_true(busy->pool != first);
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.pools, ==, 2);
+	g_assert_cmpuint(stats.size, ==, 2 * POOL_SIZE);
+	g_assert_cmpuint(stats.in_use, ==, 2);
+
+	packet_buffer_unref(busy);
+	packet_buffer_unref(buffer);
+}
+
+static void test_adopted_after_exit(void)
+{
+	run_in_thread(adopted_after_exit);
+}
+
+static void test_outlives_destroy(void)
+{
+	/* Destroyed while a buffer is out: the last unref frees the ownerless pool */
+	packet_buffer * buffer = g_thread_join(g_thread_new("packet-pool-keep", acquire, NULL));
+	packet_pool_stats stats;
+
+	packet_pool_destroy();
+	packet_pool_get_stats(&stats);
+	g_assert_cmpuint(stats.pools, ==, 0);
+	packet_buffer_unref(buffer);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	packet_pool_init(POOL_SIZE);
+
+	g_test_add_func("/packet_pool/recycle", test_recycle);
+	g_test_add_func("/packet_pool/references", test_references);
+	g_test_add_func("/packet_pool/exhaustion", test_exhaustion);
+	g_test_add_func("/packet_pool/returned_by_other_thread", test_returned_by_other_thread);
+	g_test_add_func("/packet_pool/adopted_after_exit", test_adopted_after_exit);
+	g_test_add_func("/packet_pool/outlives_destroy", test_outlives_destroy);
+
+	int result = g_test_run();
+	packet_pool_destroy();
+	return result;
+}
@@ -0,0 +1,124 @@
+#include "../plugins/remb_aggregator.h"
+
+
+#define MS(ms) ((gint64)(ms) * 1000)
+#define T0 G_USEC_PER_SEC
+#define VIEWER(n) GINT_TO_POINTER(n)
+
+/* The aggregate once three viewers reported, an interval of 0 aggregating on every update */
+static guint64 aggregate_of_three(guint percentile)
+{
+	remb_aggregator * aggregator = remb_aggregator_new(percentile, 0);
+	guint64 aggregate;
+
+	remb_aggregator_update(aggregator, VIEWER(1), 300000, T0);
+	remb_aggregator_update(aggregator, VIEWER(2), 100000, T0);
+	aggregate = remb_aggregator_update(aggregator, VIEWER(3), 200000, T0);
+	g_assert_cmpuint(aggregator->bitrate, ==, aggregate);
+	remb_aggregator_free(aggregator);
+	return aggregate;
+}
+
+static void test_percentile(void)
+{
+	g_assert_cmpuint(aggregate_of_three(0), ==, 100000);
+	g_assert_cmpuint(aggregate_of_three(50), ==, 200000);
+	g_assert_cmpuint(aggregate_of_three(100), ==, 300000);
+	/* Rounded down to the lower estimate */
+	g_assert_cmpuint(aggregate_of_three(99), ==, 200000);
+	/* Clamped */
+	g_assert_cmpuint(aggregate_of_three(150), ==, 300000);
+}
+
+/* Estimates received apart all count, however short the interval */
+static void test_short_interval(void)
+{
+	remb_aggregator * aggregator = remb_aggregator_new(0, 0);
+
+	remb_aggregator_update(aggregator, VIEWER(1), 300000, T0);
+	remb_aggregator_update(aggregator, VIEWER(2), 100000, T0 + MS(100));
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(3), 200000, T0 + MS(1000)), ==, 100000);
+	g_assert_cmpuint(g_hash_table_size(aggregator->estimates), ==, 3);
+	remb_aggregator_free(aggregator);
+
+	aggregator = remb_aggregator_new(0, 10);
+	remb_aggregator_update(aggregator, VIEWER(1), 100000, T0);
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(2), 500000, T0 + MS(4000)), ==, 100000);
+	remb_aggregator_free(aggregator);
+}
+
+static void test_replaced_estimate(void)
+{
+	remb_aggregator * aggregator = remb_aggregator_new(0, 0);
+
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(1), 100000, T0), ==, 100000);
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(1), 700000, T0), ==, 700000);
+	g_assert_cmpuint(aggregator->received, ==, 2);
+	g_assert_cmpuint(aggregator->applied, ==, 2);
+	remb_aggregator_free(aggregator);
+}
+
+static void test_interval(void)
+{
+	remb_aggregator * aggregator = remb_aggregator_new(0, 1000);
+
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(1), 500000, T0), ==, 500000);
+	/* Recorded, applied with the next aggregate */
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(2), 200000, T0 + MS(500)), ==, 0);
+	g_assert_cmpuint(aggregator->bitrate, ==, 500000);
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(1), 400000, T0 + MS(1000)), ==, 200000);
+	g_assert_cmpuint(aggregator->applied, ==, 2);
+	remb_aggregator_free(aggregator);
+}
+
+static void test_stale_and_remove(void)
+{
+	remb_aggregator * aggregator = remb_aggregator_new(0, 2000);
+
+	remb_aggregator_update(aggregator, VIEWER(1), 100000, T0);
+	remb_aggregator_update(aggregator, VIEWER(2), 500000, T0 + MS(5000));
+	/* The first one went quiet for more than 5 intervals */
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(3), 400000, T0 + MS(10001)), ==, 400000);
+	g_assert_cmpuint(g_hash_table_size(aggregator->estimates), ==, 2);
+
+	remb_aggregator_update(aggregator, VIEWER(4), 200000, T0 + MS(12001));
+	remb_aggregator_remove(aggregator, VIEWER(4));
+	g_assert_cmpuint(remb_aggregator_update(aggregator, VIEWER(3), 400000, T0 + MS(14001)), ==, 400000);
+
+	/* Nobody left: no aggregate, the previous one stays */
+	remb_aggregator_remove(aggregator, VIEWER(2));
+	remb_aggregator_remove(aggregator, VIEWER(3));
+	remb_aggregator_remove(aggregator, VIEWER(3));
+	g_assert_cmpuint(g_hash_table_size(aggregator->estimates), ==, 0);
+	g_assert_cmpuint(aggregator->bitrate, ==, 400000);
+	remb_aggregator_free(aggregator);
+}
+
+static void test_parse_percentile(void)
+{
+	g_assert_cmpint(remb_aggregator_parse_percentile(NULL), ==, 0);
+	g_assert_cmpint(remb_aggregator_parse_percentile("min"), ==, 0);
+	g_assert_cmpint(remb_aggregator_parse_percentile("MIN"), ==, 0);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p0"), ==, 0);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p95"), ==, 95);
+	g_assert_cmpint(remb_aggregator_parse_percentile("P100"), ==, 100);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p101"), ==, -1);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p-1"), ==, -1);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p"), ==, -1);
+	g_assert_cmpint(remb_aggregator_parse_percentile("p9x"), ==, -1);
+	g_assert_cmpint(remb_aggregator_parse_percentile("max"), ==, -1);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/remb_aggregator/percentile", test_percentile);
+	g_test_add_func("/remb_aggregator/short_interval", test_short_interval);
+	g_test_add_func("/remb_aggregator/replaced_estimate", test_replaced_estimate);
+	g_test_add_func("/remb_aggregator/interval", test_interval);
+	g_test_add_func("/remb_aggregator/stale_and_remove", test_stale_and_remove);
+	g_test_add_func("/remb_aggregator/parse_percentile", test_parse_percentile);
+
+	return g_test_run();
+}
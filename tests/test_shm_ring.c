@@ -0,0 +1,114 @@
+#include <string.h>
+#include "../plugins/shm_ring.h"
+
+
+static void push_numbered(shm_ring * ring, guint count, guint expected_accepted)
+{
+	guint accepted = 0;
+
+	for (guint i = 0; i < count; i++) {
+		gchar packet[4];
+		memset(packet, i, sizeof(packet));
+		if (shm_ring_push(ring, packet, sizeof(packet)))
+			accepted++;
+	}
+	g_assert_cmpuint(accepted, ==, expected_accepted);
+}
+
+static void test_slots_rounded_up(void)
+{
+	shm_ring * ring = shm_ring_new("test-shm-ring", 5, SHM_RING_DROP_OLDEST);
+
+	g_assert_nonnull(ring);
+	g_assert_cmpuint(ring->slots, ==, 8);
+	g_assert_cmpuint(ring->mask, ==, 7);
+	shm_ring_free(ring);
+}
+
+/* A consumer lapped by the producer skips what was overwritten and resumes with the oldest left */
+static void test_drop_oldest(void)
+{
+	shm_ring * ring = shm_ring_new("test-shm-ring", 4, SHM_RING_DROP_OLDEST);
+	gchar buf[SHM_RING_MAX_PACKET];
+	guint64 seq = 0;
+
+	push_numbered(ring, 6, 6);
+	for (guint64 expected = 2; expected < 6; expected++) {
+		g_assert_cmpint(shm_ring_pop(ring, buf, sizeof(buf), &seq), ==, 4);
+		g_assert_cmpuint(seq, ==, expected);
+		g_assert_cmpint(buf[0], ==, (gchar)expected);
+	}
+	g_assert_cmpint(shm_ring_pop(ring, buf, sizeof(buf), &seq), ==, -1);
+	g_assert_cmpuint(ring->dropped_oldest, ==, 2);
+	g_assert_cmpuint(ring->popped, ==, 4);
+	g_assert_cmpuint(ring->header->dropped_newest, ==, 0);
+	shm_ring_free(ring);
+}
+
+/* A full ring refuses new packets until the consumer catches up */
+static void test_drop_newest(void)
+{
+	shm_ring * ring = shm_ring_new("test-shm-ring", 4, SHM_RING_DROP_NEWEST);
+	gchar buf[SHM_RING_MAX_PACKET];
+	guint64 seq = 0;
+
+	push_numbered(ring, 6, 4);
+	g_assert_cmpuint(ring->header->dropped_newest, ==, 2);
+	for (guint64 expected = 0; expected < 4; expected++) {
+		g_assert_cmpint(shm_ring_pop(ring, buf, sizeof(buf), &seq), ==, 4);
+		g_assert_cmpuint(seq, ==, expected);
+	}
+	g_assert_cmpint(shm_ring_pop(ring, buf, sizeof(buf), &seq), ==, -1);
+	g_assert_cmpuint(ring->dropped_oldest, ==, 0);
+
+	/* Room again once read */
+	push_numbered(ring, 1, 1);
+	g_assert_cmpint(shm_ring_pop(ring, buf, sizeof(buf), &seq), ==, 4);
+	g_assert_cmpuint(seq, ==, 4);
+	shm_ring_free(ring);
+}
+
+static void test_bounds(void)
+{
+	shm_ring * ring = shm_ring_new("test-shm-ring", 4, SHM_RING_DROP_OLDEST);
+	gchar big[SHM_RING_MAX_PACKET + 1];
+	gchar small[2];
+
+	memset(big, 0, sizeof(big));
+	g_assert_false(shm_ring_push(ring, big, sizeof(big)));
+	g_assert_true(shm_ring_push(ring, big, SHM_RING_MAX_PACKET));
+
+	/* Does not fit the consumer's buffer: skipped, never truncated */
+	push_numbered(ring, 1, 1);
+	g_assert_cmpint(shm_ring_pop(ring, small, sizeof(small), NULL), ==, -1);
+	g_assert_cmpuint(ring->corrupt, ==, 2);
+
+	/* A producer going backwards resyncs the consumer instead of reading stale slots */
+	ring->header->tail = 10;
+	g_assert_cmpint(shm_ring_pop(ring, small, sizeof(small), NULL), ==, -1);
+	g_assert_cmpuint(ring->header->tail, ==, ring->header->head);
+	g_assert_cmpuint(ring->corrupt, ==, 3);
+	shm_ring_free(ring);
+}
+
+static void test_parse_overrun(void)
+{
+	g_assert_cmpint(shm_ring_parse_overrun(NULL), ==, SHM_RING_DROP_OLDEST);
+	g_assert_cmpint(shm_ring_parse_overrun("drop-oldest"), ==, SHM_RING_DROP_OLDEST);
+	g_assert_cmpint(shm_ring_parse_overrun("Drop-Newest"), ==, SHM_RING_DROP_NEWEST);
+	g_assert_cmpint(shm_ring_parse_overrun("block"), ==, -1);
+	g_assert_cmpstr(shm_ring_overrun_str(SHM_RING_DROP_NEWEST), ==, "drop-newest");
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/shm_ring/slots_rounded_up", test_slots_rounded_up);
+	g_test_add_func("/shm_ring/drop_oldest", test_drop_oldest);
+	g_test_add_func("/shm_ring/drop_newest", test_drop_newest);
+	g_test_add_func("/shm_ring/bounds", test_bounds);
+	g_test_add_func("/shm_ring/parse_overrun", test_parse_overrun);
+
+	return g_test_run();
+}
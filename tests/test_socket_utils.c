@@ -0,0 +1,228 @@
+#include <string.h>
+#include "../plugins/socket_utils.h"
+
+
+/* The reactor calls a callback at most this many times in a row */
+#define DISPATCH_BUDGET 16
+
+/* Reads one datagram per call, as the relay callbacks do without batching */
+typedef struct receiver {
+	socket_utils_socket local;
+	socket_utils_socket remote;
+	guint calls;
+	guint received;
+	guint8 first[64];	/* first byte of each datagram, in order */
+} receiver;
+
+static gboolean receive_one(GSocket * socket, GIOCondition condition, gpointer data)
+{
+	receiver * r = (receiver *)data;
+	gchar buf[SOCKET_UTILS_MAX_PACKET];
+	gssize len;
+
+	g_assert_true(socket == r->local.socket);
+	r->calls++;
+	len = socket_utils_receive(&r->local, buf, sizeof(buf));
+	if (len > 0) {
+		if (r->received < sizeof(r->first)) {
+			r->first[r->received] = (guint8)buf[0];
+		}
+		r->received++;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static void receiver_open(receiver * r, GMainContext * context)
+{
+	memset(r, 0, sizeof(*r));
+	g_assert_true(socket_utils_create_socket_pair(&r->local, &r->remote));
+	socket_utils_attach_callback_to_context(&r->local, (GSourceFunc)receive_one, (gpointer)r, context);
+}
+
+static void receiver_close(receiver * r)
+{
+	socket_utils_close_socket(&r->local);
+	socket_utils_close_socket(&r->remote);
+	g_assert_null(r->local.watch);
+	g_assert_null(r->local.source);
+}
+
+static void send_numbered(receiver * r, guint from, guint count)
+{
+	for (guint i = from; i < from + count; i++) {
+		gchar packet[100];
+		memset(packet, i, sizeof(packet));
+		g_assert_cmpint(socket_utils_send(&r->remote, packet, sizeof(packet)), ==, sizeof(packet));
+	}
+}
+
+static void test_parse_backend(void)
+{
+	g_assert_cmpint(socket_utils_parse_backend(NULL), ==, SOCKET_UTILS_BACKEND_GLIB);
+	g_assert_cmpint(socket_utils_parse_backend("glib"), ==, SOCKET_UTILS_BACKEND_GLIB);
+	g_assert_cmpint(socket_utils_parse_backend("EPOLL"), ==, SOCKET_UTILS_BACKEND_EPOLL);
+	g_assert_cmpint(socket_utils_parse_backend("kqueue"), ==, -1);
+	g_assert_cmpstr(socket_utils_backend_str(SOCKET_UTILS_BACKEND_EPOLL), ==, "epoll");
+	g_assert_cmpstr(socket_utils_backend_str(SOCKET_UTILS_BACKEND_GLIB), ==, "glib");
+}
+
+static void test_epoll_drains(void)
+{
+	GMainContext * context = g_main_context_new();
+	receiver r;
+
+	socket_utils_set_backend(SOCKET_UTILS_BACKEND_EPOLL);
+	receiver_open(&r, context);
+	g_assert_nonnull(r.local.watch);
+	g_assert_null(r.local.source);
+
+	/* Nothing pending: no dispatch */
+	g_assert_false(g_main_context_iteration(context, FALSE));
+	g_assert_cmpuint(r.calls, ==, 0);
+
+	/* Called until a receive finds the socket empty */
+	send_numbered(&r, 0, 3);
+	g_assert_true(g_main_context_iteration(context, FALSE));
+	g_assert_cmpuint(r.received, ==, 3);
+	g_assert_cmpuint(r.calls, ==, 4);
+	g_assert_true(r.local.drained);
+
+	/* Edge-triggered: reported again only once something new arrives */
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.calls, ==, 4);
+	send_numbered(&r, 3, 1);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.received, ==, 4);
+	g_assert_cmpuint(r.calls, ==, 6);
+
+	for (guint i = 0; i < 4; i++) {
+		g_assert_cmpuint(r.first[i], ==, i);
+	}
+
+	receiver_close(&r);
+	g_main_context_unref(context);
+}
+
+static void test_epoll_budget(void)
+{
+	GMainContext * context = g_main_context_new();
+	receiver busy, quiet;
+
+	socket_utils_set_backend(SOCKET_UTILS_BACKEND_EPOLL);
+	receiver_open(&busy, context);
+	receiver_open(&quiet, context);
+
+	/* A busy socket stops at the budget, the others still get their turn */
+	send_numbered(&busy, 0, DISPATCH_BUDGET + 4);
+	send_numbered(&quiet, 0, 1);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(busy.received, ==, DISPATCH_BUDGET);
+	g_assert_cmpuint(busy.calls, ==, DISPATCH_BUDGET);
+	g_assert_false(busy.local.drained);
+	g_assert_cmpuint(quiet.received, ==, 1);
+
+	/* and is finished on the next iteration, without a new edge */
+	g_assert_true(g_main_context_iteration(context, FALSE));
+	g_assert_cmpuint(busy.received, ==, DISPATCH_BUDGET + 4);
+	g_assert_cmpuint(busy.calls, ==, DISPATCH_BUDGET + 5);
+	g_assert_cmpuint(quiet.calls, ==, 2);
+	for (guint i = 0; i < DISPATCH_BUDGET + 4; i++) {
+		g_assert_cmpuint(busy.first[i], ==, i);
+	}
+
+	receiver_close(&busy);
+	receiver_close(&quiet);
+	g_main_context_unref(context);
+}
+
+static void test_epoll_detach(void)
+{
+	GMainContext * context = g_main_context_new();
+	receiver r;
+
+	socket_utils_set_backend(SOCKET_UTILS_BACKEND_EPOLL);
+	receiver_open(&r, context);
+
+	send_numbered(&r, 0, 1);
+	socket_utils_deattach_callback(&r.local);
+	g_assert_null(r.local.watch);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.calls, ==, 0);
+
+	/* Detached while waiting for its next turn */
+	socket_utils_attach_callback_to_context(&r.local, (GSourceFunc)receive_one, (gpointer)&r, context);
+	send_numbered(&r, 1, DISPATCH_BUDGET + 1);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.calls, ==, DISPATCH_BUDGET);
+	socket_utils_deattach_callback(&r.local);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.calls, ==, DISPATCH_BUDGET);
+
+	receiver_close(&r);
+	g_main_context_unref(context);
+}
+
+static void test_epoll_per_context(void)
+{
+	GMainContext * first = g_main_context_new();
+	GMainContext * second = g_main_context_new();
+	receiver a, b;
+
+	socket_utils_set_backend(SOCKET_UTILS_BACKEND_EPOLL);
+	receiver_open(&a, first);
+	receiver_open(&b, second);
+
+	/* Each context only dispatches its own sockets */
+	send_numbered(&a, 0, 1);
+	send_numbered(&b, 0, 1);
+	g_main_context_iteration(first, FALSE);
+	g_assert_cmpuint(a.received, ==, 1);
+	g_assert_cmpuint(b.calls, ==, 0);
+	g_main_context_iteration(second, FALSE);
+	g_assert_cmpuint(b.received, ==, 1);
+
+	receiver_close(&a);
+	receiver_close(&b);
+	g_main_context_unref(first);
+	g_main_context_unref(second);
+}
+
+static void test_glib_backend(void)
+{
+	GMainContext * context = g_main_context_new();
+	receiver r;
+
+	socket_utils_set_backend(SOCKET_UTILS_BACKEND_GLIB);
+	receiver_open(&r, context);
+	g_assert_null(r.local.watch);
+	g_assert_nonnull(r.local.source);
+
+	/* Level-triggered GSource: one datagram per dispatch */
+	send_numbered(&r, 0, 2);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.received, ==, 1);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.received, ==, 2);
+	g_main_context_iteration(context, FALSE);
+	g_assert_cmpuint(r.calls, ==, 2);
+
+	receiver_close(&r);
+	g_main_context_unref(context);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	socket_utils_init(40000, 40100);
+
+	g_test_add_func("/socket_utils/parse_backend", test_parse_backend);
+	g_test_add_func("/socket_utils/epoll_drains", test_epoll_drains);
+	g_test_add_func("/socket_utils/epoll_budget", test_epoll_budget);
+	g_test_add_func("/socket_utils/epoll_detach", test_epoll_detach);
+	g_test_add_func("/socket_utils/epoll_per_context", test_epoll_per_context);
+	g_test_add_func("/socket_utils/glib_backend", test_glib_backend);
+
+	int result = g_test_run();
+	socket_utils_destroy();
+	return result;
+}
@@ -0,0 +1,220 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "../plugins/temporal_layers.h"
+#include "../rtp.h"
+
+
+static gboolean parse(const guint8 * payload, gint plen, temporal_layers_vp8_info * info)
+{
+	return temporal_layers_parse_vp8(payload, plen, info);
+}
+
+#define PARSE(info, ...) parse((const guint8[]){ __VA_ARGS__ }, sizeof((const guint8[]){ __VA_ARGS__ }), info)
+
+static void test_parse_vp8(void)
+{
+	temporal_layers_vp8_info info;
+
+	/* No extension */
+	g_assert_true(PARSE(&info, 0x10, 0x9d));
+	g_assert_true(info.frame_start);
+	g_assert_false(info.has_tid);
+	g_assert_cmpint(info.picture_id, ==, -1);
+	g_assert_true(PARSE(&info, 0x11, 0x9d));
+	g_assert_false(info.frame_start);
+
+	/* 15 bit PictureID, TL0PICIDX, TID 1 with the Y bit */
+	g_assert_true(PARSE(&info, 0x90, 0xe0, 0x81, 0x23, 0x05, 0x60, 0x9d));
+	g_assert_true(info.frame_start);
+	g_assert_cmpint(info.picture_id, ==, 0x123);
+	g_assert_true(info.picture_id_long);
+	g_assert_cmpint(info.picture_id_offset, ==, 2);
+	g_assert_true(info.has_tid);
+	g_assert_cmpint(info.tid, ==, 1);
+	g_assert_true(info.layer_sync);
+
+	/* 7 bit PictureID, TID 2 */
+	g_assert_true(PARSE(&info, 0x80, 0xa0, 0x05, 0x80));
+	g_assert_false(info.frame_start);
+	g_assert_cmpint(info.picture_id, ==, 5);
+	g_assert_false(info.picture_id_long);
+	g_assert_cmpint(info.tid, ==, 2);
+	g_assert_false(info.layer_sync);
+
+	/* KEYIDX only: no TID */
+	g_assert_true(PARSE(&info, 0x90, 0x10, 0x00));
+	g_assert_false(info.has_tid);
+}
+
+static void test_parse_vp8_truncated(void)
+{
+	temporal_layers_vp8_info info;
+
+	g_assert_false(parse(NULL, 0, &info));
+	g_assert_false(PARSE(&info, 0x90));
+	/* PictureID announced past the payload */
+	g_assert_false(PARSE(&info, 0x90, 0x80));
+	g_assert_false(PARSE(&info, 0x90, 0x80, 0x81));
+	/* TID announced past the payload */
+	g_assert_false(PARSE(&info, 0x90, 0x20));
+	g_assert_false(PARSE(&info, 0x90, 0xe0, 0x81, 0x23, 0x05));
+	g_assert_false(info.has_tid);
+}
+
+static temporal_layers_vp8_info layer(gint tid, gboolean sync, gboolean frame_start, gint picture_id)
+{
+	temporal_layers_vp8_info info = {
+		.frame_start = frame_start,
+		.has_tid = TRUE,
+		.tid = tid,
+		.layer_sync = sync,
+		.picture_id = picture_id,
+	};
+	return info;
+}
+
+static gboolean forward(temporal_layers_filter * filter, gint tid, gboolean sync, gboolean frame_start, gint picture_id)
+{
+	temporal_layers_vp8_info info = layer(tid, sync, frame_start, picture_id);
+
+	return temporal_layers_filter_forward(filter, &info);
+}
+
+static void test_filter(void)
+{
+	temporal_layers_filter * filter = g_malloc0(sizeof(temporal_layers_filter));
+	temporal_layers_vp8_info no_tid = { .picture_id = -1 };
+
+	temporal_layers_filter_reset(filter);
+	g_assert_true(forward(filter, 3, FALSE, TRUE, 1));
+	g_assert_cmpuint(filter->seq_offset, ==, 0);
+
+	/* Down on the next frame, counting the dropped packets and pictures */
+	g_atomic_int_set(&filter->target_layer, 0);
+	g_assert_false(forward(filter, 1, FALSE, TRUE, 10));
+	g_assert_false(forward(filter, 1, FALSE, FALSE, 10));
+	g_assert_true(forward(filter, 0, FALSE, TRUE, 11));
+	g_assert_cmpint(filter->max_layer, ==, 0);
+	g_assert_cmpuint(filter->seq_offset, ==, 2);
+	g_assert_cmpuint(filter->picture_id_offset, ==, 1);
+
+	/* Up only on a frame the layer can be decoded from */
+	g_atomic_int_set(&filter->target_layer, 2);
+	g_assert_false(forward(filter, 2, FALSE, TRUE, 12));
+	g_assert_false(forward(filter, 1, TRUE, FALSE, 12));
+	g_assert_cmpint(filter->max_layer, ==, 0);
+	g_assert_true(forward(filter, 1, TRUE, TRUE, 13));
+	g_assert_cmpint(filter->max_layer, ==, 2);
+	g_assert_true(forward(filter, 2, FALSE, TRUE, 14));
+	g_assert_false(forward(filter, 3, FALSE, TRUE, 15));
+	g_assert_cmpuint(filter->seq_offset, ==, 5);
+	g_assert_cmpuint(filter->picture_id_offset, ==, 3);
+	g_assert_cmpuint(filter->dropped, ==, 5);
+
+	/* Without a TID there is nothing to filter */
+	g_assert_true(temporal_layers_filter_forward(filter, &no_tid));
+
+	temporal_layers_filter_reset(filter);
+	g_assert_cmpuint(filter->seq_offset, ==, 0);
+	g_assert_cmpuint(filter->picture_id_offset, ==, 0);
+	g_assert_cmpint(filter->max_layer, ==, TEMPORAL_LAYERS_MAX - 1);
+	g_free(filter);
+}
+
+/* A NACK is mapped back with the offsets in effect when the packet went out */
+static void test_sent_offsets(void)
+{
+	temporal_layers_filter * filter = g_malloc0(sizeof(temporal_layers_filter));
+	guint16 seq_offset = 0, picture_id_offset = 0;
+
+	temporal_layers_filter_reset(filter);
+	g_assert_false(temporal_layers_filter_sent_offsets(filter, 0, &seq_offset, &picture_id_offset));
+
+	temporal_layers_filter_sent(filter, 100);
+	g_atomic_int_set(&filter->target_layer, 0);
+	g_assert_false(forward(filter, 1, FALSE, TRUE, 7));
+	temporal_layers_filter_sent(filter, 102);
+
+	g_assert_true(temporal_layers_filter_sent_offsets(filter, 100, &seq_offset, &picture_id_offset));
+	g_assert_cmpuint(seq_offset, ==, 0);
+	g_assert_cmpuint(picture_id_offset, ==, 0);
+	g_assert_true(temporal_layers_filter_sent_offsets(filter, 101, &seq_offset, &picture_id_offset));
+	g_assert_cmpuint(seq_offset, ==, 1);
+	g_assert_cmpuint(picture_id_offset, ==, 1);
+	g_assert_false(temporal_layers_filter_sent_offsets(filter, 102, &seq_offset, &picture_id_offset));
+
+	/* Replaced a ring later, and across the 16 bit wrap */
+	temporal_layers_filter_sent(filter, 101 + TEMPORAL_LAYERS_SENT_SLOTS);
+	g_assert_false(temporal_layers_filter_sent_offsets(filter, 100, &seq_offset, &picture_id_offset));
+	g_assert_true(temporal_layers_filter_sent_offsets(filter, 100 + TEMPORAL_LAYERS_SENT_SLOTS, &seq_offset, &picture_id_offset));
+	temporal_layers_filter_sent(filter, 0);
+	g_assert_true(temporal_layers_filter_sent_offsets(filter, 65535, &seq_offset, &picture_id_offset));
+	g_assert_cmpuint(seq_offset, ==, 1);
+	g_free(filter);
+}
+
+static void test_rewrite(void)
+{
+	const guint8 payload[] = { 0x90, 0x80, 0x81, 0x23, 0x9d };
+	char buf[RTP_HEADER_SIZE + sizeof(payload)];
+	rtp_header * rtp = (rtp_header *)buf;
+	temporal_layers_vp8_info info;
+
+	memset(buf, 0, sizeof(buf));
+	rtp->version = 2;
+	rtp->seq_number = htons(2);
+	memcpy(buf + RTP_HEADER_SIZE, payload, sizeof(payload));
+	g_assert_true(temporal_layers_parse_vp8(payload, sizeof(payload), &info));
+
+	temporal_layers_rewrite(5, 3, buf, sizeof(buf), &info);
+	g_assert_cmpuint(ntohs(rtp->seq_number), ==, 65533);
+	g_assert_cmpuint((guint8)buf[RTP_HEADER_SIZE + 2], ==, 0x81);
+	g_assert_cmpuint((guint8)buf[RTP_HEADER_SIZE + 3], ==, 0x20);
+
+	/* 7 bit PictureID wrapping below 0 */
+	const guint8 short_payload[] = { 0x90, 0x80, 0x02, 0x9d };
+	memcpy(buf + RTP_HEADER_SIZE, short_payload, sizeof(short_payload));
+	g_assert_true(temporal_layers_parse_vp8(short_payload, sizeof(short_payload), &info));
+	temporal_layers_rewrite(0, 3, buf, RTP_HEADER_SIZE + sizeof(short_payload), &info);
+	g_assert_cmpuint(ntohs(rtp->seq_number), ==, 65533);
+	g_assert_cmpuint((guint8)buf[RTP_HEADER_SIZE + 2], ==, 0x7f);
+}
+
+static void test_select(void)
+{
+	/* Three layers at 40/60/100% of 1 Mbps, 90% of the estimate usable */
+	g_assert_cmpint(temporal_layers_select(3, 3, 1000000, 2000000, FALSE), ==, TEMPORAL_LAYERS_MAX - 1);
+	g_assert_cmpint(temporal_layers_select(3, 3, 1000000, 700000, FALSE), ==, 1);
+	g_assert_cmpint(temporal_layers_select(3, 3, 1000000, 600000, FALSE), ==, 0);
+	/* Nothing fits: the base layer still goes out */
+	g_assert_cmpint(temporal_layers_select(3, 3, 1000000, 100000, FALSE), ==, 0);
+
+	/* Up only when allowed */
+	g_assert_cmpint(temporal_layers_select(3, 0, 1000000, 2000000, FALSE), ==, 0);
+	g_assert_cmpint(temporal_layers_select(3, 0, 1000000, 2000000, TRUE), ==, TEMPORAL_LAYERS_MAX - 1);
+	g_assert_cmpint(temporal_layers_select(3, 0, 1000000, 700000, TRUE), ==, 1);
+
+	/* Unknown layering, bitrate or estimate: unchanged */
+	g_assert_cmpint(temporal_layers_select(1, 2, 1000000, 100000, FALSE), ==, 2);
+	g_assert_cmpint(temporal_layers_select(3, 2, 0, 100000, FALSE), ==, 2);
+	g_assert_cmpint(temporal_layers_select(3, 2, 1000000, 0, FALSE), ==, 2);
+
+	g_assert_cmpuint(temporal_layers_share(3, 0), ==, 40);
+	g_assert_cmpuint(temporal_layers_share(3, 5), ==, 100);
+	g_assert_cmpuint(temporal_layers_share(0, 0), ==, 100);
+	g_assert_cmpuint(temporal_layers_share(9, 0), ==, 25);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/temporal_layers/parse_vp8", test_parse_vp8);
+	g_test_add_func("/temporal_layers/parse_vp8_truncated", test_parse_vp8_truncated);
+	g_test_add_func("/temporal_layers/filter", test_filter);
+	g_test_add_func("/temporal_layers/sent_offsets", test_sent_offsets);
+	g_test_add_func("/temporal_layers/rewrite", test_rewrite);
+	g_test_add_func("/temporal_layers/select", test_select);
+
+	return g_test_run();
+}